@@ -0,0 +1,622 @@
+#ifndef AVL_AVLCOMPACTTREE_H
+#define AVL_AVLCOMPACTTREE_H
+
+#include "AVLTree.h"
+
+#include <cstdint>
+#include <vector>
+
+
+/** AVL tree with compact storage - same operations as AVLTree, for very big trees
+ * nodes live in one contiguous vector and link to each other by 32-bit index, heights are kept in a
+ * separate byte per node, and freed slots are reused through a free list
+ * a node costs 17 bytes (16 for data + links, 1 for height) instead of a full AVLNode
+ * nodes move when the vector grows, so the functions return the data pointers instead of nodes
+ */
+template <class ptr_type, class condition>
+class AVLCompactTree
+{
+private:
+    struct CompactNode
+    {
+        ptr_type* data;     // nullptr for a free slot
+        uint32_t left;      // next free slot for a free slot
+        uint32_t right;
+    };
+
+    // - sub function for insert and build: takes a slot from the free list or the end of the vector
+    uint32_t new_node(ptr_type* data);
+
+    // - sub function for remove: gives a slot back to the free list
+    void free_node(uint32_t r);
+
+    // - sub function for insert and remove: fixes heights and balance of the nodes on the path, from the bottom up
+    void retrace(uint32_t* path, int depth);
+
+    // -- sub function for retrace: links new_child to the node at path[depth - 1] (or as root)
+    void replace_child(uint32_t* path, int depth, uint32_t old_child, uint32_t new_child);
+
+    // -- sub function for retrace: balance the subtree of r with proper rotations, returns its new root
+    uint32_t balance_tree(uint32_t r);
+
+    // -- sub function for balance: makes an RR rotation
+    uint32_t make_RR_rotation(uint32_t r);
+
+    // -- sub function for balance: makes an LL rotation
+    uint32_t make_LL_rotation(uint32_t r);
+
+    // -- sub function for balance: calculates balance factor of node
+    int get_bf(uint32_t r);
+
+    // - sub function for retrace and rotations: updates height of node
+    void update_height(uint32_t r);
+
+    // - sub function for remove: removes the node of data, erases the data if asked
+    bool remove_node(ptr_type* data, bool erase);
+
+    // - sub function for search: returns the index of the node of data (NIL if doesn't exist)
+    uint32_t search_node(ptr_type* data);
+
+    // -- sub function for build_from_array: constructs the tree from array
+    uint32_t build_tree_from_array(ptr_type** array, int start, int end);
+
+    std::vector<CompactNode> nodes;
+    std::vector<int8_t> heights;
+    uint32_t root;
+    uint32_t free_list;
+    int num_of_nodes;
+
+    static const uint32_t NIL = 0;      // slot 0 is never used, its height is the height of an empty tree
+    static const int MAX_DEPTH = 64;    // an AVL tree of 2^32 nodes is less than 48 levels deep
+    static const int EMPTY_TREE = -1;
+    static const int UNBALANCED_POSITIVE_BF = 2;
+    static const int UNBALANCED_NEGATIVE_BF = -2;
+
+public:
+    // constructor
+    AVLCompactTree();
+
+    // builds tree from sorted array without duplicates
+    void build_from_array(ptr_type** data_array, int size);
+
+    // makes room for 'size' nodes, so inserting them won't grow the vectors
+    void reserve(int size);
+
+    // returns how many nodes the tree consists
+    int get_num_of_nodes();
+
+    // returns the height of the tree
+    int get_tree_height();
+
+    /** returns the data of the tree's max node
+     * returns nullptr - if tree is empty
+     */
+    ptr_type* get_max_node();
+
+    /** inserts a new node to the tree
+     * returns 'data' - if node is created
+     * returns nullptr - if node already exists
+     */
+    ptr_type* insert(ptr_type* data);
+
+    /** removes the node that points to 'data'
+     * returns true - if node is found and removed
+     * returns false - if node doesn't exist
+     */
+    bool remove(ptr_type* data);
+
+    /** removes the node that points to 'data' and calls its destructor
+     * returns true - if node is found and removed, and data is erased
+     * returns false - if node doesn't exist
+     */
+    bool remove_and_erase(ptr_type* data);
+
+    /** returns the data of the node that is equal to 'data'
+     *  returns nullptr - if node doesn't exist
+     */
+    ptr_type* search(ptr_type* data);
+
+    /**
+     * returns the data of the closest left neighbor node (smaller then the node)
+     * returns nullptr - if doesn't exist
+     */
+    ptr_type* get_closest_left(ptr_type* data);
+
+    /**
+     * returns the data of the closest right neighbor node (bigger then the node)
+     * returns nullptr - if doesn't exist
+     */
+    ptr_type* get_closest_right(ptr_type* data);
+
+    // returns an array with pointers to nodes' data, by order of template condition
+    ptr_type** inorder();
+
+    /** calls for the destructor of the data pointed to at every node
+     * does not remove the node itself (that's the destructors job)
+     */
+    void erase_data();
+
+    // returns the bytes held by the node storage (including unused capacity)
+    long get_memory_usage();
+};
+
+
+/******************************************************* node storage functions *******************************************************/
+
+
+template <class ptr_type, class condition>
+AVLCompactTree<ptr_type, condition>::AVLCompactTree() : root(NIL), free_list(NIL), num_of_nodes(0)
+{
+    nodes.push_back(CompactNode{nullptr, NIL, NIL});
+    heights.push_back(EMPTY_TREE);
+}
+
+
+template <class ptr_type, class condition>
+uint32_t AVLCompactTree<ptr_type, condition>::new_node(ptr_type* data)
+{
+    uint32_t r;
+    if (free_list != NIL)
+    {
+        r = free_list;
+        free_list = nodes[r].left;
+        nodes[r] = CompactNode{data, NIL, NIL};
+        heights[r] = 0;
+    }
+    else
+    {
+        r = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(CompactNode{data, NIL, NIL});
+        heights.push_back(0);
+    }
+    return r;
+}
+
+
+template <class ptr_type, class condition>
+void AVLCompactTree<ptr_type, condition>::free_node(uint32_t r)
+{
+    nodes[r].data = nullptr;
+    nodes[r].left = free_list;
+    nodes[r].right = NIL;
+    free_list = r;
+}
+
+
+template <class ptr_type, class condition>
+void AVLCompactTree<ptr_type, condition>::reserve(int size)
+{
+    nodes.reserve(size + 1);
+    heights.reserve(size + 1);
+}
+
+
+template <class ptr_type, class condition>
+long AVLCompactTree<ptr_type, condition>::get_memory_usage()
+{
+    return static_cast<long>(nodes.capacity() * sizeof(CompactNode) + heights.capacity() * sizeof(int8_t));
+}
+
+
+/******************************************************* build tree from array functions *******************************************************/
+
+
+template <class ptr_type, class condition>
+void AVLCompactTree<ptr_type, condition>::build_from_array(ptr_type** data_array, int size)
+{
+    if (size < 1 || data_array == nullptr)
+    {
+        return;
+    }
+    nodes.resize(1);
+    heights.resize(1);
+    free_list = NIL;
+    reserve(size);
+    root = build_tree_from_array(data_array, 0, size - 1);
+    num_of_nodes = size;
+}
+
+
+template <class ptr_type, class condition>
+uint32_t AVLCompactTree<ptr_type, condition>::build_tree_from_array(ptr_type** array, int start, int end)
+{
+    if (start > end)
+    {
+        return NIL;
+    }
+    int mid = (start + end) / 2;
+    uint32_t r = new_node(array[mid]);
+    uint32_t left = build_tree_from_array(array, start, mid - 1);
+    uint32_t right = build_tree_from_array(array, mid + 1, end);
+    nodes[r].left = left;
+    nodes[r].right = right;
+    update_height(r);
+    return r;
+}
+
+
+/******************************************************* tree details functions *******************************************************/
+
+
+template <class ptr_type, class condition>
+int AVLCompactTree<ptr_type, condition>::get_num_of_nodes()
+{
+    return num_of_nodes;
+}
+
+
+template <class ptr_type, class condition>
+int AVLCompactTree<ptr_type, condition>::get_tree_height()
+{
+    return heights[root];
+}
+
+
+template <class ptr_type, class condition>
+ptr_type* AVLCompactTree<ptr_type, condition>::get_max_node()
+{
+    if (root == NIL)
+    {
+        return nullptr;
+    }
+    uint32_t r = root;
+    while (nodes[r].right != NIL)
+    {
+        r = nodes[r].right;
+    }
+    return nodes[r].data;
+}
+
+
+/******************************************************* balancing functions *******************************************************/
+
+
+template <class ptr_type, class condition>
+void AVLCompactTree<ptr_type, condition>::update_height(uint32_t r)
+{
+    int8_t left_height = heights[nodes[r].left];
+    int8_t right_height = heights[nodes[r].right];
+    heights[r] = static_cast<int8_t>(1 + (left_height > right_height ? left_height : right_height));
+}
+
+
+template <class ptr_type, class condition>
+int AVLCompactTree<ptr_type, condition>::get_bf(uint32_t r)
+{
+    return heights[nodes[r].left] - heights[nodes[r].right];
+}
+
+
+template <class ptr_type, class condition>
+uint32_t AVLCompactTree<ptr_type, condition>::make_LL_rotation(uint32_t r)
+{
+    uint32_t A = nodes[r].left;
+    nodes[r].left = nodes[A].right;
+    nodes[A].right = r;
+    update_height(r);
+    update_height(A);
+    return A;
+}
+
+
+template <class ptr_type, class condition>
+uint32_t AVLCompactTree<ptr_type, condition>::make_RR_rotation(uint32_t r)
+{
+    uint32_t A = nodes[r].right;
+    nodes[r].right = nodes[A].left;
+    nodes[A].left = r;
+    update_height(r);
+    update_height(A);
+    return A;
+}
+
+
+template <class ptr_type, class condition>
+uint32_t AVLCompactTree<ptr_type, condition>::balance_tree(uint32_t r)
+{
+    int bf = get_bf(r);
+    if (bf == UNBALANCED_POSITIVE_BF)
+    {
+        if (get_bf(nodes[r].left) < 0)
+        {
+            nodes[r].left = make_RR_rotation(nodes[r].left);
+        }
+        return make_LL_rotation(r);
+    }
+    if (bf == UNBALANCED_NEGATIVE_BF)
+    {
+        if (get_bf(nodes[r].right) > 0)
+        {
+            nodes[r].right = make_LL_rotation(nodes[r].right);
+        }
+        return make_RR_rotation(r);
+    }
+    return r;
+}
+
+
+template <class ptr_type, class condition>
+void AVLCompactTree<ptr_type, condition>::replace_child(uint32_t* path, int depth, uint32_t old_child, uint32_t new_child)
+{
+    if (depth == 0)
+    {
+        root = new_child;
+    }
+    else if (nodes[path[depth - 1]].left == old_child)
+    {
+        nodes[path[depth - 1]].left = new_child;
+    }
+    else
+    {
+        nodes[path[depth - 1]].right = new_child;
+    }
+}
+
+
+template <class ptr_type, class condition>
+void AVLCompactTree<ptr_type, condition>::retrace(uint32_t* path, int depth)
+{
+    for (int i = depth - 1; i >= 0; i--)
+    {
+        uint32_t r = path[i];
+        int old_height = heights[r];
+        update_height(r);
+        uint32_t new_r = balance_tree(r);
+        if (new_r != r)
+        {
+            replace_child(path, i, r, new_r);
+        }
+        if (heights[new_r] == old_height)
+        {
+            return;
+        }
+    }
+}
+
+
+/******************************************************* insert functions *******************************************************/
+
+
+template <class ptr_type, class condition>
+ptr_type* AVLCompactTree<ptr_type, condition>::insert(ptr_type* data)
+{
+    condition cond;
+    uint32_t path[MAX_DEPTH];
+    int depth = 0;
+    uint32_t r = root;
+    Comparison result = Comparison::EQUAL;
+    while (r != NIL)
+    {
+        result = cond(data, nodes[r].data);
+        if (result == Comparison::EQUAL)
+        {
+            return nullptr;
+        }
+        path[depth++] = r;
+        r = (result == Comparison::LESS_THAN) ? nodes[r].left : nodes[r].right;
+    }
+    uint32_t new_junction = new_node(data);
+    if (depth == 0)
+    {
+        root = new_junction;
+    }
+    else if (result == Comparison::LESS_THAN)
+    {
+        nodes[path[depth - 1]].left = new_junction;
+    }
+    else
+    {
+        nodes[path[depth - 1]].right = new_junction;
+    }
+    num_of_nodes++;
+    retrace(path, depth);
+    return data;
+}
+
+
+/******************************************************* search functions *******************************************************/
+
+
+template <class ptr_type, class condition>
+uint32_t AVLCompactTree<ptr_type, condition>::search_node(ptr_type* data)
+{
+    condition cond;
+    uint32_t r = root;
+    while (r != NIL)
+    {
+        Comparison result = cond(data, nodes[r].data);
+        if (result == Comparison::EQUAL)
+        {
+            return r;
+        }
+        r = (result == Comparison::LESS_THAN) ? nodes[r].left : nodes[r].right;
+    }
+    return NIL;
+}
+
+
+template <class ptr_type, class condition>
+ptr_type* AVLCompactTree<ptr_type, condition>::search(ptr_type* data)
+{
+    return nodes[search_node(data)].data;
+}
+
+
+template <class ptr_type, class condition>
+ptr_type* AVLCompactTree<ptr_type, condition>::get_closest_left(ptr_type* data)
+{
+    condition cond;
+    uint32_t r = root;
+    uint32_t last_left_father = NIL;    // last node the descent went right from
+    while (r != NIL)
+    {
+        Comparison result = cond(data, nodes[r].data);
+        if (result == Comparison::EQUAL)
+        {
+            if (nodes[r].left == NIL)
+            {
+                return nodes[last_left_father].data;
+            }
+            r = nodes[r].left;
+            while (nodes[r].right != NIL)
+            {
+                r = nodes[r].right;
+            }
+            return nodes[r].data;
+        }
+        if (result == Comparison::LESS_THAN)
+        {
+            r = nodes[r].left;
+        }
+        else
+        {
+            last_left_father = r;
+            r = nodes[r].right;
+        }
+    }
+    return nullptr;
+}
+
+
+template <class ptr_type, class condition>
+ptr_type* AVLCompactTree<ptr_type, condition>::get_closest_right(ptr_type* data)
+{
+    condition cond;
+    uint32_t r = root;
+    uint32_t last_right_father = NIL;   // last node the descent went left from
+    while (r != NIL)
+    {
+        Comparison result = cond(data, nodes[r].data);
+        if (result == Comparison::EQUAL)
+        {
+            if (nodes[r].right == NIL)
+            {
+                return nodes[last_right_father].data;
+            }
+            r = nodes[r].right;
+            while (nodes[r].left != NIL)
+            {
+                r = nodes[r].left;
+            }
+            return nodes[r].data;
+        }
+        if (result == Comparison::GREATER_THAN)
+        {
+            r = nodes[r].right;
+        }
+        else
+        {
+            last_right_father = r;
+            r = nodes[r].left;
+        }
+    }
+    return nullptr;
+}
+
+
+/******************************************************* travel functions *******************************************************/
+
+
+template <class ptr_type, class condition>
+ptr_type** AVLCompactTree<ptr_type, condition>::inorder()
+{
+    if (root == NIL)
+    {
+        return nullptr;
+    }
+    ptr_type** elements_by_order = new ptr_type*[num_of_nodes];
+    uint32_t stack[MAX_DEPTH];
+    int depth = 0;
+    int index = 0;
+    uint32_t r = root;
+    while (r != NIL || depth > 0)
+    {
+        while (r != NIL)
+        {
+            stack[depth++] = r;
+            r = nodes[r].left;
+        }
+        r = stack[--depth];
+        elements_by_order[index++] = nodes[r].data;
+        r = nodes[r].right;
+    }
+    return elements_by_order;
+}
+
+
+/******************************************************* removing functions *******************************************************/
+
+
+template <class ptr_type, class condition>
+bool AVLCompactTree<ptr_type, condition>::remove(ptr_type* data)
+{
+    return remove_node(data, false);
+}
+
+
+template <class ptr_type, class condition>
+bool AVLCompactTree<ptr_type, condition>::remove_and_erase(ptr_type* data)
+{
+    return remove_node(data, true);
+}
+
+
+template <class ptr_type, class condition>
+bool AVLCompactTree<ptr_type, condition>::remove_node(ptr_type* data, bool erase)
+{
+    condition cond;
+    uint32_t path[MAX_DEPTH];
+    int depth = 0;
+    uint32_t r = root;
+    while (r != NIL)
+    {
+        Comparison result = cond(data, nodes[r].data);
+        if (result == Comparison::EQUAL)
+        {
+            break;
+        }
+        path[depth++] = r;
+        r = (result == Comparison::LESS_THAN) ? nodes[r].left : nodes[r].right;
+    }
+    if (r == NIL)
+    {
+        return false;
+    }
+    if (erase)
+    {
+        delete nodes[r].data;
+    }
+    if (nodes[r].left != NIL && nodes[r].right != NIL) // junction has both children - takes the data of its successor
+    {
+        uint32_t junction = r;
+        path[depth++] = r;
+        r = nodes[r].left;
+        while (nodes[r].right != NIL)
+        {
+            path[depth++] = r;
+            r = nodes[r].right;
+        }
+        nodes[junction].data = nodes[r].data;
+    }
+    uint32_t child = (nodes[r].left != NIL) ? nodes[r].left : nodes[r].right;
+    replace_child(path, depth, r, child);
+    free_node(r);
+    num_of_nodes--;
+    retrace(path, depth);
+    return true;
+}
+
+
+template <class ptr_type, class condition>
+void AVLCompactTree<ptr_type, condition>::erase_data()
+{
+    for (size_t i = 1; i < nodes.size(); i++)
+    {
+        if (nodes[i].data != nullptr)
+        {
+            delete nodes[i].data;
+        }
+    }
+}
+
+#endif //AVL_AVLCOMPACTTREE_H
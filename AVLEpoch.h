@@ -0,0 +1,217 @@
+#ifndef AVL_AVLEPOCH_H
+#define AVL_AVLEPOCH_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/** epoch based reclamation for the concurrent trees
+ * a reader pins the current epoch for as long as it may hold pointers into the tree (see Guard),
+ * a writer that unlinks an object retires it with the epoch of the unlink, and the object is freed only
+ * once every pinned reader has an epoch newer than that, so no reader can still reach it
+ * readers never block and never write shared memory other than their own slot
+ */
+class AVLEpochManager
+{
+private:
+    struct alignas(64) Slot
+    {
+        std::atomic<uint64_t> epoch;    // epoch pinned by the reader holding the slot, IDLE if free
+    };
+
+    struct Retired
+    {
+        void* object;
+        void (*free_function)(void* object, void* context);
+        void* context;
+        uint64_t epoch;     // epoch the object was unlinked in
+    };
+
+    // - sub function for Guard: claims a free slot (starting at this thread's own one) with the current epoch
+    int pin();
+
+    // - sub function for Guard: frees the slot
+    void unpin(int slot);
+
+    // - sub function for reclaim and synchronize: frees the retired objects older than 'safe_epoch', lock must be held
+    void free_retired_before(uint64_t safe_epoch);
+
+    // - sub function for reclaim: returns the oldest epoch pinned by a reader (or the current epoch if none)
+    uint64_t get_oldest_pinned_epoch();
+
+    static const int NUM_OF_SLOTS = 128;
+    static const uint64_t IDLE = 0;
+    static const int RECLAIM_THRESHOLD = 256;   // retired objects gathered before retire tries to free them
+
+    Slot slots[NUM_OF_SLOTS];
+    std::atomic<uint64_t> global_epoch;
+    std::mutex retired_lock;            // writers retire under it, readers never take it
+    std::vector<Retired> retired;
+
+public:
+    /** pins the current epoch for the lifetime of the guard - anything read from the tree while the guard
+     * lives stays allocated until it's destroyed
+     */
+    class Guard
+    {
+    private:
+        AVLEpochManager* manager;
+        int slot;
+
+    public:
+        explicit Guard(AVLEpochManager& epochs) : manager(&epochs), slot(epochs.pin()) {}
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+        ~Guard() { manager->unpin(slot); }
+    };
+
+    // constructor
+    AVLEpochManager();
+
+    AVLEpochManager(const AVLEpochManager&) = delete;
+    AVLEpochManager& operator=(const AVLEpochManager&) = delete;
+
+    /** hands an object that was just unlinked from the tree over for freeing
+     * free_function(object, context) is called once no reader can hold it - from inside a later retire,
+     * reclaim or synchronize call, or from the destructor
+     */
+    void retire(void* object, void (*free_function)(void* object, void* context), void* context);
+
+    // frees the retired objects that no reader can hold anymore, without waiting
+    void reclaim();
+
+    // waits until every reader pinned before the call is done, then frees every retired object
+    void synchronize();
+
+    // destructor - frees every retired object, no reader may be pinned
+    ~AVLEpochManager();
+};
+
+
+/******************************************************* reader functions *******************************************************/
+
+
+inline AVLEpochManager::AVLEpochManager() : global_epoch(1)
+{
+    for (int i = 0; i < NUM_OF_SLOTS; i++)
+    {
+        slots[i].epoch.store(IDLE, std::memory_order_relaxed);
+    }
+}
+
+
+inline int AVLEpochManager::pin()
+{
+    // every thread starts from a slot of its own, so readers don't share cache lines
+    static std::atomic<unsigned> next_thread_slot(0);
+    static thread_local unsigned thread_slot = next_thread_slot.fetch_add(1, std::memory_order_relaxed);
+    int slot = static_cast<int>(thread_slot % NUM_OF_SLOTS);
+    while (true)
+    {
+        uint64_t idle = IDLE;
+        uint64_t epoch = global_epoch.load();
+        if (slots[slot].epoch.compare_exchange_strong(idle, epoch))
+        {
+            return slot;
+        }
+        slot = (slot + 1) % NUM_OF_SLOTS;
+        if (slot == static_cast<int>(thread_slot % NUM_OF_SLOTS))
+        {
+            std::this_thread::yield();  // more pinned readers than slots - wait for one to leave
+        }
+    }
+}
+
+
+inline void AVLEpochManager::unpin(int slot)
+{
+    slots[slot].epoch.store(IDLE, std::memory_order_release);
+}
+
+
+/******************************************************* writer functions *******************************************************/
+
+
+inline void AVLEpochManager::retire(void* object, void (*free_function)(void* object, void* context), void* context)
+{
+    std::lock_guard<std::mutex> lock(retired_lock);
+    retired.push_back(Retired{object, free_function, context, global_epoch.load()});
+    if (static_cast<int>(retired.size()) >= RECLAIM_THRESHOLD)
+    {
+        // readers pinned from now on can't reach anything retired so far
+        global_epoch.fetch_add(1);
+        free_retired_before(get_oldest_pinned_epoch());
+    }
+}
+
+
+inline void AVLEpochManager::reclaim()
+{
+    std::lock_guard<std::mutex> lock(retired_lock);
+    global_epoch.fetch_add(1);
+    free_retired_before(get_oldest_pinned_epoch());
+}
+
+
+inline void AVLEpochManager::synchronize()
+{
+    uint64_t epoch = global_epoch.fetch_add(1) + 1;
+    for (int i = 0; i < NUM_OF_SLOTS; i++)
+    {
+        uint64_t pinned = slots[i].epoch.load();
+        while (pinned != IDLE && pinned < epoch)
+        {
+            std::this_thread::yield();
+            pinned = slots[i].epoch.load();
+        }
+    }
+    std::lock_guard<std::mutex> lock(retired_lock);
+    free_retired_before(epoch);
+}
+
+
+inline uint64_t AVLEpochManager::get_oldest_pinned_epoch()
+{
+    uint64_t oldest = global_epoch.load();
+    for (int i = 0; i < NUM_OF_SLOTS; i++)
+    {
+        uint64_t pinned = slots[i].epoch.load();
+        if (pinned != IDLE && pinned < oldest)
+        {
+            oldest = pinned;
+        }
+    }
+    return oldest;
+}
+
+
+inline void AVLEpochManager::free_retired_before(uint64_t safe_epoch)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < retired.size(); i++)
+    {
+        if (retired[i].epoch < safe_epoch)
+        {
+            retired[i].free_function(retired[i].object, retired[i].context);
+        }
+        else
+        {
+            retired[kept++] = retired[i];
+        }
+    }
+    retired.resize(kept);
+}
+
+
+inline AVLEpochManager::~AVLEpochManager()
+{
+    for (size_t i = 0; i < retired.size(); i++)
+    {
+        retired[i].free_function(retired[i].object, retired[i].context);
+    }
+}
+
+#endif //AVL_AVLEPOCH_H
@@ -0,0 +1,469 @@
+#ifndef AVL_AVLFROZENTREE_H
+#define AVL_AVLFROZENTREE_H
+
+#include "AVLTree.h"
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+
+/** immutable read-optimized snapshot of an AVL tree (made by AVLTree::freeze())
+ * the elements are kept in Eytzinger (BFS) order: the children of place k are 2k and 2k+1, so a descent reads
+ * one growing prefix of an array, compares without branches and prefetches the lines a few levels ahead
+ * with a key extractor the keys are kept in a parallel array and compared without touching the data, and
+ * integral keys also get a block index (a static B-tree of one cache line per block) compared with SIMD
+ */
+template <class ptr_type, class condition, class key_extractor = void>
+class AVLFrozenTree
+{
+public:
+    using key_type = typename AVLExtractedKey<key_extractor>::type;
+
+private:
+    static const bool CACHED_KEYS = !std::is_void<key_extractor>::value;
+
+    // integral keys get the SIMD block index
+    static const bool KEY_BLOCKS = std::is_integral<key_type>::value && !std::is_same<key_type, bool>::value;
+
+    // key_type if it exists, placeholders otherwise
+    using cached_key_type = std::conditional_t<CACHED_KEYS, key_type, char>;
+    using block_key_type = std::conditional_t<KEY_BLOCKS, key_type, long>;
+
+    static const int CACHE_LINE = 64;
+    static const int BLOCK_SIZE = CACHE_LINE / sizeof(block_key_type);
+
+    // - sub function for the constructor: fills the Eytzinger places in order of the input
+    template <class input_iterator>
+    void fill(input_iterator& element, size_t k, std::vector<uint32_t>& place_by_order);
+
+    // - sub function for the constructor: fills the block index in order of the elements
+    void fill_blocks(size_t block, size_t& index, const std::vector<uint32_t>& place_by_order);
+
+    // - sub function for all descents: compares data (or a lightweight key) to the element in place k
+    template <class probe_type>
+    Comparison compare(const probe_type& data, size_t k) const;
+
+    // - sub function for lower_bound: returns the place of the first element that is not smaller than data (0 if none)
+    template <class probe_type>
+    size_t lower_bound_place(const probe_type& data) const;
+
+    // -- sub function for lower_bound_place: searches the block index with one SIMD compare per block
+    size_t lower_bound_in_blocks(block_key_type key) const;
+
+    // --- sub function for lower_bound_in_blocks: counts the keys of a block that are smaller than key
+    static int count_smaller_in_block(const block_key_type* block, block_key_type key);
+
+    // - sub function for upper_bound: returns the place of the first element that is bigger than data (0 if none)
+    template <class probe_type>
+    size_t upper_bound_place(const probe_type& data) const;
+
+    // - sub function for get_closest_left: returns the place before k by order (0 if none)
+    size_t prev_place(size_t k) const;
+
+    // - sub function for get_closest_right: returns the place after k by order (0 if none)
+    size_t next_place(size_t k) const;
+
+    // - sub function for the descents: prefetches the line of place k into the cache
+    void prefetch(size_t k) const;
+
+    size_t num_of_nodes;
+    std::vector<ptr_type*> elements;            // place 0 is never used
+    std::vector<cached_key_type> keys;          // key of every place, only with a key extractor
+    std::vector<block_key_type> block_keys;     // block index, only for integral keys
+    std::vector<uint32_t> block_places;         // Eytzinger place of every key of the block index
+    size_t num_of_blocks;
+
+public:
+    // constructor of an empty snapshot
+    AVLFrozenTree() : num_of_nodes(0), elements(1, nullptr), num_of_blocks(0) {}
+
+    // builds the snapshot from 'size' data pointers given in order of template condition
+    template <class input_iterator>
+    AVLFrozenTree(input_iterator first, int size);
+
+    // returns how many nodes the snapshot consists
+    int get_num_of_nodes() const;
+
+    /** returns the data that is equal to 'data' (or to a lightweight key, see AVLTree::find)
+     * returns nullptr - if doesn't exist
+     */
+    template <class probe_type>
+    ptr_type* search(const probe_type& data) const;
+
+    // returns the first data that is not smaller than 'data' (nullptr if there is none)
+    template <class probe_type>
+    ptr_type* lower_bound(const probe_type& data) const;
+
+    // returns the first data that is bigger than 'data' (nullptr if there is none)
+    template <class probe_type>
+    ptr_type* upper_bound(const probe_type& data) const;
+
+    /**
+     * returns the closest left neighbor data (smaller then 'data')
+     * returns nullptr - if doesn't exist or 'data' isn't in the snapshot
+     */
+    template <class probe_type>
+    ptr_type* get_closest_left(const probe_type& data) const;
+
+    /**
+     * returns the closest right neighbor data (bigger then 'data')
+     * returns nullptr - if doesn't exist or 'data' isn't in the snapshot
+     */
+    template <class probe_type>
+    ptr_type* get_closest_right(const probe_type& data) const;
+};
+
+
+/******************************************************* build functions *******************************************************/
+
+
+template <class ptr_type, class condition, class key_extractor>
+template <class input_iterator>
+AVLFrozenTree<ptr_type, condition, key_extractor>::AVLFrozenTree(input_iterator first, int size) :
+    num_of_nodes(size < 0 ? 0 : size), elements(num_of_nodes + 1, nullptr), num_of_blocks(0)
+{
+    std::vector<uint32_t> place_by_order;
+    if (CACHED_KEYS)
+    {
+        keys.resize(num_of_nodes + 1);
+    }
+    if (KEY_BLOCKS)
+    {
+        place_by_order.reserve(num_of_nodes);
+    }
+    fill(first, 1, place_by_order);
+    if constexpr (KEY_BLOCKS)
+    {
+        num_of_blocks = (num_of_nodes + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        block_keys.resize(num_of_blocks * BLOCK_SIZE);
+        block_places.resize(num_of_blocks * BLOCK_SIZE);
+        size_t index = 0;
+        fill_blocks(0, index, place_by_order);
+    }
+}
+
+
+template <class ptr_type, class condition, class key_extractor>
+template <class input_iterator>
+void AVLFrozenTree<ptr_type, condition, key_extractor>::fill(input_iterator& element, size_t k, std::vector<uint32_t>& place_by_order)
+{
+    if (k > num_of_nodes)
+    {
+        return;
+    }
+    fill(element, 2 * k, place_by_order);
+    elements[k] = *element;
+    if constexpr (CACHED_KEYS)
+    {
+        keys[k] = key_extractor()(elements[k]);
+    }
+    if (KEY_BLOCKS)
+    {
+        place_by_order.push_back(static_cast<uint32_t>(k));
+    }
+    ++element;
+    fill(element, 2 * k + 1, place_by_order);
+}
+
+
+template <class ptr_type, class condition, class key_extractor>
+void AVLFrozenTree<ptr_type, condition, key_extractor>::fill_blocks(size_t block, size_t& index, const std::vector<uint32_t>& place_by_order)
+{
+    if (block >= num_of_blocks)
+    {
+        return;
+    }
+    for (int i = 0; i < BLOCK_SIZE; i++)
+    {
+        fill_blocks(block * (BLOCK_SIZE + 1) + i + 1, index, place_by_order);
+        size_t slot = block * BLOCK_SIZE + i;
+        if (index < num_of_nodes)
+        {
+            block_places[slot] = place_by_order[index];
+            block_keys[slot] = keys[place_by_order[index]];
+            index++;
+        }
+        else
+        {
+            // padding after the biggest key, never returned since its place is 0
+            block_places[slot] = 0;
+            block_keys[slot] = std::numeric_limits<block_key_type>::max();
+        }
+    }
+    fill_blocks(block * (BLOCK_SIZE + 1) + BLOCK_SIZE + 1, index, place_by_order);
+}
+
+
+template <class ptr_type, class condition, class key_extractor>
+int AVLFrozenTree<ptr_type, condition, key_extractor>::get_num_of_nodes() const
+{
+    return static_cast<int>(num_of_nodes);
+}
+
+
+/******************************************************* descent functions *******************************************************/
+
+
+template <class ptr_type, class condition, class key_extractor>
+template <class probe_type>
+Comparison AVLFrozenTree<ptr_type, condition, key_extractor>::compare(const probe_type& data, size_t k) const
+{
+    if constexpr (CACHED_KEYS)
+    {
+        if constexpr (std::is_convertible<probe_type, const ptr_type*>::value)
+        {
+            return compare(key_extractor()(data), k);
+        }
+        else
+        {
+            if (data < keys[k])
+            {
+                return Comparison::LESS_THAN;
+            }
+            if (keys[k] < data)
+            {
+                return Comparison::GREATER_THAN;
+            }
+            return Comparison::EQUAL;
+        }
+    }
+    else
+    {
+        condition cond;
+        return cond(data, elements[k]);
+    }
+}
+
+
+template <class ptr_type, class condition, class key_extractor>
+void AVLFrozenTree<ptr_type, condition, key_extractor>::prefetch(size_t k) const
+{
+    // the descendants of k a few levels down (8k..8k+7 for pointers) share one cache line
+    if (CACHED_KEYS)
+    {
+        size_t ahead = k * (CACHE_LINE / sizeof(cached_key_type));
+        if (ahead < keys.size())
+        {
+            __builtin_prefetch(keys.data() + ahead);
+        }
+    }
+    else
+    {
+        size_t ahead = k * (CACHE_LINE / sizeof(ptr_type*));
+        if (ahead < elements.size())
+        {
+            __builtin_prefetch(elements.data() + ahead);
+        }
+    }
+}
+
+
+template <class ptr_type, class condition, class key_extractor>
+template <class probe_type>
+size_t AVLFrozenTree<ptr_type, condition, key_extractor>::lower_bound_place(const probe_type& data) const
+{
+    if constexpr (KEY_BLOCKS)
+    {
+        if constexpr (std::is_convertible<probe_type, const ptr_type*>::value)
+        {
+            return lower_bound_in_blocks(key_extractor()(data));
+        }
+        else
+        {
+            return lower_bound_in_blocks(data);
+        }
+    }
+    else
+    {
+        size_t k = 1;
+        while (k <= num_of_nodes)
+        {
+            prefetch(k);
+            k = 2 * k + (compare(data, k) == Comparison::GREATER_THAN);
+        }
+        // drop the right turns taken after the last left turn - that left turn was at the answer
+        k >>= __builtin_ffsll(static_cast<long long>(~k));
+        return k;
+    }
+}
+
+
+template <class ptr_type, class condition, class key_extractor>
+template <class probe_type>
+size_t AVLFrozenTree<ptr_type, condition, key_extractor>::upper_bound_place(const probe_type& data) const
+{
+    size_t k = 1;
+    while (k <= num_of_nodes)
+    {
+        prefetch(k);
+        k = 2 * k + (compare(data, k) != Comparison::LESS_THAN);
+    }
+    k >>= __builtin_ffsll(static_cast<long long>(~k));
+    return k;
+}
+
+
+template <class ptr_type, class condition, class key_extractor>
+int AVLFrozenTree<ptr_type, condition, key_extractor>::count_smaller_in_block(const block_key_type* block, block_key_type key)
+{
+#if defined(__GNUC__)
+    typedef block_key_type block_vector __attribute__((vector_size(CACHE_LINE)));
+    block_vector block_copy;
+    block_vector key_copy;
+    std::memcpy(&block_copy, block, sizeof(block_vector));
+    for (int i = 0; i < BLOCK_SIZE; i++)
+    {
+        key_copy[i] = key;
+    }
+    block_vector mask = block_copy < key_copy;     // -1 in every lane that is smaller
+    int count = 0;
+    for (int i = 0; i < BLOCK_SIZE; i++)
+    {
+        count -= static_cast<int>(mask[i]);
+    }
+    return count;
+#else
+    int count = 0;
+    for (int i = 0; i < BLOCK_SIZE; i++)
+    {
+        count += block[i] < key;
+    }
+    return count;
+#endif
+}
+
+
+template <class ptr_type, class condition, class key_extractor>
+size_t AVLFrozenTree<ptr_type, condition, key_extractor>::lower_bound_in_blocks(block_key_type key) const
+{
+    size_t block = 0;
+    size_t place = 0;
+    while (block < num_of_blocks)
+    {
+        const block_key_type* block_start = block_keys.data() + block * BLOCK_SIZE;
+        int i = count_smaller_in_block(block_start, key);
+        if (i < BLOCK_SIZE)
+        {
+            place = block_places[block * BLOCK_SIZE + i];
+        }
+        block = block * (BLOCK_SIZE + 1) + i + 1;
+        if (block < num_of_blocks)
+        {
+            __builtin_prefetch(block_keys.data() + block * BLOCK_SIZE);
+        }
+    }
+    return place;
+}
+
+
+template <class ptr_type, class condition, class key_extractor>
+size_t AVLFrozenTree<ptr_type, condition, key_extractor>::prev_place(size_t k) const
+{
+    if (2 * k <= num_of_nodes)
+    {
+        k = 2 * k;
+        while (2 * k + 1 <= num_of_nodes)
+        {
+            k = 2 * k + 1;
+        }
+        return k;
+    }
+    while (k != 0 && (k & 1) == 0)
+    {
+        k >>= 1;
+    }
+    return k >> 1;
+}
+
+
+template <class ptr_type, class condition, class key_extractor>
+size_t AVLFrozenTree<ptr_type, condition, key_extractor>::next_place(size_t k) const
+{
+    if (2 * k + 1 <= num_of_nodes)
+    {
+        k = 2 * k + 1;
+        while (2 * k <= num_of_nodes)
+        {
+            k = 2 * k;
+        }
+        return k;
+    }
+    while ((k & 1) == 1)
+    {
+        k >>= 1;
+    }
+    return k >> 1;
+}
+
+
+/******************************************************* search functions *******************************************************/
+
+
+template <class ptr_type, class condition, class key_extractor>
+template <class probe_type>
+ptr_type* AVLFrozenTree<ptr_type, condition, key_extractor>::search(const probe_type& data) const
+{
+    size_t k = lower_bound_place(data);
+    if (k == 0 || compare(data, k) != Comparison::EQUAL)
+    {
+        return nullptr;
+    }
+    return elements[k];
+}
+
+
+template <class ptr_type, class condition, class key_extractor>
+template <class probe_type>
+ptr_type* AVLFrozenTree<ptr_type, condition, key_extractor>::lower_bound(const probe_type& data) const
+{
+    return elements[lower_bound_place(data)];
+}
+
+
+template <class ptr_type, class condition, class key_extractor>
+template <class probe_type>
+ptr_type* AVLFrozenTree<ptr_type, condition, key_extractor>::upper_bound(const probe_type& data) const
+{
+    return elements[upper_bound_place(data)];
+}
+
+
+template <class ptr_type, class condition, class key_extractor>
+template <class probe_type>
+ptr_type* AVLFrozenTree<ptr_type, condition, key_extractor>::get_closest_left(const probe_type& data) const
+{
+    size_t k = lower_bound_place(data);
+    if (k == 0 || compare(data, k) != Comparison::EQUAL)
+    {
+        return nullptr;
+    }
+    return elements[prev_place(k)];
+}
+
+
+template <class ptr_type, class condition, class key_extractor>
+template <class probe_type>
+ptr_type* AVLFrozenTree<ptr_type, condition, key_extractor>::get_closest_right(const probe_type& data) const
+{
+    size_t k = lower_bound_place(data);
+    if (k == 0 || compare(data, k) != Comparison::EQUAL)
+    {
+        return nullptr;
+    }
+    return elements[next_place(k)];
+}
+
+
+/******************************************************* AVLTree::freeze *******************************************************/
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+AVLFrozenTree<ptr_type, condition, key_extractor> AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::freeze()
+{
+    return AVLFrozenTree<ptr_type, condition, key_extractor>(begin(), num_of_nodes);
+}
+
+#endif //AVL_AVLFROZENTREE_H
@@ -0,0 +1,549 @@
+#ifndef AVL_AVLMAPPEDTREE_H
+#define AVL_AVLMAPPEDTREE_H
+
+#include "AVLTree.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/** codec of the data of a tree image (see AVLTree::save and AVLMappedTree) - a codec is a policy with
+ * static size_t size(const ptr_type* data) - bytes of the image of data
+ * static void encode(const ptr_type* data, char* out) - writes the image of data to out
+ * static const ptr_type* view(const char* image) - the data read in place from its image, without copying
+ * static ptr_type* decode(const char* image) - a new object (by new) with the data of the image
+ * images start at a multiple of AVL_IMAGE_ALIGNMENT in the file, so view can point into the mapping
+ * this one is for trivially copyable data - the image is the object itself
+ */
+template <class ptr_type>
+struct AVLFlatCodec
+{
+    static_assert(std::is_trivially_copyable<ptr_type>::value, "AVLFlatCodec needs trivially copyable data - write a codec");
+
+    static size_t size(const ptr_type*)
+    {
+        return sizeof(ptr_type);
+    }
+
+    static void encode(const ptr_type* data, char* out)
+    {
+        std::memcpy(out, data, sizeof(ptr_type));
+    }
+
+    static const ptr_type* view(const char* image)
+    {
+        return reinterpret_cast<const ptr_type*>(image);
+    }
+
+    static ptr_type* decode(const char* image)
+    {
+        return new ptr_type(*view(image));
+    }
+};
+
+
+/** layout of a tree image file - everything is found by offsets from the start of the file, so the image can be
+ * mapped anywhere: the header, the nodes by order of template condition, then the data images of the nodes by order
+ */
+struct AVLImageHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;    // ENDIANNESS as written - an image is read only on machines of the same byte order
+    uint32_t node_size;     // sizeof(AVLImageNode) as written
+    uint32_t root;          // place of the root node, NIL if the tree is empty
+    uint64_t num_of_nodes;
+    uint64_t nodes;         // offset of the nodes
+    uint64_t file_size;
+
+    static constexpr char MAGIC[8] = {'A', 'V', 'L', 'I', 'M', 'A', 'G', 'E'};
+    static const uint32_t VERSION = 1;
+    static const uint32_t ENDIANNESS = 0x01020304;
+    static const uint32_t NIL = 0xFFFFFFFF;
+};
+
+struct AVLImageNode
+{
+    uint64_t data;      // offset of the image of the data
+    uint32_t left;      // places of the children (the place of a node is its place by order), NIL for none
+    uint32_t right;
+};
+
+static const uint64_t AVL_IMAGE_ALIGNMENT = 16;
+
+
+/** read-only AVL tree mapped from an image file written by AVLTree::save
+ * load_mmap maps the file and the tree is searchable at once - descents walk the node offsets of the mapping and
+ * compare with template condition on the data read in place by the codec, nothing is read from the file upfront
+ * and nothing is decoded, pages are read by the OS as the searches touch them
+ * the first change (insert, remove_and_erase, promote) turns it into a mutable AVLTree: every data image is decoded
+ * into a new object, the tree is built from them in O(n) and the file is unmapped
+ * the tree owns its data once it's mutable - data given to insert must be allocated by new, and the data of the
+ * tree is erased with it
+ * POSIX only (mmap)
+ */
+template <class ptr_type, class condition, class codec = AVLFlatCodec<ptr_type>>
+class AVLMappedTree
+{
+public:
+    typedef AVLTree<ptr_type, condition> tree_type;
+
+private:
+    // - sub function for all readers: the data of node place k, read in place
+    const ptr_type* view(uint32_t k) const;
+
+    // - sub function for all readers: compares data to the data of node place k
+    Comparison compare(const ptr_type* data, uint32_t k) const;
+
+    // - sub function for the readers: returns the place of the node equal to data (NIL if doesn't exist)
+    uint32_t search_place(const ptr_type* data) const;
+
+    // - sub function for for_each_in_range: returns the place of the first node that is not smaller than data (n if none)
+    uint32_t lower_bound_place(const ptr_type* data) const;
+
+    /** - sub function for load_mmap: checks every node of the mapped image in O(n), so no descent leaves the mapping -
+     * a child must be in the range of places of its father's side (which also rules out cycles) and every node must
+     * be reached from the root, data images must start inside the file, aligned and by order
+     */
+    bool check_nodes(uint64_t file_size) const;
+
+    // - sub function for load_mmap and promote: unmaps the image
+    void unmap();
+
+    const char* image;          // start of the mapping, nullptr if nothing is mapped
+    size_t image_size;
+    const AVLImageNode* nodes;
+    uint32_t root;
+    uint32_t num_of_nodes;
+    std::unique_ptr<tree_type> tree;    // the mutable tree once the image was promoted
+
+    static const uint32_t NIL = AVLImageHeader::NIL;
+
+public:
+    // constructor of an empty tree
+    AVLMappedTree() : image(nullptr), image_size(0), nodes(nullptr), root(NIL), num_of_nodes(0) {}
+
+    AVLMappedTree(const AVLMappedTree&) = delete;
+    AVLMappedTree& operator=(const AVLMappedTree&) = delete;
+
+    /** maps the image file at 'path' (written by AVLTree::save with the same codec) in place of the tree's nodes
+     * the header and the links of every node are checked in O(n), without reading the data images - a codec
+     * whose images have sizes of their own must not read past the start of the next image
+     * returns false - if the file can't be mapped, isn't an image of this machine or is corrupt (the tree is then empty)
+     */
+    bool load_mmap(const char* path);
+
+    // returns true while the tree is read from the mapped image (before the first change)
+    bool is_mapped() const;
+
+    // returns how many nodes the tree consists
+    int get_num_of_nodes() const;
+
+    /** returns the data of the node that is equal to 'data' - points into the mapping while mapped
+     *  returns nullptr - if node doesn't exist
+     */
+    const ptr_type* search(const ptr_type* data) const;
+
+    /**
+     * returns the data of the closest left neighbor node (smaller then the node)
+     * returns nullptr - if doesn't exist
+     */
+    const ptr_type* get_closest_left(const ptr_type* data) const;
+
+    /**
+     * returns the data of the closest right neighbor node (bigger then the node)
+     * returns nullptr - if doesn't exist
+     */
+    const ptr_type* get_closest_right(const ptr_type* data) const;
+
+    /** calls visitor(data) for every node between 'lo' and 'hi' (both included), by order
+     * reads the data images one after the other while mapped
+     */
+    template <class visitor_type>
+    void for_each_in_range(const ptr_type* lo, const ptr_type* hi, visitor_type visitor) const;
+
+    /** decodes the image into a mutable AVLTree (if still mapped) and returns it
+     * the data of the tree is owned by this object
+     */
+    tree_type& promote();
+
+    /** inserts a new node to the tree, promoting it first - the tree takes over data
+     * returns true - if node is created
+     * returns false - if node already exists (data isn't taken)
+     */
+    bool insert(ptr_type* data);
+
+    /** removes the node that is equal to 'data' and erases its data, promoting the tree first
+     * returns true - if node is found and removed
+     * returns false - if node doesn't exist
+     */
+    bool remove_and_erase(ptr_type* data);
+
+    // destructor - unmaps the image, or erases the data of the promoted tree
+    ~AVLMappedTree();
+};
+
+
+/******************************************************* AVLTree::save *******************************************************/
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+template <class codec>
+bool AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::save(const char* path)
+{
+    std::FILE* file = std::fopen(path, "wb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+    AVLImageHeader header = {};
+    std::memcpy(header.magic, AVLImageHeader::MAGIC, sizeof(header.magic));
+    header.version = AVLImageHeader::VERSION;
+    header.byte_order = AVLImageHeader::ENDIANNESS;
+    header.node_size = sizeof(AVLImageNode);
+    header.root = (root == nullptr) ? AVLImageHeader::NIL : static_cast<uint32_t>(get_size(root->left));
+    header.num_of_nodes = static_cast<uint64_t>(num_of_nodes);
+    header.nodes = sizeof(AVLImageHeader);
+    bool written = std::fwrite(&header, sizeof(header), 1, file) == 1;
+
+    // the nodes by order - the place of a child follows from the subtree sizes
+    uint64_t first_data = header.nodes + header.num_of_nodes * sizeof(AVLImageNode);
+    first_data = (first_data + AVL_IMAGE_ALIGNMENT - 1) / AVL_IMAGE_ALIGNMENT * AVL_IMAGE_ALIGNMENT;
+    uint64_t offset = first_data;
+    uint32_t place = 0;
+    for (node_type* r = min_node; r != nullptr && written; r = get_next_node(r), place++)
+    {
+        AVLImageNode node;
+        node.data = offset;
+        node.left = (r->left == nullptr) ? AVLImageHeader::NIL : place - get_size(r->left) + get_size(r->left->left);
+        node.right = (r->right == nullptr) ? AVLImageHeader::NIL : place + 1 + get_size(r->right->left);
+        written = std::fwrite(&node, sizeof(node), 1, file) == 1;
+        offset += (codec::size(r->get_data()) + AVL_IMAGE_ALIGNMENT - 1) / AVL_IMAGE_ALIGNMENT * AVL_IMAGE_ALIGNMENT;
+    }
+    header.file_size = offset;
+
+    // the data images by order, every one padded to the alignment
+    std::vector<char> buffer(first_data - (header.nodes + header.num_of_nodes * sizeof(AVLImageNode)), 0);
+    written = written && (buffer.empty() || std::fwrite(buffer.data(), buffer.size(), 1, file) == 1);
+    for (node_type* r = min_node; r != nullptr && written; r = get_next_node(r))
+    {
+        size_t size = codec::size(r->get_data());
+        buffer.assign((size + AVL_IMAGE_ALIGNMENT - 1) / AVL_IMAGE_ALIGNMENT * AVL_IMAGE_ALIGNMENT, 0);
+        codec::encode(r->get_data(), buffer.data());
+        written = std::fwrite(buffer.data(), buffer.size(), 1, file) == 1;
+    }
+    written = written && std::fseek(file, 0, SEEK_SET) == 0 && std::fwrite(&header, sizeof(header), 1, file) == 1;
+    return (std::fclose(file) == 0) && written;
+}
+
+
+/******************************************************* mapping functions *******************************************************/
+
+
+template <class ptr_type, class condition, class codec>
+bool AVLMappedTree<ptr_type, condition, codec>::load_mmap(const char* path)
+{
+    unmap();
+    if (tree != nullptr)
+    {
+        tree->erase_data();
+        tree.reset();
+    }
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || static_cast<size_t>(file_stat.st_size) < sizeof(AVLImageHeader))
+    {
+        close(fd);
+        return false;
+    }
+    size_t size = static_cast<size_t>(file_stat.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);     // the mapping keeps the file
+    if (mapping == MAP_FAILED)
+    {
+        return false;
+    }
+    image = static_cast<const char*>(mapping);
+    image_size = size;
+    const AVLImageHeader* header = reinterpret_cast<const AVLImageHeader*>(image);
+    bool valid = std::memcmp(header->magic, AVLImageHeader::MAGIC, sizeof(header->magic)) == 0 &&
+                 header->version == AVLImageHeader::VERSION &&
+                 header->byte_order == AVLImageHeader::ENDIANNESS &&
+                 header->node_size == sizeof(AVLImageNode) &&
+                 header->file_size <= size &&
+                 header->num_of_nodes < NIL &&
+                 header->nodes <= header->file_size &&
+                 header->nodes % alignof(AVLImageNode) == 0 &&
+                 header->nodes + header->num_of_nodes * sizeof(AVLImageNode) <= header->file_size &&
+                 (header->num_of_nodes == 0 ? header->root == NIL : header->root < header->num_of_nodes);
+    if (!valid)
+    {
+        unmap();
+        return false;
+    }
+    nodes = reinterpret_cast<const AVLImageNode*>(image + header->nodes);
+    root = header->root;
+    num_of_nodes = static_cast<uint32_t>(header->num_of_nodes);
+    if (!check_nodes(header->file_size))
+    {
+        unmap();
+        return false;
+    }
+    return true;
+}
+
+
+template <class ptr_type, class condition, class codec>
+bool AVLMappedTree<ptr_type, condition, codec>::check_nodes(uint64_t file_size) const
+{
+    uint64_t first_data = static_cast<uint64_t>(reinterpret_cast<const char*>(nodes + num_of_nodes) - image);
+    for (uint32_t k = 0; k < num_of_nodes; k++)
+    {
+        uint64_t data = nodes[k].data;
+        if (data % AVL_IMAGE_ALIGNMENT != 0 || data < first_data || data >= file_size || (k > 0 && data <= nodes[k - 1].data))
+        {
+            return false;
+        }
+    }
+    // the places of a subtree are the range [first, end) - its children take the two sides of its own place
+    struct Subtree
+    {
+        uint32_t place;
+        uint32_t first;
+        uint32_t end;
+    };
+    std::vector<Subtree> pending;
+    if (root != NIL)
+    {
+        pending.push_back({root, 0, num_of_nodes});
+    }
+    uint32_t reached = 0;
+    while (!pending.empty())
+    {
+        Subtree subtree = pending.back();
+        pending.pop_back();
+        if (subtree.place < subtree.first || subtree.place >= subtree.end)
+        {
+            return false;
+        }
+        reached++;
+        const AVLImageNode& node = nodes[subtree.place];
+        if (node.left != NIL)
+        {
+            pending.push_back({node.left, subtree.first, subtree.place});
+        }
+        if (node.right != NIL)
+        {
+            pending.push_back({node.right, subtree.place + 1, subtree.end});
+        }
+    }
+    return reached == num_of_nodes;
+}
+
+
+template <class ptr_type, class condition, class codec>
+void AVLMappedTree<ptr_type, condition, codec>::unmap()
+{
+    if (image != nullptr)
+    {
+        munmap(const_cast<char*>(image), image_size);
+    }
+    image = nullptr;
+    image_size = 0;
+    nodes = nullptr;
+    root = NIL;
+    num_of_nodes = 0;
+}
+
+
+template <class ptr_type, class condition, class codec>
+bool AVLMappedTree<ptr_type, condition, codec>::is_mapped() const
+{
+    return image != nullptr;
+}
+
+
+template <class ptr_type, class condition, class codec>
+typename AVLMappedTree<ptr_type, condition, codec>::tree_type& AVLMappedTree<ptr_type, condition, codec>::promote()
+{
+    if (tree == nullptr)
+    {
+        // the nodes are already by order, so the data is decoded straight into a sorted array
+        std::vector<ptr_type*> data(num_of_nodes);
+        for (uint32_t k = 0; k < num_of_nodes; k++)
+        {
+            data[k] = codec::decode(image + nodes[k].data);
+        }
+        tree.reset(new tree_type());
+        tree->build_from_array(data.data(), static_cast<int>(num_of_nodes));
+        unmap();
+    }
+    return *tree;
+}
+
+
+/******************************************************* reader functions *******************************************************/
+
+
+template <class ptr_type, class condition, class codec>
+const ptr_type* AVLMappedTree<ptr_type, condition, codec>::view(uint32_t k) const
+{
+    return codec::view(image + nodes[k].data);
+}
+
+
+template <class ptr_type, class condition, class codec>
+Comparison AVLMappedTree<ptr_type, condition, codec>::compare(const ptr_type* data, uint32_t k) const
+{
+    // conditions take the same pointers as in AVLTree - the mapping is read-only, so they must not write through them
+    condition cond;
+    return cond(const_cast<ptr_type*>(data), const_cast<ptr_type*>(view(k)));
+}
+
+
+template <class ptr_type, class condition, class codec>
+uint32_t AVLMappedTree<ptr_type, condition, codec>::search_place(const ptr_type* data) const
+{
+    uint32_t r = root;
+    while (r != NIL)
+    {
+        Comparison result = compare(data, r);
+        if (result == Comparison::EQUAL)
+        {
+            return r;
+        }
+        r = (result == Comparison::LESS_THAN) ? nodes[r].left : nodes[r].right;
+    }
+    return NIL;
+}
+
+
+template <class ptr_type, class condition, class codec>
+uint32_t AVLMappedTree<ptr_type, condition, codec>::lower_bound_place(const ptr_type* data) const
+{
+    uint32_t r = root;
+    uint32_t result = num_of_nodes;
+    while (r != NIL)
+    {
+        if (compare(data, r) == Comparison::GREATER_THAN)
+        {
+            r = nodes[r].right;
+        }
+        else
+        {
+            result = r;
+            r = nodes[r].left;
+        }
+    }
+    return result;
+}
+
+
+template <class ptr_type, class condition, class codec>
+int AVLMappedTree<ptr_type, condition, codec>::get_num_of_nodes() const
+{
+    if (tree != nullptr)
+    {
+        return tree->get_num_of_nodes();
+    }
+    return static_cast<int>(num_of_nodes);
+}
+
+
+template <class ptr_type, class condition, class codec>
+const ptr_type* AVLMappedTree<ptr_type, condition, codec>::search(const ptr_type* data) const
+{
+    if (tree != nullptr)
+    {
+        typename tree_type::node_type* found = tree->search(const_cast<ptr_type*>(data));
+        return (found == nullptr) ? nullptr : found->data;
+    }
+    uint32_t k = search_place(data);
+    return (k == NIL) ? nullptr : view(k);
+}
+
+
+template <class ptr_type, class condition, class codec>
+const ptr_type* AVLMappedTree<ptr_type, condition, codec>::get_closest_left(const ptr_type* data) const
+{
+    if (tree != nullptr)
+    {
+        typename tree_type::node_type* found = tree->get_closest_left(const_cast<ptr_type*>(data));
+        return (found == nullptr) ? nullptr : found->data;
+    }
+    // places are by order, so the neighbors are the next places
+    uint32_t k = search_place(data);
+    return (k == NIL || k == 0) ? nullptr : view(k - 1);
+}
+
+
+template <class ptr_type, class condition, class codec>
+const ptr_type* AVLMappedTree<ptr_type, condition, codec>::get_closest_right(const ptr_type* data) const
+{
+    if (tree != nullptr)
+    {
+        typename tree_type::node_type* found = tree->get_closest_right(const_cast<ptr_type*>(data));
+        return (found == nullptr) ? nullptr : found->data;
+    }
+    uint32_t k = search_place(data);
+    return (k == NIL || k + 1 == num_of_nodes) ? nullptr : view(k + 1);
+}
+
+
+template <class ptr_type, class condition, class codec>
+template <class visitor_type>
+void AVLMappedTree<ptr_type, condition, codec>::for_each_in_range(const ptr_type* lo, const ptr_type* hi, visitor_type visitor) const
+{
+    if (tree != nullptr)
+    {
+        tree->for_each_in_range(const_cast<ptr_type*>(lo), const_cast<ptr_type*>(hi), visitor);
+        return;
+    }
+    for (uint32_t k = lower_bound_place(lo); k < num_of_nodes && compare(hi, k) != Comparison::LESS_THAN; k++)
+    {
+        visitor(view(k));
+    }
+}
+
+
+/******************************************************* writer functions *******************************************************/
+
+
+template <class ptr_type, class condition, class codec>
+bool AVLMappedTree<ptr_type, condition, codec>::insert(ptr_type* data)
+{
+    return promote().insert(data) != nullptr;
+}
+
+
+template <class ptr_type, class condition, class codec>
+bool AVLMappedTree<ptr_type, condition, codec>::remove_and_erase(ptr_type* data)
+{
+    return promote().remove_and_erase(data);
+}
+
+
+template <class ptr_type, class condition, class codec>
+AVLMappedTree<ptr_type, condition, codec>::~AVLMappedTree()
+{
+    unmap();
+    if (tree != nullptr)
+    {
+        tree->erase_data();
+    }
+}
+
+#endif //AVL_AVLMAPPEDTREE_H
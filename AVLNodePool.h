@@ -0,0 +1,359 @@
+#ifndef AVL_AVLNODEPOOL_H
+#define AVL_AVLNODEPOOL_H
+
+#include <mutex>
+#include <new>
+#include <utility>
+
+
+//counters reported by the node allocators
+struct AVLPoolStats
+{
+    long num_of_slabs = 0;          // slabs currently held by the pool
+    long capacity = 0;              // nodes that fit in all held slabs
+    long in_use = 0;                // nodes handed out and not yet returned
+    long free_list_length = 0;      // returned nodes waiting for reuse
+    long total_allocations = 0;     // every allocate() call since construction
+    long reused_allocations = 0;    // allocations served from the free list
+};
+
+
+/** pool allocator for tree nodes (default allocator of AVLTree)
+ * nodes are carved out of big contiguous slabs, freed nodes go to a free list for reuse,
+ * and release() gives back all slabs at once without touching the nodes
+ */
+template <class node_type>
+class AVLNodePool
+{
+private:
+    union Slot
+    {
+        Slot* next;
+        alignas(node_type) unsigned char storage[sizeof(node_type)];
+    };
+
+    // - sub function for allocate: gets a new slab and points the bump range to it
+    void add_slab();
+
+    Slot* slabs;        // every slab keeps a link to the previous one in its first slot
+    Slot* last_slab;    // the oldest slab, so absorb links two slab lists in O(1)
+    Slot* free_list;
+    Slot* last_free;    // the end of the free list, so absorb links two free lists in O(1)
+    Slot* bump;
+    Slot* bump_end;
+    long next_slab_size;
+    AVLPoolStats stats;
+
+    static const long FIRST_SLAB_SIZE = 64;
+    static const long MAX_SLAB_SIZE = 65536;
+
+public:
+    // the tree may drop all its nodes by calling release() instead of walking them
+    static const bool BULK_RELEASE = true;
+
+    // constructor
+    AVLNodePool() : slabs(nullptr), last_slab(nullptr), free_list(nullptr), last_free(nullptr), bump(nullptr), bump_end(nullptr), next_slab_size(FIRST_SLAB_SIZE) {}
+
+    AVLNodePool(const AVLNodePool&) = delete;
+    AVLNodePool& operator=(const AVLNodePool&) = delete;
+
+    // constructs a node in the pool, reusing a freed node if there is one
+    template <class... Args>
+    node_type* allocate(Args&&... args);
+
+    // destroys the node and keeps its memory in the free list
+    void deallocate(node_type* node);
+
+    // gives back every slab at once - DOES NOT run the destructors of nodes still in use
+    void release();
+
+    /** takes over every slab and free node of 'other' in O(1), which is left empty
+     * nodes allocated by 'other' may then be freed to this pool (used when trees exchange nodes)
+     * the pool keeps allocating from the bigger of the two unused bump ranges, the other one stays unused until release()
+     */
+    void absorb(AVLNodePool& other);
+
+    /** takes over every slab of 'other' in O(1), but not its free nodes and bump range, which 'other' keeps using -
+     * nodes in those slabs stay valid as long as this pool holds them (used when a tree hands some of its nodes to a
+     * tree with another pool, so that neither pool releases slabs the other tree's nodes live in)
+     */
+    void keep_slabs_of(AVLNodePool& other);
+
+    // returns the counters of the pool
+    AVLPoolStats get_stats() const;
+
+    // destructor - releases all slabs
+    ~AVLNodePool();
+};
+
+
+/** plain new/delete allocator for tree nodes
+ * has no bulk release, so the tree frees its nodes one by one
+ */
+template <class node_type>
+class AVLNodeHeapAllocator
+{
+private:
+    AVLPoolStats stats;
+
+public:
+    static const bool BULK_RELEASE = false;
+
+    template <class... Args>
+    node_type* allocate(Args&&... args)
+    {
+        stats.total_allocations++;
+        stats.in_use++;
+        return new node_type(std::forward<Args>(args)...);
+    }
+
+    void deallocate(node_type* node)
+    {
+        stats.in_use--;
+        delete node;
+    }
+
+    void release() {}
+
+    void absorb(AVLNodeHeapAllocator& other)
+    {
+        stats.total_allocations += other.stats.total_allocations;
+        stats.in_use += other.stats.in_use;
+        other.stats = AVLPoolStats();
+    }
+
+    AVLPoolStats get_stats() const
+    {
+        return stats;
+    }
+};
+
+
+// AVLNodePool behind a lock, for trees that share one pool while being changed by different threads
+template <class node_type>
+class AVLLockedNodePool
+{
+private:
+    std::mutex lock;
+    AVLNodePool<node_type> pool;
+
+public:
+    static const bool BULK_RELEASE = true;
+
+    template <class... Args>
+    node_type* allocate(Args&&... args)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return pool.allocate(std::forward<Args>(args)...);
+    }
+
+    void deallocate(node_type* node)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        pool.deallocate(node);
+    }
+
+    void release()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        pool.release();
+    }
+
+    void absorb(AVLLockedNodePool& other)
+    {
+        if (&other == this)
+        {
+            return;
+        }
+        std::scoped_lock guard(lock, other.lock);
+        pool.absorb(other.pool);
+    }
+
+    AVLPoolStats get_stats()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return pool.get_stats();
+    }
+};
+
+
+/******************************************************* pool functions *******************************************************/
+
+
+template <class node_type>
+void AVLNodePool<node_type>::add_slab()
+{
+    Slot* slab = static_cast<Slot*>(::operator new(sizeof(Slot) * (next_slab_size + 1)));
+    slab->next = slabs;
+    if (slabs == nullptr)
+    {
+        last_slab = slab;
+    }
+    slabs = slab;
+    bump = slab + 1;
+    bump_end = bump + next_slab_size;
+    stats.num_of_slabs++;
+    stats.capacity += next_slab_size;
+    if (next_slab_size < MAX_SLAB_SIZE)
+    {
+        next_slab_size *= 2;
+    }
+}
+
+
+template <class node_type>
+template <class... Args>
+node_type* AVLNodePool<node_type>::allocate(Args&&... args)
+{
+    Slot* slot;
+    if (free_list != nullptr)
+    {
+        slot = free_list;
+        free_list = free_list->next;
+        if (free_list == nullptr)
+        {
+            last_free = nullptr;
+        }
+        stats.free_list_length--;
+        stats.reused_allocations++;
+    }
+    else
+    {
+        if (bump == bump_end)
+        {
+            add_slab();
+        }
+        slot = bump;
+        bump++;
+    }
+    stats.total_allocations++;
+    stats.in_use++;
+    return new (slot->storage) node_type(std::forward<Args>(args)...);
+}
+
+
+template <class node_type>
+void AVLNodePool<node_type>::deallocate(node_type* node)
+{
+    node->~node_type();
+    Slot* slot = reinterpret_cast<Slot*>(node);
+    slot->next = free_list;
+    if (free_list == nullptr)
+    {
+        last_free = slot;
+    }
+    free_list = slot;
+    stats.free_list_length++;
+    stats.in_use--;
+}
+
+
+template <class node_type>
+void AVLNodePool<node_type>::release()
+{
+    while (slabs != nullptr)
+    {
+        Slot* previous = slabs->next;
+        ::operator delete(slabs);
+        slabs = previous;
+    }
+    last_slab = nullptr;
+    free_list = nullptr;
+    last_free = nullptr;
+    bump = nullptr;
+    bump_end = nullptr;
+    next_slab_size = FIRST_SLAB_SIZE;
+    stats.num_of_slabs = 0;
+    stats.capacity = 0;
+    stats.in_use = 0;
+    stats.free_list_length = 0;
+}
+
+
+template <class node_type>
+void AVLNodePool<node_type>::absorb(AVLNodePool& other)
+{
+    if (&other == this)
+    {
+        return;
+    }
+    if (other.free_list != nullptr)
+    {
+        other.last_free->next = free_list;
+        if (free_list == nullptr)
+        {
+            last_free = other.last_free;
+        }
+        free_list = other.free_list;
+    }
+    if (other.slabs != nullptr)
+    {
+        other.last_slab->next = slabs;
+        if (slabs == nullptr)
+        {
+            last_slab = other.last_slab;
+        }
+        slabs = other.slabs;
+    }
+    if (other.bump_end - other.bump > bump_end - bump)
+    {
+        bump = other.bump;
+        bump_end = other.bump_end;
+    }
+    if (other.next_slab_size > next_slab_size)
+    {
+        next_slab_size = other.next_slab_size;
+    }
+    stats.num_of_slabs += other.stats.num_of_slabs;
+    stats.capacity += other.stats.capacity;
+    stats.in_use += other.stats.in_use;
+    stats.free_list_length += other.stats.free_list_length;
+    stats.total_allocations += other.stats.total_allocations;
+    stats.reused_allocations += other.stats.reused_allocations;
+    other.slabs = nullptr;
+    other.last_slab = nullptr;
+    other.free_list = nullptr;
+    other.last_free = nullptr;
+    other.bump = nullptr;
+    other.bump_end = nullptr;
+    other.next_slab_size = FIRST_SLAB_SIZE;
+    other.stats = AVLPoolStats();
+}
+
+
+template <class node_type>
+void AVLNodePool<node_type>::keep_slabs_of(AVLNodePool& other)
+{
+    if (&other == this || other.slabs == nullptr)
+    {
+        return;
+    }
+    other.last_slab->next = slabs;
+    if (slabs == nullptr)
+    {
+        last_slab = other.last_slab;
+    }
+    slabs = other.slabs;
+    stats.num_of_slabs += other.stats.num_of_slabs;
+    stats.capacity += other.stats.capacity;
+    other.slabs = nullptr;
+    other.last_slab = nullptr;
+    other.stats.num_of_slabs = 0;
+    other.stats.capacity = 0;
+}
+
+
+template <class node_type>
+AVLPoolStats AVLNodePool<node_type>::get_stats() const
+{
+    return stats;
+}
+
+
+template <class node_type>
+AVLNodePool<node_type>::~AVLNodePool()
+{
+    release();
+}
+
+#endif //AVL_AVLNODEPOOL_H
@@ -0,0 +1,224 @@
+#ifndef AVL_AVLPARALLEL_H
+#define AVL_AVLPARALLEL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// a subtree is split between threads only if it has at least this many nodes
+static const int AVL_PARALLEL_CUTOFF = 1 << 16;
+
+
+/** returns how many threads the parallel functions of the trees should use for 'num_of_threads'
+ * 0 stands for every core of the machine
+ */
+inline int avl_resolve_num_of_threads(int num_of_threads)
+{
+    if (num_of_threads > 0)
+    {
+        return num_of_threads;
+    }
+    int cores = static_cast<int>(std::thread::hardware_concurrency());
+    return cores > 0 ? cores : 1;
+}
+
+
+/** bounded pool of worker threads for the subtree tasks of the trees - a worker per core but one, started on
+ * first use and shared by all trees
+ * a task that no worker has taken yet when its forking thread is done with its own half is taken back and run
+ * by the forking thread, so waiting never depends on a free worker and nested forks can't deadlock
+ * a task that throws on a worker has its exception rethrown by the forking thread, and a fork whose own half throws
+ * takes its task back (or waits for it) before leaving, so no worker is left with a task whose frame is gone
+ * if the workers can't be started the pool runs every task on its forking thread
+ */
+class AVLTaskPool
+{
+private:
+    struct Task
+    {
+        void (*run)(void* function);
+        void* function;
+        int state;
+        std::exception_ptr error;   // thrown by the task on a worker
+    };
+
+    // - sub function for run_in_parallel: leaves the fork of task only after the task left the queue or a worker is done with it
+    struct TaskGuard
+    {
+        AVLTaskPool* pool;
+        Task* task;     // nullptr once the fork joined the task itself
+
+        ~TaskGuard()
+        {
+            if (task != nullptr)
+            {
+                pool->take_back_or_wait(*task);
+            }
+        }
+    };
+
+    // - sub function for the constructor: the loop of a worker thread
+    void work();
+
+    /** - sub function for run_in_parallel: takes task out of the queue if no worker took it yet and returns true,
+     * otherwise waits until the worker is done with it and returns false
+     */
+    bool take_back_or_wait(Task& task);
+
+    std::mutex lock;
+    std::condition_variable work_ready;
+    std::condition_variable task_done;
+    std::deque<Task*> queue;
+    std::vector<std::thread> workers;
+    bool stopping;
+
+    static const int QUEUED = 0;
+    static const int RUNNING = 1;
+    static const int DONE = 2;
+
+    AVLTaskPool();
+
+public:
+    AVLTaskPool(const AVLTaskPool&) = delete;
+    AVLTaskPool& operator=(const AVLTaskPool&) = delete;
+
+    // returns the pool shared by all trees
+    static AVLTaskPool& instance();
+
+    // runs left_task on a worker (or this thread if none takes it) and right_task on this thread, returns when both are done
+    template <class left_task_type, class right_task_type>
+    void run_in_parallel(left_task_type& left_task, right_task_type& right_task);
+
+    // destructor - stops the workers, no task may be running
+    ~AVLTaskPool();
+};
+
+
+inline AVLTaskPool::AVLTaskPool() : stopping(false)
+{
+    int cores = avl_resolve_num_of_threads(0);
+    try
+    {
+        workers.reserve(cores - 1);
+        for (int i = 1; i < cores; i++)
+        {
+            workers.emplace_back([this]() { work(); });
+        }
+    }
+    catch (const std::exception&)
+    {
+        // the pool works with the workers it could start, or on the forking threads alone
+    }
+}
+
+
+inline AVLTaskPool& AVLTaskPool::instance()
+{
+    static AVLTaskPool pool;
+    return pool;
+}
+
+
+inline void AVLTaskPool::work()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    while (true)
+    {
+        work_ready.wait(guard, [this]() { return stopping || !queue.empty(); });
+        if (queue.empty())
+        {
+            return;
+        }
+        Task* task = queue.front();
+        queue.pop_front();
+        task->state = RUNNING;
+        guard.unlock();
+        try
+        {
+            task->run(task->function);
+        }
+        catch (...)
+        {
+            task->error = std::current_exception();
+        }
+        guard.lock();
+        task->state = DONE;
+        task_done.notify_all();
+    }
+}
+
+
+template <class left_task_type, class right_task_type>
+void AVLTaskPool::run_in_parallel(left_task_type& left_task, right_task_type& right_task)
+{
+    if (workers.empty())
+    {
+        left_task();
+        right_task();
+        return;
+    }
+    Task task = {[](void* function) { (*static_cast<left_task_type*>(function))(); }, &left_task, QUEUED, nullptr};
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        queue.push_back(&task);
+    }
+    work_ready.notify_one();
+    TaskGuard join = {this, &task};
+    right_task();
+    join.task = nullptr;
+    if (take_back_or_wait(task))
+    {
+        left_task();
+        return;
+    }
+    if (task.error != nullptr)
+    {
+        std::rethrow_exception(task.error);
+    }
+}
+
+
+inline bool AVLTaskPool::take_back_or_wait(Task& task)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    if (task.state == QUEUED)
+    {
+        queue.erase(std::find(queue.begin(), queue.end(), &task));
+        task.state = RUNNING;
+        return true;
+    }
+    task_done.wait(guard, [&task]() { return task.state == DONE; });
+    return false;
+}
+
+
+inline AVLTaskPool::~AVLTaskPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    work_ready.notify_all();
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+
+/** fork-join of two subtree tasks on the shared AVLTaskPool: left_task may run on a worker, right_task runs
+ * on this thread, returns when both are done
+ * the trees are balanced, so splitting the threads in half at every fork keeps them evenly loaded
+ */
+template <class left_task_type, class right_task_type>
+void avl_run_in_parallel(left_task_type left_task, right_task_type right_task)
+{
+    AVLTaskPool::instance().run_in_parallel(left_task, right_task);
+}
+
+#endif //AVL_AVLPARALLEL_H
@@ -0,0 +1,674 @@
+#ifndef AVL_AVLPERSISTENTTREE_H
+#define AVL_AVLPERSISTENTTREE_H
+
+#include "AVLTree.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+
+/** persistent AVL tree - every tree is a version, and snapshot() makes a new version in O(1)
+ * versions share their nodes: a write (insert, remove) copies only the O(log n) nodes on its path that
+ * another version can still reach, changes the copies and shares everything else
+ * nodes are reference counted - a node is freed when the last version reaching it drops it, and all
+ * versions share one node pool that lives as long as any of them
+ * one version must not be used by two threads at the same time, but different versions of the same tree
+ * may be read and written by different threads at the same time (e.g. a report reads a snapshot while
+ * the writer keeps changing the tree it was taken from)
+ */
+template <class ptr_type, class condition, template <class> class allocator = AVLNodePool>
+class AVLPersistentTree
+{
+public:
+    struct PersistentNode
+    {
+        ptr_type* data;
+        int height;
+        int size;                   // number of nodes in the subtree of this node
+        std::atomic<int> refs;      // parents and versions pointing to the node
+        PersistentNode* left;
+        PersistentNode* right;
+
+        PersistentNode(ptr_type* data) : data(data), height(0), size(1), refs(1), left(nullptr), right(nullptr) {}
+    };
+
+    typedef PersistentNode node_type;
+    typedef allocator<node_type> allocator_type;
+
+private:
+    // node pool of all versions - versions are freed from any thread, so it's locked
+    struct VersionPool
+    {
+        std::mutex lock;
+        allocator_type nodes;
+    };
+
+    // - sub function for the writers: allocates a node that only the running write can reach
+    node_type* new_node(ptr_type* data);
+
+    // - sub function for the writers: frees a node that only the running write could reach, not its children
+    void free_node(node_type* r);
+
+    // - sub function for snapshot and the writers: adds a reference to r
+    static node_type* acquire(node_type* r);
+
+    // - sub function for the writers and destructor: drops a reference to r, and frees r and drops its children if it was the last
+    void release(node_type* r);
+
+    /** - sub function for the writers: takes over one reference to r and returns a node only this version can reach
+     * that is r itself if nothing else points to it, otherwise a copy sharing the children of r
+     */
+    node_type* writable(node_type* r);
+
+    // - sub function for insert: copies the path to the place of data, links a new node there and balances the copies
+    node_type* insert_node(node_type* r, ptr_type* data);
+
+    // - sub function for remove: copies the path to the node of data, unlinks it and balances the copies
+    node_type* remove_node(node_type* r, ptr_type* data);
+
+    // -- sub function for remove_node: unlinks the max node of the subtree of r, returns the new subtree
+    node_type* remove_max_node(node_type* r, node_type*& max);
+
+    // - sub function for the writers: balance the subtree of a writable node with proper rotations
+    node_type* balance_tree(node_type* r);
+
+    // -- sub function for balance: makes an RR rotation
+    node_type* make_RR_rotation(node_type* r);
+
+    // -- sub function for balance: makes an LL rotation
+    node_type* make_LL_rotation(node_type* r);
+
+    // -- sub function for balance: calculates balance factor of node
+    int get_bf(node_type* r);
+
+    // - sub function for balance and rotations: updates height and size of node
+    void update_node(node_type* r);
+
+    // - sub function for balance: returns the height of r (EMPTY_TREE for nullptr)
+    int get_height(node_type* r);
+
+    // - sub function for update_node: returns the size of r (0 for nullptr)
+    int get_size(node_type* r);
+
+    // - sub function for build_from_array: constructs the tree from array
+    node_type* build_tree_from_array(ptr_type** array, int start, int end);
+
+    // - sub function for export_inorder: writes the data of the subtree of r by order, returns the next free place
+    ptr_type** export_travel(node_type* r, ptr_type** out) const;
+
+    // - sub function for for_each_in_range: visits the nodes between lo and hi in the subtree of r
+    template <class visitor_type>
+    void range_travel(node_type* r, ptr_type* lo, ptr_type* hi, visitor_type& visitor) const;
+
+    node_type* root;
+    std::shared_ptr<VersionPool> pool;  // shared by every version made from this tree
+
+    static const int EMPTY_TREE = -1;
+    static const int UNBALANCED_POSITIVE_BF = 2;
+    static const int UNBALANCED_NEGATIVE_BF = -2;
+
+public:
+    // constructor
+    AVLPersistentTree() : root(nullptr), pool(std::make_shared<VersionPool>()) {}
+
+    // copy constructor - same as other.snapshot()
+    AVLPersistentTree(const AVLPersistentTree& other) : root(acquire(other.root)), pool(other.pool) {}
+
+    // move constructor - other is left empty
+    AVLPersistentTree(AVLPersistentTree&& other) noexcept : root(other.root), pool(other.pool)
+    {
+        other.root = nullptr;
+    }
+
+    // the tree becomes a version of other (O(1)), the version it was is dropped
+    AVLPersistentTree& operator=(AVLPersistentTree other);
+
+    /** returns a new version with the current contents of the tree, in O(1)
+     * the two versions change independently from now on - the first write to each copies its path
+     */
+    AVLPersistentTree snapshot() const;
+
+    /******************************************************* readers *******************************************************/
+
+    // returns how many nodes the tree consists
+    int get_num_of_nodes() const;
+
+    /** returns the data of the node that is equal to 'data'
+     *  returns nullptr - if node doesn't exist
+     */
+    ptr_type* search(ptr_type* data) const;
+
+    /**
+     * returns the data of the closest left neighbor node (smaller then the node)
+     * returns nullptr - if doesn't exist
+     */
+    ptr_type* get_closest_left(ptr_type* data) const;
+
+    /**
+     * returns the data of the closest right neighbor node (bigger then the node)
+     * returns nullptr - if doesn't exist
+     */
+    ptr_type* get_closest_right(ptr_type* data) const;
+
+    // calls visitor(data) for every node between 'lo' and 'hi' (both included), by order
+    template <class visitor_type>
+    void for_each_in_range(ptr_type* lo, ptr_type* hi, visitor_type visitor) const;
+
+    /** writes the data of all nodes by order into 'out', which must have room for get_num_of_nodes() pointers
+     * returns how many pointers were written
+     */
+    int export_inorder(ptr_type** out) const;
+
+    /******************************************************* writers *******************************************************/
+
+    // builds tree from sorted array without duplicates, replacing the nodes the tree had
+    void build_from_array(ptr_type** data_array, int size);
+
+    /** inserts a new node to the tree
+     * returns true - if node is created
+     * returns false - if node already exists
+     */
+    bool insert(ptr_type* data);
+
+    /** removes the node that points to 'data'
+     * returns true - if node is found and removed
+     * returns false - if node doesn't exist
+     */
+    bool remove(ptr_type* data);
+
+    // removes every node of this version (other versions keep theirs)
+    void clear();
+
+    // returns the counters of the node pool shared by all versions
+    AVLPoolStats get_pool_stats() const;
+
+    // destructor - drops this version, DOES NOT erase the data pointed to
+    ~AVLPersistentTree();
+};
+
+
+/******************************************************* version functions *******************************************************/
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+typename AVLPersistentTree<ptr_type, condition, allocator>::node_type* AVLPersistentTree<ptr_type, condition, allocator>::new_node(ptr_type* data)
+{
+    std::lock_guard<std::mutex> lock(pool->lock);
+    return pool->nodes.allocate(data);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+void AVLPersistentTree<ptr_type, condition, allocator>::free_node(node_type* r)
+{
+    std::lock_guard<std::mutex> lock(pool->lock);
+    pool->nodes.deallocate(r);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+typename AVLPersistentTree<ptr_type, condition, allocator>::node_type* AVLPersistentTree<ptr_type, condition, allocator>::acquire(node_type* r)
+{
+    if (r != nullptr)
+    {
+        r->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    return r;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+void AVLPersistentTree<ptr_type, condition, allocator>::release(node_type* r)
+{
+    // the last reference frees the node, and its children lose a reference each - walks down only while counts reach 0
+    while (r != nullptr && r->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        node_type* right = r->right;
+        release(r->left);
+        free_node(r);
+        r = right;
+    }
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+typename AVLPersistentTree<ptr_type, condition, allocator>::node_type* AVLPersistentTree<ptr_type, condition, allocator>::writable(node_type* r)
+{
+    // the caller owns a path of unshared nodes down to r, so a count of 1 means no other version can reach r
+    if (r->refs.load(std::memory_order_acquire) == 1)
+    {
+        return r;
+    }
+    node_type* copy = new_node(r->data);
+    copy->height = r->height;
+    copy->size = r->size;
+    copy->left = acquire(r->left);
+    copy->right = acquire(r->right);
+    release(r);
+    return copy;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+AVLPersistentTree<ptr_type, condition, allocator>& AVLPersistentTree<ptr_type, condition, allocator>::operator=(AVLPersistentTree other)
+{
+    std::swap(root, other.root);
+    std::swap(pool, other.pool);
+    return *this;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+AVLPersistentTree<ptr_type, condition, allocator> AVLPersistentTree<ptr_type, condition, allocator>::snapshot() const
+{
+    return AVLPersistentTree(*this);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+AVLPoolStats AVLPersistentTree<ptr_type, condition, allocator>::get_pool_stats() const
+{
+    std::lock_guard<std::mutex> lock(pool->lock);
+    return pool->nodes.get_stats();
+}
+
+
+/******************************************************* balance functions *******************************************************/
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+typename AVLPersistentTree<ptr_type, condition, allocator>::node_type* AVLPersistentTree<ptr_type, condition, allocator>::balance_tree(node_type* r)
+{
+    update_node(r);
+    int bf = get_bf(r);
+    if (bf == UNBALANCED_POSITIVE_BF)
+    {
+        if (get_bf(r->left) < 0)
+        {
+            r->left = make_RR_rotation(writable(r->left));     // LR
+        }
+        return make_LL_rotation(r);
+    }
+    if (bf == UNBALANCED_NEGATIVE_BF)
+    {
+        if (get_bf(r->right) > 0)
+        {
+            r->right = make_LL_rotation(writable(r->right));   // RL
+        }
+        return make_RR_rotation(r);
+    }
+    return r;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+typename AVLPersistentTree<ptr_type, condition, allocator>::node_type* AVLPersistentTree<ptr_type, condition, allocator>::make_RR_rotation(node_type* r)
+{
+    node_type* pivot = writable(r->right);
+    r->right = pivot->left;
+    pivot->left = r;
+    update_node(r);
+    update_node(pivot);
+    return pivot;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+typename AVLPersistentTree<ptr_type, condition, allocator>::node_type* AVLPersistentTree<ptr_type, condition, allocator>::make_LL_rotation(node_type* r)
+{
+    node_type* pivot = writable(r->left);
+    r->left = pivot->right;
+    pivot->right = r;
+    update_node(r);
+    update_node(pivot);
+    return pivot;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+int AVLPersistentTree<ptr_type, condition, allocator>::get_bf(node_type* r)
+{
+    return get_height(r->left) - get_height(r->right);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+void AVLPersistentTree<ptr_type, condition, allocator>::update_node(node_type* r)
+{
+    int left = get_height(r->left);
+    int right = get_height(r->right);
+    r->height = 1 + (left > right ? left : right);
+    r->size = 1 + get_size(r->left) + get_size(r->right);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+int AVLPersistentTree<ptr_type, condition, allocator>::get_height(node_type* r)
+{
+    return (r == nullptr) ? EMPTY_TREE : r->height;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+int AVLPersistentTree<ptr_type, condition, allocator>::get_size(node_type* r)
+{
+    return (r == nullptr) ? 0 : r->size;
+}
+
+
+/******************************************************* writer functions *******************************************************/
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+void AVLPersistentTree<ptr_type, condition, allocator>::build_from_array(ptr_type** data_array, int size)
+{
+    if (size < 1 || data_array == nullptr)
+    {
+        return;
+    }
+    release(root);
+    root = build_tree_from_array(data_array, 0, size - 1);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+typename AVLPersistentTree<ptr_type, condition, allocator>::node_type* AVLPersistentTree<ptr_type, condition, allocator>::build_tree_from_array(ptr_type** array, int start, int end)
+{
+    if (start > end)
+    {
+        return nullptr;
+    }
+    int mid = (start + end) / 2;
+    node_type* r = new_node(array[mid]);
+    r->left = build_tree_from_array(array, start, mid - 1);
+    r->right = build_tree_from_array(array, mid + 1, end);
+    update_node(r);
+    return r;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+bool AVLPersistentTree<ptr_type, condition, allocator>::insert(ptr_type* data)
+{
+    // checked first, so a failed insert doesn't copy a path that other versions share
+    if (search(data) != nullptr)
+    {
+        return false;
+    }
+    root = insert_node(root, data);
+    return true;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+typename AVLPersistentTree<ptr_type, condition, allocator>::node_type* AVLPersistentTree<ptr_type, condition, allocator>::insert_node(node_type* r, ptr_type* data)
+{
+    if (r == nullptr)
+    {
+        return new_node(data);
+    }
+    // the path is made writable on the way down, so every node below it is reached through unshared nodes only
+    r = writable(r);
+    condition cond;
+    if (cond(data, r->data) == Comparison::LESS_THAN)
+    {
+        r->left = insert_node(r->left, data);
+    }
+    else
+    {
+        r->right = insert_node(r->right, data);
+    }
+    return balance_tree(r);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+bool AVLPersistentTree<ptr_type, condition, allocator>::remove(ptr_type* data)
+{
+    if (search(data) == nullptr)
+    {
+        return false;
+    }
+    root = remove_node(root, data);
+    return true;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+typename AVLPersistentTree<ptr_type, condition, allocator>::node_type* AVLPersistentTree<ptr_type, condition, allocator>::remove_node(node_type* r, ptr_type* data)
+{
+    r = writable(r);
+    condition cond;
+    Comparison result = cond(data, r->data);
+    if (result == Comparison::EQUAL)
+    {
+        node_type* left = r->left;
+        node_type* right = r->right;
+        free_node(r);
+        if (left == nullptr)
+        {
+            return right;
+        }
+        if (right == nullptr)
+        {
+            return left;
+        }
+        // junction has both children - the max node of its left subtree takes its place
+        node_type* max = nullptr;
+        left = remove_max_node(left, max);
+        max->left = left;
+        max->right = right;
+        return balance_tree(max);
+    }
+    if (result == Comparison::LESS_THAN)
+    {
+        r->left = remove_node(r->left, data);
+    }
+    else
+    {
+        r->right = remove_node(r->right, data);
+    }
+    return balance_tree(r);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+typename AVLPersistentTree<ptr_type, condition, allocator>::node_type* AVLPersistentTree<ptr_type, condition, allocator>::remove_max_node(node_type* r, node_type*& max)
+{
+    r = writable(r);
+    if (r->right == nullptr)
+    {
+        max = r;
+        node_type* left = r->left;
+        r->left = nullptr;
+        return left;
+    }
+    r->right = remove_max_node(r->right, max);
+    return balance_tree(r);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+void AVLPersistentTree<ptr_type, condition, allocator>::clear()
+{
+    release(root);
+    root = nullptr;
+}
+
+
+/******************************************************* reader functions *******************************************************/
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+int AVLPersistentTree<ptr_type, condition, allocator>::get_num_of_nodes() const
+{
+    return (root == nullptr) ? 0 : root->size;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+ptr_type* AVLPersistentTree<ptr_type, condition, allocator>::search(ptr_type* data) const
+{
+    condition cond;
+    node_type* r = root;
+    while (r != nullptr)
+    {
+        Comparison result = cond(data, r->data);
+        if (result == Comparison::EQUAL)
+        {
+            return r->data;
+        }
+        r = (result == Comparison::LESS_THAN) ? r->left : r->right;
+    }
+    return nullptr;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+ptr_type* AVLPersistentTree<ptr_type, condition, allocator>::get_closest_left(ptr_type* data) const
+{
+    condition cond;
+    node_type* r = root;
+    node_type* last_left_father = nullptr;    // last node the descent went right from
+    while (r != nullptr)
+    {
+        Comparison result = cond(data, r->data);
+        if (result == Comparison::EQUAL)
+        {
+            if (r->left != nullptr)
+            {
+                r = r->left;
+                while (r->right != nullptr)
+                {
+                    r = r->right;
+                }
+                return r->data;
+            }
+            return (last_left_father == nullptr) ? nullptr : last_left_father->data;
+        }
+        if (result == Comparison::LESS_THAN)
+        {
+            r = r->left;
+        }
+        else
+        {
+            last_left_father = r;
+            r = r->right;
+        }
+    }
+    return nullptr;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+ptr_type* AVLPersistentTree<ptr_type, condition, allocator>::get_closest_right(ptr_type* data) const
+{
+    condition cond;
+    node_type* r = root;
+    node_type* last_right_father = nullptr;   // last node the descent went left from
+    while (r != nullptr)
+    {
+        Comparison result = cond(data, r->data);
+        if (result == Comparison::EQUAL)
+        {
+            if (r->right != nullptr)
+            {
+                r = r->right;
+                while (r->left != nullptr)
+                {
+                    r = r->left;
+                }
+                return r->data;
+            }
+            return (last_right_father == nullptr) ? nullptr : last_right_father->data;
+        }
+        if (result == Comparison::GREATER_THAN)
+        {
+            r = r->right;
+        }
+        else
+        {
+            last_right_father = r;
+            r = r->left;
+        }
+    }
+    return nullptr;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+template <class visitor_type>
+void AVLPersistentTree<ptr_type, condition, allocator>::for_each_in_range(ptr_type* lo, ptr_type* hi, visitor_type visitor) const
+{
+    range_travel(root, lo, hi, visitor);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+template <class visitor_type>
+void AVLPersistentTree<ptr_type, condition, allocator>::range_travel(node_type* r, ptr_type* lo, ptr_type* hi, visitor_type& visitor) const
+{
+    if (r == nullptr)
+    {
+        return;
+    }
+    condition cond;
+    bool above_lo = cond(lo, r->data) != Comparison::GREATER_THAN;
+    bool below_hi = cond(hi, r->data) != Comparison::LESS_THAN;
+    if (above_lo)
+    {
+        range_travel(r->left, lo, hi, visitor);
+    }
+    if (above_lo && below_hi)
+    {
+        visitor(r->data);
+    }
+    if (below_hi)
+    {
+        range_travel(r->right, lo, hi, visitor);
+    }
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+int AVLPersistentTree<ptr_type, condition, allocator>::export_inorder(ptr_type** out) const
+{
+    if (out == nullptr)
+    {
+        return 0;
+    }
+    return static_cast<int>(export_travel(root, out) - out);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+ptr_type** AVLPersistentTree<ptr_type, condition, allocator>::export_travel(node_type* r, ptr_type** out) const
+{
+    while (r != nullptr)
+    {
+        out = export_travel(r->left, out);
+        *out++ = r->data;
+        r = r->right;
+    }
+    return out;
+}
+
+
+/******************************************************* destructor *******************************************************/
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+AVLPersistentTree<ptr_type, condition, allocator>::~AVLPersistentTree()
+{
+    if (allocator_type::BULK_RELEASE && pool.use_count() == 1)
+    {
+        // last version - no node can be reached from anywhere else
+        pool->nodes.release();
+        return;
+    }
+    release(root);
+}
+
+#endif //AVL_AVLPERSISTENTTREE_H
@@ -0,0 +1,688 @@
+#ifndef AVL_AVLRCUTREE_H
+#define AVL_AVLRCUTREE_H
+
+#include "AVLTree.h"
+#include "AVLEpoch.h"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+
+/** AVL tree for many concurrent readers and a single writer (RCU style)
+ * readers (search, get_closest_left/right, for_each_in_range) take no lock and never wait: a published
+ * node is never changed, so a reader sees one consistent version of the tree from start to end
+ * the writer (insert, remove, build_from_array) copies the path it changes, balances the copies, and
+ * publishes them all at once by an atomic store of the root - the replaced nodes are freed by the
+ * epoch manager once no reader can hold them
+ * only one thread may write at a time (callers serialize their writers), any number may read
+ */
+template <class ptr_type, class condition, template <class> class allocator = AVLNodePool>
+class AVLRcuTree
+{
+public:
+    struct RcuNode
+    {
+        ptr_type* data;
+        int height;
+        uint64_t version;   // the write that made the node - nodes of the running write may still change
+        RcuNode* left;
+        RcuNode* right;
+
+        RcuNode(ptr_type* data, uint64_t version) : data(data), height(0), version(version), left(nullptr), right(nullptr) {}
+    };
+
+    typedef RcuNode node_type;
+    typedef allocator<node_type> allocator_type;
+    typedef AVLEpochManager::Guard read_guard;
+
+private:
+    // - sub function for the writers: allocates a node of the running write
+    node_type* new_node(ptr_type* data);
+
+    // - sub function for the writers: returns r if it was made by the running write, otherwise a copy that replaces it
+    node_type* writable(node_type* r);
+
+    // - sub function for the writers: the node can be freed once the new root is published
+    void retire_later(node_type* r);
+
+    // - sub function for the writers: publishes new_root and retires the nodes it replaced
+    void publish(node_type* new_root);
+
+    // - sub function for retire: frees a node that no reader can hold anymore (called from the writer)
+    static void free_node(void* node, void* tree);
+
+    // - sub function for remove_and_erase: erases data that no reader can hold anymore
+    static void free_data(void* data, void* tree);
+
+    // - sub function for insert: copies the path to the place of data, links a new node there and balances the copies
+    node_type* insert_node(node_type* r, ptr_type* data, bool& inserted);
+
+    // - sub function for remove: copies the path to the node of data, unlinks it and balances the copies
+    node_type* remove_node(node_type* r, ptr_type* data, node_type*& removed);
+
+    // -- sub function for remove_node: unlinks the max node of the subtree of r, returns the new subtree
+    node_type* remove_max_node(node_type* r, node_type*& max);
+
+    // - sub function for the writers: balance the subtree of a writable node with proper rotations
+    node_type* balance_tree(node_type* r);
+
+    // -- sub function for balance: makes an RR rotation
+    node_type* make_RR_rotation(node_type* r);
+
+    // -- sub function for balance: makes an LL rotation
+    node_type* make_LL_rotation(node_type* r);
+
+    // -- sub function for balance: calculates balance factor of node
+    int get_bf(node_type* r);
+
+    // - sub function for balance and rotations: updates height of node
+    void update_height(node_type* r);
+
+    // - sub function for balance: returns the height of r (EMPTY_TREE for nullptr)
+    int get_height(node_type* r);
+
+    // - sub function for build_from_array: constructs the tree from array
+    node_type* build_tree_from_array(ptr_type** array, int start, int end);
+
+    // - sub function for build_from_array: retires all nodes of a replaced tree
+    void retire_all(node_type* r);
+
+    // - sub function for for_each_in_range: visits the nodes between lo and hi in the subtree of r
+    template <class visitor_type>
+    void range_travel(node_type* r, ptr_type* lo, ptr_type* hi, visitor_type& visitor);
+
+    // - sub function for destructor: frees all nodes
+    void destructor(node_type* r);
+
+    std::atomic<node_type*> root;
+    std::atomic<int> num_of_nodes;
+    allocator_type node_allocator;      // used by the writer only
+    AVLEpochManager epochs;             // declared after the allocator, so its leftovers are freed first
+    std::vector<node_type*> replaced;   // nodes of the running write that are freed after publishing
+    uint64_t version;   // counts every write - 64 bits never wrap, so an old node never matches a later write
+
+    static const int EMPTY_TREE = -1;
+    static const int UNBALANCED_POSITIVE_BF = 2;
+    static const int UNBALANCED_NEGATIVE_BF = -2;
+
+public:
+    // constructor
+    AVLRcuTree() : root(nullptr), num_of_nodes(0), version(0) {}
+
+    AVLRcuTree(const AVLRcuTree&) = delete;
+    AVLRcuTree& operator=(const AVLRcuTree&) = delete;
+
+    /** pins the tree for reading until the guard is destroyed - data returned by the readers stays
+     * valid while the guard lives even if the writer removes and erases it meanwhile
+     * every reader pins by itself, so a guard is needed only to keep the results
+     */
+    read_guard lock_for_reading();
+
+    /******************************************************* readers - any thread *******************************************************/
+
+    // returns how many nodes the tree consists
+    int get_num_of_nodes();
+
+    /** returns the data of the node that is equal to 'data'
+     *  returns nullptr - if node doesn't exist
+     */
+    ptr_type* search(ptr_type* data);
+
+    /**
+     * returns the data of the closest left neighbor node (smaller then the node)
+     * returns nullptr - if doesn't exist
+     */
+    ptr_type* get_closest_left(ptr_type* data);
+
+    /**
+     * returns the data of the closest right neighbor node (bigger then the node)
+     * returns nullptr - if doesn't exist
+     */
+    ptr_type* get_closest_right(ptr_type* data);
+
+    /** calls visitor(data) for every node between 'lo' and 'hi' (both included), by order
+     * all visited nodes belong to the same version of the tree
+     */
+    template <class visitor_type>
+    void for_each_in_range(ptr_type* lo, ptr_type* hi, visitor_type visitor);
+
+    /******************************************************* writer - one thread at a time *******************************************************/
+
+    // builds tree from sorted array without duplicates, replacing the nodes the tree had
+    void build_from_array(ptr_type** data_array, int size);
+
+    /** inserts a new node to the tree
+     * returns true - if node is created
+     * returns false - if node already exists
+     */
+    bool insert(ptr_type* data);
+
+    /** removes the node that points to 'data'
+     * returns true - if node is found and removed
+     * returns false - if node doesn't exist
+     */
+    bool remove(ptr_type* data);
+
+    /** removes the node that points to 'data' and calls its destructor once no reader can hold it
+     * returns true - if node is found and removed
+     * returns false - if node doesn't exist
+     */
+    bool remove_and_erase(ptr_type* data);
+
+    // waits until the readers running now are done, then frees every node replaced so far
+    void synchronize();
+
+    // destructor - DOES NOT erase the data pointed to, no reader may run
+    ~AVLRcuTree();
+};
+
+
+/******************************************************* writer details functions *******************************************************/
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+typename AVLRcuTree<ptr_type, condition, allocator>::node_type* AVLRcuTree<ptr_type, condition, allocator>::new_node(ptr_type* data)
+{
+    return node_allocator.allocate(data, version);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+typename AVLRcuTree<ptr_type, condition, allocator>::node_type* AVLRcuTree<ptr_type, condition, allocator>::writable(node_type* r)
+{
+    if (r->version == version)
+    {
+        return r;
+    }
+    node_type* copy = new_node(r->data);
+    copy->height = r->height;
+    copy->left = r->left;
+    copy->right = r->right;
+    retire_later(r);
+    return copy;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+void AVLRcuTree<ptr_type, condition, allocator>::retire_later(node_type* r)
+{
+    replaced.push_back(r);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+void AVLRcuTree<ptr_type, condition, allocator>::publish(node_type* new_root)
+{
+    root.store(new_root);
+    // nodes are retired only after the new root is out, so readers that pin from now on can't reach them
+    for (node_type* r : replaced)
+    {
+        epochs.retire(r, free_node, this);
+    }
+    replaced.clear();
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+void AVLRcuTree<ptr_type, condition, allocator>::free_node(void* node, void* tree)
+{
+    static_cast<AVLRcuTree*>(tree)->node_allocator.deallocate(static_cast<node_type*>(node));
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+void AVLRcuTree<ptr_type, condition, allocator>::free_data(void* data, void*)
+{
+    delete static_cast<ptr_type*>(data);
+}
+
+
+/******************************************************* balance functions *******************************************************/
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+typename AVLRcuTree<ptr_type, condition, allocator>::node_type* AVLRcuTree<ptr_type, condition, allocator>::balance_tree(node_type* r)
+{
+    update_height(r);
+    int bf = get_bf(r);
+    if (bf == UNBALANCED_POSITIVE_BF)
+    {
+        if (get_bf(r->left) < 0)
+        {
+            r->left = make_RR_rotation(writable(r->left));     // LR
+        }
+        return make_LL_rotation(r);
+    }
+    if (bf == UNBALANCED_NEGATIVE_BF)
+    {
+        if (get_bf(r->right) > 0)
+        {
+            r->right = make_LL_rotation(writable(r->right));   // RL
+        }
+        return make_RR_rotation(r);
+    }
+    return r;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+typename AVLRcuTree<ptr_type, condition, allocator>::node_type* AVLRcuTree<ptr_type, condition, allocator>::make_RR_rotation(node_type* r)
+{
+    node_type* pivot = writable(r->right);
+    r->right = pivot->left;
+    pivot->left = r;
+    update_height(r);
+    update_height(pivot);
+    return pivot;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+typename AVLRcuTree<ptr_type, condition, allocator>::node_type* AVLRcuTree<ptr_type, condition, allocator>::make_LL_rotation(node_type* r)
+{
+    node_type* pivot = writable(r->left);
+    r->left = pivot->right;
+    pivot->right = r;
+    update_height(r);
+    update_height(pivot);
+    return pivot;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+int AVLRcuTree<ptr_type, condition, allocator>::get_bf(node_type* r)
+{
+    return get_height(r->left) - get_height(r->right);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+void AVLRcuTree<ptr_type, condition, allocator>::update_height(node_type* r)
+{
+    int left = get_height(r->left);
+    int right = get_height(r->right);
+    r->height = 1 + (left > right ? left : right);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+int AVLRcuTree<ptr_type, condition, allocator>::get_height(node_type* r)
+{
+    return (r == nullptr) ? EMPTY_TREE : r->height;
+}
+
+
+/******************************************************* writer functions *******************************************************/
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+void AVLRcuTree<ptr_type, condition, allocator>::build_from_array(ptr_type** data_array, int size)
+{
+    if (size < 1 || data_array == nullptr)
+    {
+        return;
+    }
+    version++;
+    retire_all(root.load());
+    node_type* new_root = build_tree_from_array(data_array, 0, size - 1);
+    num_of_nodes.store(size);
+    publish(new_root);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+typename AVLRcuTree<ptr_type, condition, allocator>::node_type* AVLRcuTree<ptr_type, condition, allocator>::build_tree_from_array(ptr_type** array, int start, int end)
+{
+    if (start > end)
+    {
+        return nullptr;
+    }
+    int mid = (start + end) / 2;
+    node_type* r = new_node(array[mid]);
+    r->left = build_tree_from_array(array, start, mid - 1);
+    r->right = build_tree_from_array(array, mid + 1, end);
+    update_height(r);
+    return r;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+void AVLRcuTree<ptr_type, condition, allocator>::retire_all(node_type* r)
+{
+    if (r == nullptr)
+    {
+        return;
+    }
+    retire_all(r->left);
+    retire_all(r->right);
+    retire_later(r);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+bool AVLRcuTree<ptr_type, condition, allocator>::insert(ptr_type* data)
+{
+    version++;
+    bool inserted = false;
+    node_type* new_root = insert_node(root.load(), data, inserted);
+    if (inserted)
+    {
+        num_of_nodes.fetch_add(1);
+        publish(new_root);
+    }
+    return inserted;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+typename AVLRcuTree<ptr_type, condition, allocator>::node_type* AVLRcuTree<ptr_type, condition, allocator>::insert_node(node_type* r, ptr_type* data, bool& inserted)
+{
+    if (r == nullptr)
+    {
+        inserted = true;
+        return new_node(data);
+    }
+    condition cond;
+    Comparison result = cond(data, r->data);
+    if (result == Comparison::EQUAL)
+    {
+        return r;
+    }
+    node_type* child = insert_node(result == Comparison::LESS_THAN ? r->left : r->right, data, inserted);
+    if (!inserted)
+    {
+        return r;
+    }
+    r = writable(r);
+    if (result == Comparison::LESS_THAN)
+    {
+        r->left = child;
+    }
+    else
+    {
+        r->right = child;
+    }
+    return balance_tree(r);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+bool AVLRcuTree<ptr_type, condition, allocator>::remove(ptr_type* data)
+{
+    version++;
+    node_type* removed = nullptr;
+    node_type* new_root = remove_node(root.load(), data, removed);
+    if (removed == nullptr)
+    {
+        return false;
+    }
+    num_of_nodes.fetch_sub(1);
+    publish(new_root);
+    return true;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+bool AVLRcuTree<ptr_type, condition, allocator>::remove_and_erase(ptr_type* data)
+{
+    version++;
+    node_type* removed = nullptr;
+    node_type* new_root = remove_node(root.load(), data, removed);
+    if (removed == nullptr)
+    {
+        return false;
+    }
+    ptr_type* removed_data = removed->data;
+    num_of_nodes.fetch_sub(1);
+    publish(new_root);
+    epochs.retire(removed_data, free_data, this);
+    return true;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+typename AVLRcuTree<ptr_type, condition, allocator>::node_type* AVLRcuTree<ptr_type, condition, allocator>::remove_node(node_type* r, ptr_type* data, node_type*& removed)
+{
+    if (r == nullptr)
+    {
+        return nullptr;
+    }
+    condition cond;
+    Comparison result = cond(data, r->data);
+    if (result == Comparison::EQUAL)
+    {
+        removed = r;
+        retire_later(r);
+        if (r->left == nullptr)
+        {
+            return r->right;
+        }
+        if (r->right == nullptr)
+        {
+            return r->left;
+        }
+        // junction has both children - a copy of the max node of its left subtree takes its place
+        node_type* max = nullptr;
+        node_type* left = remove_max_node(r->left, max);
+        node_type* successor = writable(max);
+        successor->left = left;
+        successor->right = r->right;
+        return balance_tree(successor);
+    }
+    node_type* child = remove_node(result == Comparison::LESS_THAN ? r->left : r->right, data, removed);
+    if (removed == nullptr)
+    {
+        return r;
+    }
+    r = writable(r);
+    if (result == Comparison::LESS_THAN)
+    {
+        r->left = child;
+    }
+    else
+    {
+        r->right = child;
+    }
+    return balance_tree(r);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+typename AVLRcuTree<ptr_type, condition, allocator>::node_type* AVLRcuTree<ptr_type, condition, allocator>::remove_max_node(node_type* r, node_type*& max)
+{
+    if (r->right == nullptr)
+    {
+        max = r;
+        return r->left;
+    }
+    node_type* child = remove_max_node(r->right, max);
+    r = writable(r);
+    r->right = child;
+    return balance_tree(r);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+void AVLRcuTree<ptr_type, condition, allocator>::synchronize()
+{
+    epochs.synchronize();
+}
+
+
+/******************************************************* reader functions *******************************************************/
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+typename AVLRcuTree<ptr_type, condition, allocator>::read_guard AVLRcuTree<ptr_type, condition, allocator>::lock_for_reading()
+{
+    return read_guard(epochs);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+int AVLRcuTree<ptr_type, condition, allocator>::get_num_of_nodes()
+{
+    return num_of_nodes.load();
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+ptr_type* AVLRcuTree<ptr_type, condition, allocator>::search(ptr_type* data)
+{
+    read_guard guard(epochs);
+    condition cond;
+    node_type* r = root.load();
+    while (r != nullptr)
+    {
+        Comparison result = cond(data, r->data);
+        if (result == Comparison::EQUAL)
+        {
+            return r->data;
+        }
+        r = (result == Comparison::LESS_THAN) ? r->left : r->right;
+    }
+    return nullptr;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+ptr_type* AVLRcuTree<ptr_type, condition, allocator>::get_closest_left(ptr_type* data)
+{
+    read_guard guard(epochs);
+    condition cond;
+    node_type* r = root.load();
+    node_type* last_left_father = nullptr;    // last node the descent went right from
+    while (r != nullptr)
+    {
+        Comparison result = cond(data, r->data);
+        if (result == Comparison::EQUAL)
+        {
+            if (r->left != nullptr)
+            {
+                r = r->left;
+                while (r->right != nullptr)
+                {
+                    r = r->right;
+                }
+                return r->data;
+            }
+            return (last_left_father == nullptr) ? nullptr : last_left_father->data;
+        }
+        if (result == Comparison::LESS_THAN)
+        {
+            r = r->left;
+        }
+        else
+        {
+            last_left_father = r;
+            r = r->right;
+        }
+    }
+    return nullptr;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+ptr_type* AVLRcuTree<ptr_type, condition, allocator>::get_closest_right(ptr_type* data)
+{
+    read_guard guard(epochs);
+    condition cond;
+    node_type* r = root.load();
+    node_type* last_right_father = nullptr;   // last node the descent went left from
+    while (r != nullptr)
+    {
+        Comparison result = cond(data, r->data);
+        if (result == Comparison::EQUAL)
+        {
+            if (r->right != nullptr)
+            {
+                r = r->right;
+                while (r->left != nullptr)
+                {
+                    r = r->left;
+                }
+                return r->data;
+            }
+            return (last_right_father == nullptr) ? nullptr : last_right_father->data;
+        }
+        if (result == Comparison::GREATER_THAN)
+        {
+            r = r->right;
+        }
+        else
+        {
+            last_right_father = r;
+            r = r->left;
+        }
+    }
+    return nullptr;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+template <class visitor_type>
+void AVLRcuTree<ptr_type, condition, allocator>::for_each_in_range(ptr_type* lo, ptr_type* hi, visitor_type visitor)
+{
+    read_guard guard(epochs);
+    range_travel(root.load(), lo, hi, visitor);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+template <class visitor_type>
+void AVLRcuTree<ptr_type, condition, allocator>::range_travel(node_type* r, ptr_type* lo, ptr_type* hi, visitor_type& visitor)
+{
+    if (r == nullptr)
+    {
+        return;
+    }
+    condition cond;
+    bool above_lo = cond(lo, r->data) != Comparison::GREATER_THAN;
+    bool below_hi = cond(hi, r->data) != Comparison::LESS_THAN;
+    if (above_lo)
+    {
+        range_travel(r->left, lo, hi, visitor);
+    }
+    if (above_lo && below_hi)
+    {
+        visitor(r->data);
+    }
+    if (below_hi)
+    {
+        range_travel(r->right, lo, hi, visitor);
+    }
+}
+
+
+/******************************************************* destructor *******************************************************/
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+void AVLRcuTree<ptr_type, condition, allocator>::destructor(node_type* r)
+{
+    if (r == nullptr)
+    {
+        return;
+    }
+    destructor(r->left);
+    destructor(r->right);
+    node_allocator.deallocate(r);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator>
+AVLRcuTree<ptr_type, condition, allocator>::~AVLRcuTree()
+{
+    epochs.synchronize();
+    if (allocator_type::BULK_RELEASE)
+    {
+        node_allocator.release();
+    }
+    else
+    {
+        destructor(root.load());
+    }
+}
+
+#endif //AVL_AVLRCUTREE_H
@@ -0,0 +1,122 @@
+#ifndef AVL_AVLSTATS_H
+#define AVL_AVLSTATS_H
+
+#include <type_traits>
+
+
+// the rebalancing rotations made by balance_tree
+enum class AVLRotation
+{
+    LL,
+    RR,
+    LR,
+    RL
+};
+
+// the operations whose descents are recorded in the depth histograms - SEARCH also records the descents of the
+// neighbor, bound and rank queries, INSERT the climb and descent of insert_hint as one
+enum class AVLDescent
+{
+    INSERT,
+    SEARCH,
+    REMOVE
+};
+
+
+//counters reported by the instrumentation of AVLTree
+struct AVLTreeStats
+{
+    static const int NUM_OF_ROTATIONS = 4;
+    static const int NUM_OF_DESCENTS = 3;
+    static const int MAX_DEPTH = 64;    // deeper descents are counted in the last bucket
+
+    long comparisons = 0;                           // every call of the condition (or compare of cached keys)
+    long rotations[NUM_OF_ROTATIONS] = {};          // by AVLRotation, a double rotation counts once
+    long retrace_steps = 0;                         // nodes retrace fixed on the way up
+    long allocations = 0;                           // nodes allocated by the tree
+    long descents[NUM_OF_DESCENTS][MAX_DEPTH] = {}; // by AVLDescent and by how many nodes the descent compared
+
+    long get_rotations(AVLRotation kind) const
+    {
+        return rotations[static_cast<int>(kind)];
+    }
+
+    long get_descents(AVLDescent operation, int depth) const
+    {
+        return descents[static_cast<int>(operation)][depth];
+    }
+};
+
+
+/** instrumentation policy that counts into an AVLTreeStats (the one to pass to AVLTree)
+ * an instrumentation is a class with
+ * count_comparison(), count_rotation(AVLRotation kind), count_retrace_step(), count_allocations(long n),
+ * count_descent(AVLDescent operation, int depth), AVLTreeStats snapshot() const and reset()
+ * it's called from the thread that changes the tree, so it needs no synchronization - parallel build
+ * counts its nodes in one call after all its tasks are done
+ */
+class AVLStatsCounter
+{
+private:
+    AVLTreeStats stats;
+
+public:
+    void count_comparison()
+    {
+        stats.comparisons++;
+    }
+
+    void count_rotation(AVLRotation kind)
+    {
+        stats.rotations[static_cast<int>(kind)]++;
+    }
+
+    void count_retrace_step()
+    {
+        stats.retrace_steps++;
+    }
+
+    void count_allocations(long n)
+    {
+        stats.allocations += n;
+    }
+
+    void count_descent(AVLDescent operation, int depth)
+    {
+        if (depth >= AVLTreeStats::MAX_DEPTH)
+        {
+            depth = AVLTreeStats::MAX_DEPTH - 1;
+        }
+        stats.descents[static_cast<int>(operation)][depth]++;
+    }
+
+    AVLTreeStats snapshot() const
+    {
+        return stats;
+    }
+
+    void reset()
+    {
+        stats = AVLTreeStats();
+    }
+};
+
+
+//the instrumentation kept by a tree - an empty class when the tree has none, and no call reaches it
+template <class instrumentation, class = void>
+struct AVLInstrumentationOf
+{
+    using type = instrumentation;
+};
+
+struct AVLNoInstrumentation
+{
+};
+
+template <class instrumentation>
+struct AVLInstrumentationOf<instrumentation, std::enable_if_t<std::is_void<instrumentation>::value>>
+{
+    using type = AVLNoInstrumentation;
+};
+
+#endif //AVL_AVLSTATS_H
@@ -1,6 +1,16 @@
 #ifndef AVL_AVLTREE_H
 #define AVL_AVLTREE_H
 
+#include "AVLNodePool.h"
+#include "AVLParallel.h"
+#include "AVLStats.h"
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
 
 enum class Comparison
 {
@@ -10,235 +20,1070 @@ enum class Comparison
 };
 
 
-//class for tree nodes
-template <class ptr_type>
-class AVLNode
+//inline copy of the key of a node's data - only kept when the tree has a key extractor
+template <class key_type>
+class AVLNodeKey
+{
+public:
+    key_type key;
+};
+
+template <>
+class AVLNodeKey<void>
+{
+};
+
+
+//summary of a node's subtree - only kept when the tree has an augmentation
+template <class summary_type>
+class AVLNodeSummary
+{
+public:
+    summary_type summary;
+};
+
+template <>
+class AVLNodeSummary<void>
+{
+};
+
+
+//data of a node - a pointer to the caller's object
+template <class ptr_type, bool owns_data>
+class AVLNodeData
 {
 public:
     ptr_type* data;
+    AVLNodeData(ptr_type* data_to_copy) : data(data_to_copy) {}
+    AVLNodeData() = default;
+    ptr_type* get_data() { return data; }
+};
+
+//data of a node in a value owning tree - the object itself, destroyed with the node
+template <class ptr_type>
+class AVLNodeData<ptr_type, true>
+{
+public:
+    ptr_type value;
+    AVLNodeData(ptr_type* data_to_copy) : value(*data_to_copy) {}
+    template <class... Args>
+    AVLNodeData(std::in_place_t, Args&&... args) : value(std::forward<Args>(args)...) {}
+    ptr_type* get_data() { return &value; }
+};
+
+
+//class for tree nodes
+template <class ptr_type, class key_type = void, class summary_type = void, bool owns_data = false>
+class AVLNode : public AVLNodeKey<key_type>, public AVLNodeSummary<summary_type>, public AVLNodeData<ptr_type, owns_data>
+{
+public:
     int height;
+    int size;       // number of nodes in the subtree of this node
     AVLNode* left;
     AVLNode* right;
-    AVLNode(ptr_type* data_to_copy) : data(data_to_copy), height(0), left(nullptr), right(nullptr) {}
+    AVLNode* parent;
+    AVLNode(ptr_type* data_to_copy) : AVLNodeData<ptr_type, owns_data>(data_to_copy), height(0), size(1), left(nullptr), right(nullptr), parent(nullptr) {}
+    template <class... Args>
+    AVLNode(std::in_place_t tag, Args&&... args) : AVLNodeData<ptr_type, owns_data>(tag, std::forward<Args>(args)...), height(0), size(1), left(nullptr), right(nullptr), parent(nullptr) {}
     AVLNode() = default;
 };
 
 
-//overall class for AVL tree
-template <class ptr_type, class condition>
+/** tells if a condition is transparent - declares 'using is_transparent = void;' and can compare
+ * a lightweight key against a data pointer: Comparison operator()(const key_type& key, const ptr_type* data)
+ */
+template <class condition, class = void>
+struct AVLIsTransparent : std::false_type {};
+
+template <class condition>
+struct AVLIsTransparent<condition, std::void_t<typename condition::is_transparent>> : std::true_type {};
+
+
+/** key extractor types - a key extractor is a functor with 'using key_type = ...;' and
+ * key_type operator()(const ptr_type* data), returning a small trivially copyable key that is ordered by '<'
+ * the same way template condition orders the data
+ */
+template <class key_extractor, class = void>
+struct AVLExtractedKey
+{
+    using type = typename key_extractor::key_type;
+};
+
+template <class key_extractor>
+struct AVLExtractedKey<key_extractor, std::enable_if_t<std::is_void<key_extractor>::value>>
+{
+    using type = void;
+};
+
+
+/** augmentation types - an augmentation is a policy with 'using summary_type = ...;' and
+ * static summary_type identity() - the summary of no nodes
+ * static summary_type summarize(const ptr_type* data) - the summary of one node
+ * static summary_type combine(const summary_type& smaller, const summary_type& bigger) - associative (a monoid),
+ * 'smaller' summarizes nodes that come before the nodes of 'bigger'
+ * e.g. sums, minimums, maximums or counts of the data
+ * summary_type must be trivially destructible - the pool may drop nodes without destroying them
+ */
+template <class augmentation, class = void>
+struct AVLAugmentedSummary
+{
+    using type = typename augmentation::summary_type;
+};
+
+template <class augmentation>
+struct AVLAugmentedSummary<augmentation, std::enable_if_t<std::is_void<augmentation>::value>>
+{
+    using type = void;
+};
+
+
+template <class ptr_type, class condition, class key_extractor>
+class AVLFrozenTree;
+
+template <class ptr_type>
+struct AVLFlatCodec;
+
+
+/** overall class for AVL tree
+ * nodes are taken from 'allocator' (AVLNodePool by default, AVLNodeHeapAllocator for plain new/delete)
+ * trees that exchange nodes (split, join, unite...) end up sharing one allocator - such trees must not be
+ * changed from different threads at the same time (unless the allocator is locked, see AVLLockedNodePool)
+ * joining the allocators is O(1), except when the allocators of both trees are shared with more trees -
+ * then the nodes taken are copied in O(n) (give such trees one allocator with the allocator constructor)
+ * with a 'key_extractor' (see AVLExtractedKey) every node keeps a copy of its key, and descents compare
+ * the inline keys without touching the data objects
+ * with an 'augmentation' (see AVLAugmentedSummary) every node keeps the summary of its subtree, kept up to date
+ * wherever subtree sizes are, and aggregate answers range queries in O(log n) - without one nodes keep nothing
+ * with an 'instrumentation' (AVLStatsCounter, see AVLStats.h) the hot paths count comparisons, rotations, retrace
+ * steps, allocations and descent depths, read by get_tree_stats - without one no counting code is compiled in
+ * with 'owns_data' (see AVLValueTree) every node holds its ptr_type object inline instead of a pointer to it:
+ * objects are constructed by emplace or moved in, destroyed with their nodes, and the functions that take a
+ * ptr_type* to insert copy the object into the node - data pointers handed out point into the nodes
+ */
+template <class ptr_type, class condition, template <class> class allocator = AVLNodePool, class key_extractor = void, class augmentation = void, class instrumentation = void, bool owns_data = false>
 class AVLTree
 {
+public:
+    using key_type = typename AVLExtractedKey<key_extractor>::type;
+    using summary_type = typename AVLAugmentedSummary<augmentation>::type;
+    using node_type = AVLNode<ptr_type, key_type, summary_type, owns_data>;
+    using allocator_type = allocator<node_type>;
+
 private:
-    // - sub function for insert: adds a layer for passing root
-    AVLNode<ptr_type>* insert_node(AVLNode<ptr_type>*& r, ptr_type* data, AVLNode<ptr_type>*& r_new_junction);
+    static const bool CACHED_KEYS = !std::is_void<key_extractor>::value;
+    static const bool AUGMENTED = !std::is_void<augmentation>::value;
+    static const bool INSTRUMENTED = !std::is_void<instrumentation>::value;
+
+    // - sub function for insert and build: allocates a node for data (and copies its key), from pool if given
+    node_type* new_node(ptr_type* data);
+    node_type* new_node(ptr_type* data, allocator_type& pool);
+
+    // -- sub function for new_node, emplace and extract: sets the cached key and summary of a node alone
+    void prepare_node(node_type* r);
+
+    // - sub function for all descents: compares data (or a lightweight key) to the data of node r
+    template <class probe_type>
+    Comparison compare(const probe_type& data, node_type* r);
+
+    /** - sub function for insert and insert_hint: finds the place of data in one descent and links a new node there
+     * the descent starts at the 'side' child of 'start' (data is known to be on that side of it), or at the root
+     */
+    node_type* insert_node(ptr_type* data, node_type* start = nullptr, Comparison side = Comparison::EQUAL, int depth = 0);
+
+    /** -- sub function for insert_node, emplace and inserting node handles: finds the place of data in one descent
+     * 'father' and 'side' start as for insert_node and end as the father of the place and the side of it
+     * 'depth' is how many nodes the insert compared before the descent (insert_hint's climb), counted with its own
+     * returns false - if data already exists
+     */
+    bool find_place(ptr_type* data, node_type*& father, Comparison& side, int depth = 0);
+
+    // -- sub function for insert and insert_hint: links new_junction as the 'side' child of father, then retraces
+    node_type* link_new_node(node_type* father, node_type* new_junction, Comparison side);
+
+    // - sub function for the functions that replace the whole tree: recomputes the min and max fingers
+    void refresh_fingers();
+
+    // - sub function for insert and remove: fixes heights and balance from r up, stops when a height stays the same
+    void retrace(node_type* r);
+
+    // -- sub function for retrace: updates subtree sizes (and summaries) from r up to the root
+    void update_sizes_to_root(node_type* r);
+
+    // -- sub function for retrace and remove: links new_child to father in place of old_child (or as root)
+    void replace_child(node_type* father, node_type* old_child, node_type* new_child);
 
     // - sub function for insert: balance the tree with proper rotations
-    AVLNode<ptr_type>* balance_tree(AVLNode<ptr_type>*& r);
+    node_type* balance_tree(node_type*& r);
 
     // -- sub function for balance: makes an RR rotation
-    AVLNode<ptr_type>* make_RR_rotation(AVLNode<ptr_type>*& r);
+    node_type* make_RR_rotation(node_type*& r);
 
     // -- sub function for balance: makes an LL rotation
-    AVLNode<ptr_type>* make_LL_rotation(AVLNode<ptr_type>*& r);
+    node_type* make_LL_rotation(node_type*& r);
 
     // -- sub function for balance: makes an RL rotation
-    AVLNode<ptr_type>* make_RL_rotation(AVLNode<ptr_type>*& r);
+    node_type* make_RL_rotation(node_type*& r);
 
     // -- sub function for balance: makes an LR rotation
-    AVLNode<ptr_type>* make_LR_rotation(AVLNode<ptr_type>*& r);
+    node_type* make_LR_rotation(node_type*& r);
 
     // -- sub function for balance: calculates balance factor of node
-    int get_bf(AVLNode<ptr_type>*& r);
+    int get_bf(node_type*& r);
 
     // - sub function for insert: updates height of node
-    void update_height(AVLNode<ptr_type>*& r);
+    void update_height(node_type*& r);
 
-    // - sub function for remove: adds a layer for passing root and result of operation
-    AVLNode<ptr_type>* remove_node(AVLNode<ptr_type>*& r, ptr_type* data, bool*& result, bool erase);
+    // - sub function for insert, remove, rotations and build: updates height, subtree size and summary of node
+    void update_node(node_type*& r);
+
+    // -- sub function for update_node and the order statistics: returns the subtree size of a node (0 for nullptr)
+    int get_size(node_type* r);
+
+    // - sub function for rank and count_between: counts nodes smaller than data (or equal to it, if inclusive)
+    int count_smaller(ptr_type* data, bool inclusive);
+
+    // -- sub function for update_node and update_sizes_to_root: recomputes the summary of a node from its children (no-op without augmentation)
+    void update_summary(node_type* r);
+
+    // -- sub function for aggregate: returns the summary of the subtree of a node (identity for nullptr)
+    summary_type get_summary(node_type* r);
+
+    // - sub function for aggregate: combines the nodes of the subtree of r that are not smaller than lo
+    summary_type aggregate_from(node_type* r, ptr_type* lo);
+
+    // - sub function for aggregate: combines the nodes of the subtree of r that are not bigger than hi
+    summary_type aggregate_to(node_type* r, ptr_type* hi);
+
+    // - sub function for remove and erase: unlinks the node of data (or key) and frees it, returns false if it doesn't exist
+    template <class probe_type>
+    bool remove_node(const probe_type& data, bool erase);
+
+    // -- sub function for remove_node and extract: takes node r out of the tree without freeing it, then retraces
+    void unlink_node(node_type* r);
 
     // - sub function for remove: finds a successor for removed node
-    AVLNode<ptr_type>* find_successor(AVLNode<ptr_type>* b);
+    node_type* find_successor(node_type* b);
 
-    // - sub function for search: adds a layer for passing root and result of operation
-    AVLNode<ptr_type>* search_node(AVLNode<ptr_type>*& r, ptr_type* data, AVLNode<ptr_type>*& requested);
+    // - sub function for search, find and remove: finds the node of data (or key) in one descent, recorded as 'operation'
+    template <class probe_type>
+    node_type* search_node(const probe_type& data, AVLDescent operation = AVLDescent::SEARCH);
+
+    // - sub function for the counted paths: hands the count to the instrumentation (compiles to nothing without one)
+    template <class count_function>
+    void count(count_function function);
+
+    // - sub function for lower_bound: finds the first node that is not smaller than data (or key)
+    template <class probe_type>
+    node_type* lower_bound_node(const probe_type& data);
+
+    // - sub function for upper_bound: finds the first node that is bigger than data (or key)
+    template <class probe_type>
+    node_type* upper_bound_node(const probe_type& data);
+
+    // - sub function for the key overloads: rejects keys that the condition can't compare
+    template <class probe_type>
+    static void check_probe_type();
 
     // - sub function for search: adds a layer for passing root and result of operation
-    void erase_data_in_node(AVLNode<ptr_type>*& r);
+    void erase_data_in_node(node_type*& r);
+
+    // -- sub function for erase_data: erase_data_in_node split into subtree tasks over 'threads' threads
+    void erase_data_in_parallel(node_type* r, int threads);
+
+    // - sub function for destructor: frees all nodes to pool (without freeing the data in every node)
+    void destructor(node_type*& root, allocator_type& pool);
+
+    /** -- sub function for free_all_nodes: destructor split into subtree tasks over 'threads' threads
+     * every task frees to a pool of its own, which is absorbed into pool when the task is done
+     */
+    void destructor_in_parallel(node_type* r, allocator_type& pool, int threads);
 
-    // - sub function for destructor: frees all nodes (without freeing the data in every node)
-    void destructor(AVLNode<ptr_type>*& root);
+    /** - sub function for destructor and build_from_array: frees all nodes, at once if the allocator allows it and isn't shared
+     * over the threads set by set_num_of_threads, or on this thread only if not in_parallel (starting tasks may throw)
+     */
+    void free_all_nodes(bool in_parallel = true);
 
     // - sub function for inorder: adds layer of root
-    void inorder_travel(AVLNode<ptr_type>* r, ptr_type**& elements_by_order, int*& index);
+    void inorder_travel(node_type* r, ptr_type**& elements_by_order, int& index);
+
+    /** - sub function for export_inorder: writes the subtree of r from out[0] on, split into subtree tasks over 'threads' threads
+     * the place of every subtree is known from the sizes, so the tasks write disjoint parts of out without locking
+     */
+    void export_in_parallel(node_type* r, ptr_type** out, int threads);
 
     // - sub function for get_max_node: returns max node for any tree that starts with a given root
-    AVLNode<ptr_type>* get_max_node_by_root(AVLNode<ptr_type>* given_root);
+    node_type* get_max_node_by_root(node_type* given_root);
 
     // - sub function for get_min_node: returns min node for any tree that starts with a given root
-    AVLNode<ptr_type>* get_min_node_by_root(AVLNode<ptr_type>* given_root);
+    node_type* get_min_node_by_root(node_type* given_root);
+
+    // - sub function for insert, remove and build: points the parent link of a child (if exists) to its father
+    void set_parent(node_type* child, node_type* father);
+
+    // - sub function for join and the set operations: returns the height of a node (EMPTY_TREE for nullptr)
+    int get_height(node_type* r);
+
+    // - sub function for join and split: makes k the father of l and r, returns k
+    node_type* link_node(node_type* l, node_type* k, node_type* r);
+
+    // - sub function for join, split and the set operations: joins l < k < r into one balanced tree, returns its root
+    node_type* join_nodes(node_type* l, node_type* k, node_type* r);
+
+    // -- sub function for join_nodes: hangs k and r on the right spine of the taller l
+    node_type* join_right(node_type* l, node_type* k, node_type* r);
+
+    // -- sub function for join_nodes: hangs l and k on the left spine of the taller r
+    node_type* join_left(node_type* l, node_type* k, node_type* r);
+
+    // - sub function for join and the set operations: joins l < r without a middle node
+    node_type* join_without_pivot(node_type* l, node_type* r);
+
+    // -- sub function for join_without_pivot: takes the max node out of t, returns the root of the rest
+    node_type* split_last(node_type* t, node_type*& last);
+
+    // - sub function for split and the set operations: splits t to nodes smaller, equal and bigger than data
+    template <class probe_type>
+    void split_nodes(node_type* t, const probe_type& data, node_type*& smaller, node_type*& equal, node_type*& bigger);
+
+    // - sub function for the set operations: returns what descents compare to a node (its cached key or its data)
+    auto get_probe(node_type* r);
+
+    // -- sub functions for unite, intersect and subtract: the node of t1 is kept when both trees have a node
+    node_type* unite_nodes(node_type* t1, node_type* t2);
+    node_type* intersect_nodes(node_type* t1, node_type* t2);
+    node_type* subtract_nodes(node_type* t1, node_type* t2);
+
+    /** - sub function for the functions that take nodes of another tree: makes the nodes of other freeable by this tree
+     * in O(1) by joining the two allocators, unless both are shared with more trees - then the nodes of other are copied
+     */
+    void adopt_nodes_of(AVLTree& other);
+
+    // -- sub function for adopt_nodes_of: copies the subtree of r into this tree's allocator, frees the old nodes to from
+    node_type* reallocate_nodes(node_type* r, allocator_type& from);
+
+    // - sub function for the functions that take all nodes of another tree: empties other without freeing its nodes
+    node_type* take_root_of(AVLTree& other);
+
+    // - sub function for clone: copies the subtree of r node by node into pool, returns the root of the copy
+    node_type* clone_nodes(node_type* r, allocator_type& pool);
+
+    /** -- sub function for clone: clone_nodes split into subtree tasks over 'threads' threads
+     * every task allocates from a pool of its own, which is absorbed into pool when the task is done
+     */
+    node_type* clone_in_parallel(node_type* r, allocator_type& pool, int threads);
+
+    // - sub function for the move constructor and move assignment: swaps the whole content with other
+    void swap_with(AVLTree& other) noexcept;
+
+    // - sub function for the functions that allocate: returns the allocator of the tree, makes it if the tree has none yet
+    allocator_type& get_node_allocator();
 
-    // - sub function for get_closest_left and get_closest_right: returns father of key object, returns nullptr if not
-    AVLNode<ptr_type>* get_father(AVLNode<ptr_type>* r, ptr_type* data);
+    // -- sub function for build_from_array: constructs the tree from array in pool, puts the node of array[i] in built[i] if asked
+    node_type* build_tree_from_array(ptr_type** array, int start, int end, allocator_type& pool, node_type** built = nullptr);
 
-    // -- sub function for get_father: confirms if passed node to function is father
-    bool check_if_father(AVLNode<ptr_type>* r, ptr_type* data);
+    /** -- sub function for build_from_array: build_tree_from_array split into subtree tasks over 'threads' threads
+     * every task allocates from a pool of its own, which is absorbed into pool when the task is done
+     */
+    node_type* build_tree_in_parallel(ptr_type** array, int start, int end, allocator_type& pool, int threads);
+
+    // -- sub function for the batch functions: links nodes that are already sorted into a balanced tree
+    node_type* build_tree_from_nodes(node_type** nodes, int start, int end);
+
+    // - sub function for insert_batch and erase_batch: returns the first place in data[0..n) that is not smaller than node r
+    int batch_lower_bound(ptr_type** data, int n, node_type* r);
+
+    // - sub function for insert_batch: inserts a sorted batch into the subtree of t in one pass, returns the new root
+    node_type* insert_batch_nodes(node_type* t, ptr_type** data, int n, node_type** results);
 
-    // -- sub function for build_from_array: constructs the tree from array
-    AVLNode<ptr_type>* build_tree_from_array(ptr_type** array, int start, int end);
+    // - sub function for erase_batch: removes a sorted batch from the subtree of t in one pass, returns the new root
+    node_type* erase_batch_nodes(node_type* t, ptr_type** data, int n, bool* results);
 
-    AVLNode<ptr_type>* root;
+    // - sub functions for insert_batch and erase_batch on a big batch: merge the batch with all nodes and rebuild
+    void insert_batch_by_rebuild(ptr_type** data, int n, node_type** results);
+    void erase_batch_by_rebuild(ptr_type** data, int n, bool* results);
+
+    node_type* root;
+    node_type* min_node;    // finger to the min node, kept up to date by every change
+    node_type* max_node;    // finger to the max node, kept up to date by every change
     int num_of_nodes;
+    std::shared_ptr<allocator_type> node_allocator;   // shared with the trees this tree exchanged nodes with
+    int num_of_threads;     // threads used by build_from_array, erase_data and freeing all nodes
+    typename AVLInstrumentationOf<instrumentation>::type counters;
 
     static const int EMPTY_TREE = -1;
+    static const int SEARCH_BATCH_GROUP = 16;   // descents search_batch advances in lockstep
+    static const int BATCH_REBUILD_RATIO = 4;   // batches of at least 1/4 of the tree are merged and rebuilt
     static const int UNBALANCED_POSITIVE_BF = 2;
     static const int UNBALANCED_NEGATIVE_BF = -2;
 
 public:
-    // constructor
-    AVLTree() : root(nullptr), num_of_nodes(0) {}
+    /** bidirectional iterator over the tree by order of template condition
+     * dereferences to the data pointer of the node, end() is one past the max node
+     * walks the parent links - stays valid as long as its node is in the tree
+     */
+    class iterator
+    {
+    private:
+        AVLTree* tree;
+        node_type* node;
+
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = ptr_type*;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<owns_data, ptr_type*, ptr_type* const*>;
+        using reference = std::conditional_t<owns_data, ptr_type*, ptr_type* const&>;
+
+        iterator() : tree(nullptr), node(nullptr) {}
+        iterator(AVLTree* tree, node_type* node) : tree(tree), node(node) {}
+
+        // with owns_data dereferences to a pointer to the object in the node
+        reference operator*() const
+        {
+            if constexpr (owns_data)
+            {
+                return node->get_data();
+            }
+            else
+            {
+                return node->data;
+            }
+        }
+
+        pointer operator->() const
+        {
+            if constexpr (owns_data)
+            {
+                return node->get_data();
+            }
+            else
+            {
+                return &node->data;
+            }
+        }
+
+        // returns the node the iterator points to (nullptr for end())
+        node_type* get_node() const { return node; }
+
+        iterator& operator++()
+        {
+            node = tree->get_next_node(node);
+            return *this;
+        }
+
+        iterator operator++(int)
+        {
+            iterator old = *this;
+            ++(*this);
+            return old;
+        }
+
+        iterator& operator--()
+        {
+            node = (node == nullptr) ? tree->get_max_node() : tree->get_prev_node(node);
+            return *this;
+        }
+
+        iterator operator--(int)
+        {
+            iterator old = *this;
+            --(*this);
+            return old;
+        }
+
+        bool operator==(const iterator& other) const { return node == other.node; }
+        bool operator!=(const iterator& other) const { return node != other.node; }
+    };
+
+    using reverse_iterator = std::reverse_iterator<iterator>;
+
+    /** a node taken out of a tree by extract, with its object - owns the node until it's inserted back
+     * (into this tree or any tree with the same node_type) and frees it, with its object, when destroyed
+     */
+    class node_handle
+    {
+    private:
+        std::shared_ptr<allocator_type> node_allocator;   // the allocator the node came from
+        node_type* node;
+
+        friend class AVLTree;
+
+        node_handle(std::shared_ptr<allocator_type> node_allocator, node_type* node) : node_allocator(std::move(node_allocator)), node(node) {}
+
+    public:
+        node_handle() : node(nullptr) {}
+
+        node_handle(node_handle&& other) noexcept : node_allocator(std::move(other.node_allocator)), node(other.node)
+        {
+            other.node = nullptr;
+        }
+
+        node_handle& operator=(node_handle&& other) noexcept
+        {
+            if (this != &other)
+            {
+                reset();
+                node_allocator = std::move(other.node_allocator);
+                node = other.node;
+                other.node = nullptr;
+            }
+            return *this;
+        }
+
+        node_handle(const node_handle&) = delete;
+        node_handle& operator=(const node_handle&) = delete;
+
+        // returns true if the handle holds no node
+        bool empty() const { return node == nullptr; }
+
+        explicit operator bool() const { return node != nullptr; }
+
+        // returns the object of the node (the pointed to object without owns_data)
+        ptr_type& value() const { return *node->get_data(); }
+
+        // frees the node now
+        void reset()
+        {
+            if (node != nullptr)
+            {
+                node_allocator->deallocate(node);
+                node = nullptr;
+            }
+            node_allocator.reset();
+        }
+
+        ~node_handle()
+        {
+            reset();
+        }
+    };
+
+    // constructor - the allocator is made by the first allocation, so an empty tree costs nothing
+    AVLTree() noexcept : root(nullptr), min_node(nullptr), max_node(nullptr), num_of_nodes(0), node_allocator(), num_of_threads(1) {}
+
+    /** constructor for a tree that takes its nodes from 'node_allocator', which other trees may share
+     * (trees that share an allocator exchange nodes in split, join and the set operations without copying them)
+     */
+    explicit AVLTree(std::shared_ptr<allocator_type> node_allocator) : root(nullptr), min_node(nullptr), max_node(nullptr), num_of_nodes(0), node_allocator(std::move(node_allocator)), num_of_threads(1) {}
+
+    // a copy would share the nodes - use clone()
+    AVLTree(const AVLTree&) = delete;
+    AVLTree& operator=(const AVLTree&) = delete;
+
+    /** move constructor in O(1) - takes the nodes and the allocator of other, which is left empty
+     * nodes of other stay valid and belong to this tree
+     */
+    AVLTree(AVLTree&& other) noexcept;
+
+    /** move assignment - frees the nodes this tree had, then takes the nodes of other like the move constructor
+     * (O(1) when this tree was empty or its allocator can drop all nodes at once, otherwise the nodes are freed
+     * on this thread, without parallel tasks, so nothing can throw)
+     */
+    AVLTree& operator=(AVLTree&& other) noexcept;
+
+    /** returns a copy of the tree with the same shape, in O(n) without comparing or rebalancing
+     * copies node by node into an allocator of its own, over the threads set by set_num_of_threads
+     * the copy points to the same data (with owns_data it holds copies of the objects)
+     */
+    AVLTree clone();
 
     // builds tree from sorted array without duplicates
     void build_from_array(ptr_type** data_array, int size);
 
+    /** sets how many threads build_from_array, erase_data, and freeing all nodes (destructor, build, join)
+     * split their work between - subtrees of at least AVL_PARALLEL_CUTOFF nodes become separate tasks
+     * 1 (the default) keeps them on the calling thread, 0 uses every core
+     * the tree itself isn't thread safe - parallel functions return only when all their tasks are done
+     */
+    void set_num_of_threads(int threads);
+
     // returns how many nodes the tree consists
     int get_num_of_nodes();
 
     // returns the height of the tree
     int get_tree_height();
 
-    /** returns pointer to the tree's max node
+    /** returns pointer to the tree's max node in O(1)
+     * returns nullptr - if tree is empty
+     */
+    node_type* get_max_node();
+
+    /** returns pointer to the tree's min node in O(1)
      * returns nullptr - if tree is empty
      */
-    AVLNode<ptr_type>* get_max_node();
+    node_type* get_min_node();
 
     /** inserts a new node to the tree
-     * receives &address of new object created
+     * receives &address of new object created (with owns_data the object is copied into the node)
+     * returns pointer to node created
+     * returns nullptr - if node already exists
+     */
+    node_type* insert(ptr_type* data);
+
+    /** only with owns_data - constructs the object from args inside a new node and inserts it,
+     * no other allocation is made and the object is never copied or moved
+     * returns pointer to node created
+     * returns nullptr - if node already exists (the new object is destroyed)
+     */
+    template <class... Args>
+    node_type* emplace(Args&&... args);
+
+    // only with owns_data - moves 'value' into a new node, like emplace
+    template <bool owning = owns_data, std::enable_if_t<owning, int> = 0>
+    node_type* insert(ptr_type&& value);
+
+    /** inserts the node held by 'handle', without allocating if it came from a tree that shares this tree's allocator
+     * returns pointer to node inserted, and 'handle' is left empty
+     * returns nullptr - if 'handle' is empty or node already exists ('handle' keeps the node)
+     */
+    node_type* insert(node_handle&& handle);
+
+    /** inserts a new node to the tree, starting from 'hint' instead of the root
+     * hint is a node of the tree expected to be near data, nullptr stands for the max node (appending)
+     * appending after the max node (or before the min node) takes one comparison, and a node d places
+     * away from hint takes O(log d) comparisons
      * returns pointer to node created
      * returns nullptr - if node already exists
      */
-    AVLNode<ptr_type>* insert(ptr_type* data);
+    node_type* insert_hint(node_type* hint, ptr_type* data);
+
+    /** inserts a batch of n data pointers, sorted by template condition and without duplicates
+     * the batch is split between the subtrees in one pass and every affected subtree is rebalanced once,
+     * big batches are merged with the tree and rebuilt instead
+     * results (if not nullptr) gets, per data, the node created or nullptr if the node already existed
+     */
+    void insert_batch(ptr_type** data, int n, node_type** results);
 
-    /** removes the node that points to 'data'
+    /** removes a batch of n data pointers, sorted by template condition and without duplicates, like insert_batch
+     * results (if not nullptr) gets, per data, true if its node was removed - the data isn't erased
+     */
+    void erase_batch(ptr_type** data, int n, bool* results);
+
+    /** removes the node that points to 'data' (with owns_data the object in the node is destroyed with it)
      * returns true - if node is found and removed
      * returns false - if node doesn't exist
      */
     bool remove(ptr_type* data);
 
-    /** removes the node that points to 'data' and calls its destructor
+    /** removes the node that points to 'data' and calls its destructor - not for trees with owns_data (use remove)
      * returns true - if node is found and removed, and data is erased
      * returns false - if node doesn't exist
      */
     bool remove_and_erase(ptr_type* data);
 
+    /** takes the node that is equal to 'key' (a data pointer or a lightweight key, see find) out of the tree
+     * without freeing it, so its object can be moved on or the node inserted into a tree again
+     * returns an empty handle - if node doesn't exist
+     */
+    template <class probe_type>
+    node_handle extract(const probe_type& key);
+
     /** returns a pointer to node
      *  returns nullptr - if node doesn't exist
      */
-    AVLNode<ptr_type>* search(ptr_type* data);
+    node_type* search(ptr_type* data);
+
+    /** searches n data pointers (or lightweight keys, see find) at once, out[i] gets the node of keys[i] or nullptr
+     * the descents advance level by level together and prefetch the next node of each, so their cache misses overlap
+     */
+    template <class probe_type>
+    void search_batch(const probe_type* keys, int n, node_type** out);
 
     /**
      * returns a pointer to the closest left neighbor node (smaller then the node)
      * returns nullptr - if doesn't exist
      */
-    AVLNode<ptr_type>* get_closest_left(ptr_type* data);
+    node_type* get_closest_left(ptr_type* data);
 
     /**
-    * returns a pointer to the closest left neighbor node (smaller then the node)
+    * returns a pointer to the closest right neighbor node (bigger then the node)
     * returns nullptr - if doesn't exist
     */
-    AVLNode<ptr_type>* get_closest_right(ptr_type* data);
+    node_type* get_closest_right(ptr_type* data);
+
+    /** returns the closest left neighbor of a node of the tree, walking the parent links
+     * returns nullptr - if node is the min node
+     */
+    node_type* get_prev_node(node_type* node);
+
+    /** returns the closest right neighbor of a node of the tree, walking the parent links
+     * returns nullptr - if node is the max node
+     */
+    node_type* get_next_node(node_type* node);
+
+    /** returns the node in place k by order of template condition (0 based, same place as in inorder())
+     * returns nullptr - if k is out of range
+     */
+    node_type* select(int k);
+
+    // returns how many nodes in the tree are smaller than 'data' ('data' doesn't have to be in the tree)
+    int rank(ptr_type* data);
+
+    // returns how many nodes in the tree are between 'lo' and 'hi', both included (0 if 'lo' is bigger than 'hi')
+    int count_between(ptr_type* lo, ptr_type* hi);
+
+    /** returns the summary (see AVLAugmentedSummary) of the nodes between 'lo' and 'hi' (both included) in O(log n)
+     * only for trees with an augmentation - returns identity() if there are no such nodes
+     */
+    summary_type aggregate(ptr_type* lo, ptr_type* hi);
 
     // returns an array with pointers to nodes' data, by order of template condition
     ptr_type** inorder();
 
+    /** writes the pointers to nodes' data by order of template condition to out, which must have room for
+     * get_num_of_nodes() pointers (any caller owned memory, e.g. an mmap'd file)
+     * uses the threads set by set_num_of_threads
+     * returns how many pointers were written
+     */
+    int export_inorder(ptr_type** out);
+
+    // iterators over the tree by order of template condition - no allocation, O(1) amortized per step
+    iterator begin();
+    iterator end();
+    reverse_iterator rbegin();
+    reverse_iterator rend();
+
+    // returns an iterator to the first node that is not smaller than 'data' (end() if there is none)
+    iterator lower_bound(ptr_type* data);
+
+    // returns an iterator to the first node that is bigger than 'data' (end() if there is none)
+    iterator upper_bound(ptr_type* data);
+
+    /** lookups by a lightweight key instead of a ptr_type object - need a transparent condition (see AVLIsTransparent)
+     * or a key extractor (then the key is compared to the cached keys)
+     * nothing is allocated or constructed on the lookup path
+     * find - returns the node that is equal to key, nullptr if doesn't exist
+     * erase - removes the node that is equal to key, DOES NOT erase its data (like remove)
+     * lower_bound / upper_bound - like the ptr_type* versions
+     */
+    template <class probe_type>
+    node_type* find(const probe_type& key);
+
+    template <class probe_type>
+    bool erase(const probe_type& key);
+
+    template <class probe_type>
+    iterator lower_bound(const probe_type& key);
+
+    template <class probe_type>
+    iterator upper_bound(const probe_type& key);
+
+    /** calls visitor(data) for every node between 'lo' and 'hi' (both included), by order
+     * costs O(log n + k) for k visited nodes, without allocating
+     */
+    template <class visitor_type>
+    void for_each_in_range(ptr_type* lo, ptr_type* hi, visitor_type visitor);
+
+    // returns an immutable read-optimized copy of the tree (see AVLFrozenTree.h, which defines this function)
+    AVLFrozenTree<ptr_type, condition, key_extractor> freeze();
+
+    /** writes the tree to the file at 'path' as a position independent image, which AVLMappedTree::load_mmap maps
+     * and searches in place (see AVLMappedTree.h, which defines this function)
+     * 'codec' writes the data of every node into the image (see AVLFlatCodec)
+     * returns false - if the file can't be written
+     */
+    template <class codec = AVLFlatCodec<ptr_type>>
+    bool save(const char* path);
+
     /** calls for the destructor of the data pointed to at every node
      * does not remove the node itself (that's the destructors job)
+     * not for trees with owns_data - their objects are destroyed with the nodes
      */
     void erase_data();
 
-    // destructor for the tree - DOES NOT erase the data pointed to
+    // returns the counters of the node allocator
+    AVLPoolStats get_pool_stats();
+
+    /** returns a snapshot of the counters of the instrumentation (see AVLStats.h), to export to a metrics system
+     * only for trees with an instrumentation
+     */
+    AVLTreeStats get_tree_stats();
+
+    // zeroes the counters of the instrumentation - only for trees with an instrumentation
+    void reset_tree_stats();
+
+    /** splits the tree by 'data' (or a lightweight key, see find) in O(log n), without allocating
+     * 'smaller' gets the nodes smaller than data, 'bigger' gets the rest, and this tree is left empty
+     * (unless it's one of them)
+     * nodes that 'smaller' and 'bigger' had before are freed (their data isn't erased)
+     */
+    template <class probe_type>
+    void split(const probe_type& data, AVLTree& smaller, AVLTree& bigger);
+
+    /** makes this tree the join of 'smaller', 'pivot' and 'bigger' in O(log n), reusing their nodes
+     * every node of smaller must be smaller than pivot, and pivot smaller than every node of bigger
+     * pivot may be nullptr, then smaller and bigger are just concatenated
+     * smaller and bigger are left empty (one of them may be this tree), nodes this tree had before are freed
+     * O(n) instead if smaller or bigger has an allocator that is shared, and so has this tree (see the class comment)
+     */
+    void join(AVLTree& smaller, ptr_type* pivot, AVLTree& bigger);
+
+    /** set operations - the result is left in this tree and 'other' is left empty
+     * run in O(m log(n/m + 1)) for trees of sizes m <= n, and reuse the nodes of both trees
+     * when both trees have an equal node the node of this tree is kept; nodes that are dropped are
+     * freed, their data isn't erased
+     * O(n) instead if both trees have allocators that are shared with more trees (see the class comment)
+     */
+    void unite(AVLTree& other);
+    void intersect(AVLTree& other);
+    void subtract(AVLTree& other);
+
+    /** gives the tree an allocator of its own in O(1), so it can take part in a join without joining allocators
+     * 'keeper' takes over the slabs of the allocator the tree had (see AVLNodePool::keep_slabs_of) - the nodes don't
+     * move and stay valid as long as keeper holds the slabs, the trees still sharing the old allocator keep its free nodes
+     */
+    void hand_slabs_to(allocator_type& keeper);
+
+    // destructor for the tree - DOES NOT erase the data pointed to (with owns_data destroys the objects in the nodes)
     ~AVLTree();
 
 };
 
 
+/** AVL tree that owns its objects - every node holds its ptr_type object inline, so there is no separate
+ * allocation per object and no pointer hop from a node to its object
+ */
+template <class value_type, class condition, template <class> class allocator = AVLNodePool, class key_extractor = void, class augmentation = void, class instrumentation = void>
+using AVLValueTree = AVLTree<value_type, condition, allocator, key_extractor, augmentation, instrumentation, true>;
+
+
 /******************************************************* build tree from array functions *******************************************************/
 
 
-template <class ptr_type, class condition>
-void AVLTree<ptr_type, condition>::build_from_array(ptr_type **data_array, int size)
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::build_from_array(ptr_type **data_array, int size)
 {
     if (size < 1 || data_array == nullptr)
     {
         return;
     }
-    destructor(root);
-    root = build_tree_from_array(data_array, 0, size-1);
+    free_all_nodes();
+    root = build_tree_in_parallel(data_array, 0, size-1, get_node_allocator(), num_of_threads);
+    root->parent = nullptr;
     num_of_nodes = size;
+    count([size](auto& counters) { counters.count_allocations(size); });
+    refresh_fingers();
 }
 
 
-template <class ptr_type, class condition>
-AVLNode<ptr_type>* AVLTree<ptr_type, condition>::build_tree_from_array(ptr_type** array, int start, int end)
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::build_tree_from_array(ptr_type** array, int start, int end, allocator_type& pool, node_type** built)
 {
     if (start > end)
     {
         return nullptr;
     }
     int mid = (start + end) / 2;
-    AVLNode<ptr_type> *r = new AVLNode<ptr_type>(array[mid]);
-    r->left = build_tree_from_array(array, start, mid - 1);
-    r->right = build_tree_from_array(array, mid + 1, end);
-    update_height(r);
+    node_type *r = new_node(array[mid], pool);
+    if (built != nullptr)
+    {
+        built[mid] = r;
+    }
+    r->left = build_tree_from_array(array, start, mid - 1, pool, built);
+    r->right = build_tree_from_array(array, mid + 1, end, pool, built);
+    set_parent(r->left, r);
+    set_parent(r->right, r);
+    update_node(r);
     return r;
 }
 
 
-/******************************************************* tree details functions *******************************************************/
-
-
-template <class ptr_type, class condition>
-int AVLTree<ptr_type, condition>::get_tree_height()
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::build_tree_in_parallel(ptr_type** array, int start, int end, allocator_type& pool, int threads)
 {
-    if (root->right == nullptr && root->left == nullptr)
+    if (threads < 2 || end - start + 1 < AVL_PARALLEL_CUTOFF)
     {
-        return EMPTY_TREE;
+        return build_tree_from_array(array, start, end, pool);
     }
-    return root->height;
+    int mid = (start + end) / 2;
+    node_type* r = new_node(array[mid], pool);
+    node_type* right = nullptr;
+    allocator_type right_pool;
+    avl_run_in_parallel([&]() { right = build_tree_in_parallel(array, mid + 1, end, right_pool, threads - threads / 2); },
+                        [&]() { r->left = build_tree_in_parallel(array, start, mid - 1, pool, threads / 2); });
+    pool.absorb(right_pool);
+    r->right = right;
+    set_parent(r->left, r);
+    set_parent(r->right, r);
+    update_node(r);
+    return r;
 }
 
-template <class ptr_type, class condition>
-int AVLTree<ptr_type, condition>::get_num_of_nodes()
-{
-    return num_of_nodes;
-}
 
-template <class ptr_type, class condition>
-AVLNode<ptr_type>* AVLTree<ptr_type, condition>::get_max_node()
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::set_num_of_threads(int threads)
 {
-    return get_max_node_by_root(root);
+    num_of_threads = avl_resolve_num_of_threads(threads);
 }
 
-template <class ptr_type, class condition>
-AVLNode<ptr_type>* AVLTree<ptr_type, condition>::get_max_node_by_root(AVLNode<ptr_type>* given_root)
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::build_tree_from_nodes(node_type** nodes, int start, int end)
 {
-    AVLNode<ptr_type>* r;
-    if (given_root == nullptr)
+    if (start > end)
     {
         return nullptr;
     }
-    r = given_root;
-    while(r->right != nullptr)
-    {
-        r = r->right;
-    }
-    return r;
+    int mid = (start + end) / 2;
+    return link_node(build_tree_from_nodes(nodes, start, mid - 1), nodes[mid], build_tree_from_nodes(nodes, mid + 1, end));
 }
 
 
-template <class ptr_type, class condition>
-AVLNode<ptr_type>* AVLTree<ptr_type, condition>::get_min_node_by_root(AVLNode<ptr_type>* given_root)
+/******************************************************* clone and move functions *******************************************************/
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::AVLTree(AVLTree&& other) noexcept : AVLTree()
+{
+    swap_with(other);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>& AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::operator=(AVLTree&& other) noexcept
+{
+    if (this != &other)
+    {
+        free_all_nodes(false);
+        swap_with(other);
+    }
+    return *this;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::swap_with(AVLTree& other) noexcept
+{
+    std::swap(root, other.root);
+    std::swap(min_node, other.min_node);
+    std::swap(max_node, other.max_node);
+    std::swap(num_of_nodes, other.num_of_nodes);
+    std::swap(node_allocator, other.node_allocator);
+    std::swap(num_of_threads, other.num_of_threads);
+    std::swap(counters, other.counters);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::allocator_type& AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::get_node_allocator()
+{
+    if (node_allocator == nullptr)
+    {
+        node_allocator = std::make_shared<allocator_type>();
+    }
+    return *node_allocator;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data> AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::clone()
+{
+    AVLTree copy;
+    copy.num_of_threads = num_of_threads;
+    copy.root = clone_in_parallel(root, copy.get_node_allocator(), num_of_threads);
+    set_parent(copy.root, nullptr);
+    copy.num_of_nodes = num_of_nodes;
+    copy.refresh_fingers();
+    copy.count([this](auto& counters) { counters.count_allocations(num_of_nodes); });
+    return copy;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::clone_nodes(node_type* r, allocator_type& pool)
+{
+    if (r == nullptr)
+    {
+        return nullptr;
+    }
+    node_type* copy = pool.allocate(*r);
+    copy->left = clone_nodes(r->left, pool);
+    copy->right = clone_nodes(r->right, pool);
+    set_parent(copy->left, copy);
+    set_parent(copy->right, copy);
+    return copy;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::clone_in_parallel(node_type* r, allocator_type& pool, int threads)
+{
+    if (threads < 2 || get_size(r) < AVL_PARALLEL_CUTOFF)
+    {
+        return clone_nodes(r, pool);
+    }
+    node_type* copy = pool.allocate(*r);
+    node_type* right = nullptr;
+    allocator_type right_pool;
+    avl_run_in_parallel([&]() { right = clone_in_parallel(r->right, right_pool, threads - threads / 2); },
+                        [&]() { copy->left = clone_in_parallel(r->left, pool, threads / 2); });
+    pool.absorb(right_pool);
+    copy->right = right;
+    set_parent(copy->left, copy);
+    set_parent(copy->right, copy);
+    return copy;
+}
+
+
+/******************************************************* tree details functions *******************************************************/
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+int AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::get_tree_height()
+{
+    if (root->right == nullptr && root->left == nullptr)
+    {
+        return EMPTY_TREE;
+    }
+    return root->height;
+}
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+int AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::get_num_of_nodes()
+{
+    return num_of_nodes;
+}
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::get_max_node()
+{
+    return max_node;
+}
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::get_min_node()
+{
+    return min_node;
+}
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::refresh_fingers()
+{
+    min_node = get_min_node_by_root(root);
+    max_node = get_max_node_by_root(root);
+}
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::get_max_node_by_root(node_type* given_root)
 {
-    AVLNode<ptr_type>* r;
+    node_type* r;
+    if (given_root == nullptr)
+    {
+        return nullptr;
+    }
+    r = given_root;
+    while(r->right != nullptr)
+    {
+        r = r->right;
+    }
+    return r;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::get_min_node_by_root(node_type* given_root)
+{
+    node_type* r;
     if (given_root == nullptr)
     {
         return nullptr;
@@ -246,556 +1091,1941 @@ AVLNode<ptr_type>* AVLTree<ptr_type, condition>::get_min_node_by_root(AVLNode<pt
     r = given_root;
     while(r->left != nullptr)
     {
-        r = r->left;
+        r = r->left;
+    }
+    return r;
+}
+
+
+/******************************************************* balancing functions *******************************************************/
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::make_LL_rotation(node_type*& r)
+{
+    node_type* A = r->left;
+    r->left = r->left->right;
+    set_parent(r->left, r);
+    A->right = r;
+    A->parent = r->parent;
+    r->parent = A;
+    update_node(r);
+    update_node(A);
+    return A;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::make_RR_rotation(node_type*& r)
+{
+    node_type* A = r->right;
+    r->right = r->right->left;
+    set_parent(r->right, r);
+    A->left = r;
+    A->parent = r->parent;
+    r->parent = A;
+    update_node(r);
+    update_node(A);
+    return A;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::make_RL_rotation(node_type*& r)
+{
+    r->right = make_LL_rotation(r->right);
+    update_node(r);
+    return make_RR_rotation(r);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::make_LR_rotation(node_type*& r)
+{
+    r->left = make_RR_rotation(r->left);
+    update_node(r);
+    return make_LL_rotation(r);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::balance_tree(node_type*& r)
+{
+    int bf = get_bf(r);
+    if (bf == UNBALANCED_POSITIVE_BF)
+    {
+        if (get_bf(r->left) >= 0)
+        {
+            count([](auto& counters) { counters.count_rotation(AVLRotation::LL); });
+            r = make_LL_rotation(r);
+            return r;
+        }
+        else
+        {
+            count([](auto& counters) { counters.count_rotation(AVLRotation::LR); });
+            r = make_LR_rotation(r);
+            return r;
+        }
+    }
+    if (bf == UNBALANCED_NEGATIVE_BF)
+    {
+        if (get_bf(r->right) <= 0)
+        {
+            count([](auto& counters) { counters.count_rotation(AVLRotation::RR); });
+            r = make_RR_rotation(r);
+            return r;
+        }
+        else
+        {
+            count([](auto& counters) { counters.count_rotation(AVLRotation::RL); });
+            r = make_RL_rotation(r);
+            return r;
+        }
+    }
+    return r;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+int AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::get_bf(node_type*& r)
+{
+    if (r->left == nullptr && r->right != nullptr)
+    {
+        return (0 - 1 - r->right->height);
+    }
+    if (r->left != nullptr && r->right == nullptr)
+    {
+        return (r->left->height + 1);
+    }
+    if (r->left != nullptr && r->right != nullptr)
+    {
+        return (r->left->height - r->right->height);
+    }
+    return 0;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::update_height(node_type*& r)
+{
+    if (r->left == nullptr && r->right != nullptr)
+    {
+        r->height = 1 + r->right->height;
+    }
+    if (r->left != nullptr && r->right == nullptr)
+    {
+        r->height = 1 + r->left->height;
+    }
+    if (r->left != nullptr && r->right != nullptr)
+    {
+        if (r->left->height > r->right->height)
+        {
+            r->height = r->left->height + 1;
+        }
+        else
+        {
+            r->height = r->right->height + 1;
+        }
+    }
+    if (r->left == nullptr && r->right == nullptr)
+    {
+        r->height = 0;
+    }
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::update_node(node_type*& r)
+{
+    update_height(r);
+    r->size = 1 + get_size(r->left) + get_size(r->right);
+    update_summary(r);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+int AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::get_size(node_type* r)
+{
+    if (r == nullptr)
+    {
+        return 0;
+    }
+    return r->size;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::set_parent(node_type* child, node_type* father)
+{
+    if (child != nullptr)
+    {
+        child->parent = father;
+    }
+}
+
+
+/******************************************************* insert functions *******************************************************/
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::insert(ptr_type* data)
+{
+    return insert_node(data);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+template <class... Args>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::emplace(Args&&... args)
+{
+    static_assert(owns_data, "emplace needs a tree that owns its objects (see AVLValueTree)");
+    node_type* r = get_node_allocator().allocate(std::in_place, std::forward<Args>(args)...);
+    count([](auto& counters) { counters.count_allocations(1); });
+    prepare_node(r);
+    node_type* father = nullptr;
+    Comparison side = Comparison::EQUAL;
+    if (!find_place(r->get_data(), father, side))
+    {
+        node_allocator->deallocate(r);
+        return nullptr;
+    }
+    return link_new_node(father, r, side);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+template <bool owning, std::enable_if_t<owning, int>>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::insert(ptr_type&& value)
+{
+    return emplace(std::move(value));
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::insert(node_handle&& handle)
+{
+    if (handle.empty())
+    {
+        return nullptr;
+    }
+    if (handle.node_allocator != node_allocator)
+    {
+        // the node can't be freed by this tree's allocator - move it into a node of this tree
+        node_type* moved = get_node_allocator().allocate(std::move(*handle.node));
+        count([](auto& counters) { counters.count_allocations(1); });
+        handle.reset();
+        handle.node_allocator = node_allocator;
+        handle.node = moved;
+    }
+    node_type* father = nullptr;
+    Comparison side = Comparison::EQUAL;
+    if (!find_place(handle.node->get_data(), father, side))
+    {
+        return nullptr;
+    }
+    node_type* inserted = handle.node;
+    handle.node = nullptr;
+    handle.node_allocator.reset();
+    return link_new_node(father, inserted, side);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::insert_node(ptr_type* data, node_type* start, Comparison side, int depth)
+{
+    if (!find_place(data, start, side, depth))
+    {
+        return nullptr;
+    }
+    return link_new_node(start, new_node(data), side);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+bool AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::find_place(ptr_type* data, node_type*& father, Comparison& side, int depth)
+{
+    node_type* r = (father == nullptr) ? root : (side == Comparison::LESS_THAN ? father->left : father->right);
+    Comparison result = side;
+    while (r != nullptr)
+    {
+        depth++;
+        result = compare(data, r);
+        if (result == Comparison::EQUAL)
+        {
+            break;
+        }
+        father = r;
+        r = (result == Comparison::LESS_THAN) ? r->left : r->right;
+    }
+    count([depth](auto& counters) { counters.count_descent(AVLDescent::INSERT, depth); });
+    side = result;
+    return r == nullptr;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::insert_hint(node_type* hint, ptr_type* data)
+{
+    if (hint == nullptr)
+    {
+        hint = max_node;
+    }
+    if (hint == nullptr)
+    {
+        return link_new_node(nullptr, new_node(data), Comparison::EQUAL);
+    }
+    // the nodes compared on the way (the hint and the ancestors climbed to) make the depth of the insert's descent
+    int depth = 1;
+    Comparison side = compare(data, hint);
+    if (side == Comparison::EQUAL)
+    {
+        count([](auto& counters) { counters.count_descent(AVLDescent::INSERT, 1); });
+        return nullptr;
+    }
+    if ((hint == max_node && side == Comparison::GREATER_THAN) || (hint == min_node && side == Comparison::LESS_THAN))
+    {
+        count([](auto& counters) { counters.count_descent(AVLDescent::INSERT, 1); });
+        return link_new_node(hint, new_node(data), side);
+    }
+    // climbs while the subtree of 'start' can't hold data - only ancestors on the side of data are compared
+    node_type* start = hint;
+    node_type* r = hint;
+    while (r->parent != nullptr)
+    {
+        node_type* father = r->parent;
+        if ((father->left == r) == (side == Comparison::GREATER_THAN))
+        {
+            depth++;
+            Comparison result = compare(data, father);
+            if (result == Comparison::EQUAL)
+            {
+                count([depth](auto& counters) { counters.count_descent(AVLDescent::INSERT, depth); });
+                return nullptr;
+            }
+            if (result != side)
+            {
+                break;
+            }
+            start = father;
+        }
+        r = father;
+    }
+    return insert_node(data, start, side, depth);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::link_new_node(node_type* father, node_type* new_junction, Comparison side)
+{
+    new_junction->parent = father;
+    if (father == nullptr)
+    {
+        root = new_junction;
+        min_node = new_junction;
+        max_node = new_junction;
+    }
+    else if (side == Comparison::LESS_THAN)
+    {
+        father->left = new_junction;
+        if (father == min_node)
+        {
+            min_node = new_junction;
+        }
+    }
+    else
+    {
+        father->right = new_junction;
+        if (father == max_node)
+        {
+            max_node = new_junction;
+        }
+    }
+    num_of_nodes++;
+    retrace(father);
+    return new_junction;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::retrace(node_type* r)
+{
+    while (r != nullptr)
+    {
+        count([](auto& counters) { counters.count_retrace_step(); });
+        int old_height = r->height;
+        node_type* father = r->parent;
+        node_type* old_r = r;
+        update_node(r);
+        balance_tree(r);
+        if (r != old_r)
+        {
+            replace_child(father, old_r, r);
+        }
+        if (r->height == old_height)
+        {
+            // the subtree kept its height - ancestors only need their sizes fixed
+            update_sizes_to_root(father);
+            return;
+        }
+        r = father;
+    }
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::update_sizes_to_root(node_type* r)
+{
+    while (r != nullptr)
+    {
+        r->size = 1 + get_size(r->left) + get_size(r->right);
+        update_summary(r);
+        r = r->parent;
+    }
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::replace_child(node_type* father, node_type* old_child, node_type* new_child)
+{
+    if (father == nullptr)
+    {
+        root = new_child;
+    }
+    else if (father->left == old_child)
+    {
+        father->left = new_child;
+    }
+    else
+    {
+        father->right = new_child;
+    }
+    set_parent(new_child, father);
+}
+
+
+/******************************************************* comparing functions *******************************************************/
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::new_node(ptr_type* data)
+{
+    count([](auto& counters) { counters.count_allocations(1); });
+    return new_node(data, get_node_allocator());
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::new_node(ptr_type* data, allocator_type& pool)
+{
+    node_type* r = pool.allocate(data);
+    prepare_node(r);
+    return r;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::prepare_node(node_type* r)
+{
+    if constexpr (CACHED_KEYS)
+    {
+        static_assert(std::is_trivially_copyable<key_type>::value, "cached keys must be trivially copyable");
+        r->key = key_extractor()(r->get_data());
+    }
+    if constexpr (AUGMENTED)
+    {
+        static_assert(std::is_trivially_destructible<summary_type>::value, "summaries must be trivially destructible");
+        r->summary = augmentation::summarize(r->get_data());
+    }
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+template <class probe_type>
+Comparison AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::compare(const probe_type& data, node_type* r)
+{
+    if constexpr (CACHED_KEYS)
+    {
+        if constexpr (std::is_convertible<probe_type, const ptr_type*>::value)
+        {
+            return compare(key_extractor()(data), r);
+        }
+        else
+        {
+            count([](auto& counters) { counters.count_comparison(); });
+            if (data < r->key)
+            {
+                return Comparison::LESS_THAN;
+            }
+            if (r->key < data)
+            {
+                return Comparison::GREATER_THAN;
+            }
+            return Comparison::EQUAL;
+        }
+    }
+    else
+    {
+        count([](auto& counters) { counters.count_comparison(); });
+        condition cond;
+        return cond(data, r->get_data());
+    }
+}
+
+
+/******************************************************* batch functions *******************************************************/
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::insert_batch(ptr_type** data, int n, node_type** results)
+{
+    if (n < 1 || data == nullptr)
+    {
+        return;
+    }
+    if (n * BATCH_REBUILD_RATIO >= num_of_nodes)
+    {
+        insert_batch_by_rebuild(data, n, results);
+        return;
+    }
+    root = insert_batch_nodes(take_root_of(*this), data, n, results);
+    num_of_nodes = get_size(root);
+    refresh_fingers();
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::erase_batch(ptr_type** data, int n, bool* results)
+{
+    if (n < 1 || data == nullptr)
+    {
+        return;
+    }
+    if (n * BATCH_REBUILD_RATIO >= num_of_nodes)
+    {
+        erase_batch_by_rebuild(data, n, results);
+        return;
+    }
+    root = erase_batch_nodes(take_root_of(*this), data, n, results);
+    num_of_nodes = get_size(root);
+    refresh_fingers();
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+int AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::batch_lower_bound(ptr_type** data, int n, node_type* r)
+{
+    int low = 0;
+    int high = n;
+    while (low < high)
+    {
+        int mid = low + (high - low) / 2;
+        if (compare(data[mid], r) == Comparison::LESS_THAN)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::insert_batch_nodes(node_type* t, ptr_type** data, int n, node_type** results)
+{
+    if (n == 0)
+    {
+        return t;
+    }
+    if (t == nullptr)
+    {
+        node_type* built = build_tree_from_array(data, 0, n - 1, get_node_allocator(), results);
+        built->parent = nullptr;
+        count([n](auto& counters) { counters.count_allocations(n); });
+        return built;
+    }
+    node_type* l = t->left;
+    node_type* r = t->right;
+    set_parent(l, nullptr);
+    set_parent(r, nullptr);
+    int place = batch_lower_bound(data, n, t);
+    int next = place;
+    if (place < n && compare(data[place], t) == Comparison::EQUAL)
+    {
+        if (results != nullptr)
+        {
+            results[place] = nullptr;
+        }
+        next++;
+    }
+    l = insert_batch_nodes(l, data, place, results);
+    r = insert_batch_nodes(r, data + next, n - next, results == nullptr ? nullptr : results + next);
+    return join_nodes(l, t, r);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::erase_batch_nodes(node_type* t, ptr_type** data, int n, bool* results)
+{
+    if (n == 0)
+    {
+        return t;
+    }
+    if (t == nullptr)
+    {
+        for (int i = 0; results != nullptr && i < n; i++)
+        {
+            results[i] = false;
+        }
+        return nullptr;
+    }
+    node_type* l = t->left;
+    node_type* r = t->right;
+    set_parent(l, nullptr);
+    set_parent(r, nullptr);
+    int place = batch_lower_bound(data, n, t);
+    bool found = place < n && compare(data[place], t) == Comparison::EQUAL;
+    int next = found ? place + 1 : place;
+    l = erase_batch_nodes(l, data, place, results);
+    r = erase_batch_nodes(r, data + next, n - next, results == nullptr ? nullptr : results + next);
+    if (found)
+    {
+        if (results != nullptr)
+        {
+            results[place] = true;
+        }
+        node_allocator->deallocate(t);
+        return join_without_pivot(l, r);
+    }
+    return join_nodes(l, t, r);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::insert_batch_by_rebuild(ptr_type** data, int n, node_type** results)
+{
+    node_type** merged = new node_type*[num_of_nodes + n];
+    int size = 0;
+    int i = 0;
+    node_type* r = get_min_node_by_root(root);
+    while (r != nullptr || i < n)
+    {
+        Comparison result = (r == nullptr) ? Comparison::LESS_THAN : (i == n ? Comparison::GREATER_THAN : compare(data[i], r));
+        if (result == Comparison::GREATER_THAN)
+        {
+            merged[size++] = r;
+            r = get_next_node(r);
+            continue;
+        }
+        if (result == Comparison::EQUAL)
+        {
+            if (results != nullptr)
+            {
+                results[i] = nullptr;
+            }
+            i++;
+            continue;
+        }
+        merged[size] = new_node(data[i]);
+        if (results != nullptr)
+        {
+            results[i] = merged[size];
+        }
+        size++;
+        i++;
+    }
+    root = build_tree_from_nodes(merged, 0, size - 1);
+    set_parent(root, nullptr);
+    num_of_nodes = size;
+    refresh_fingers();
+    delete[] merged;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::erase_batch_by_rebuild(ptr_type** data, int n, bool* results)
+{
+    // kept nodes fill the array from its start and removed nodes from its end - the removed ones are freed only
+    // after the walk, since get_next_node climbs through ancestors that were already passed
+    node_type** kept = new node_type*[num_of_nodes];
+    int size = 0;
+    int removed = num_of_nodes;
+    int i = 0;
+    node_type* r = get_min_node_by_root(root);
+    while (r != nullptr)
+    {
+        while (i < n && compare(data[i], r) == Comparison::LESS_THAN)
+        {
+            if (results != nullptr)
+            {
+                results[i] = false;
+            }
+            i++;
+        }
+        if (i < n && compare(data[i], r) == Comparison::EQUAL)
+        {
+            if (results != nullptr)
+            {
+                results[i] = true;
+            }
+            i++;
+            kept[--removed] = r;
+        }
+        else
+        {
+            kept[size++] = r;
+        }
+        r = get_next_node(r);
+    }
+    for (; results != nullptr && i < n; i++)
+    {
+        results[i] = false;
+    }
+    for (int j = removed; j < num_of_nodes; j++)
+    {
+        node_allocator->deallocate(kept[j]);
+    }
+    root = build_tree_from_nodes(kept, 0, size - 1);
+    set_parent(root, nullptr);
+    num_of_nodes = size;
+    refresh_fingers();
+    delete[] kept;
+}
+
+
+/******************************************************* search functions *******************************************************/
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::search(ptr_type* data)
+{
+    return search_node(data);
+}
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+template <class probe_type>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::search_node(const probe_type& data, AVLDescent operation)
+{
+    node_type* r = root;
+    int depth = 0;
+    while (r != nullptr)
+    {
+        depth++;
+        Comparison result = compare(data, r);
+        if (result == Comparison::EQUAL)
+        {
+            break;
+        }
+        r = (result == Comparison::LESS_THAN) ? r->left : r->right;
+    }
+    count([operation, depth](auto& counters) { counters.count_descent(operation, depth); });
+    return r;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+template <class count_function>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::count(count_function function)
+{
+    if constexpr (INSTRUMENTED)
+    {
+        function(counters);
+    }
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+template <class probe_type>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::search_batch(const probe_type* keys, int n, node_type** out)
+{
+    check_probe_type<probe_type>();
+    node_type* cursor[SEARCH_BATCH_GROUP];
+    int active[SEARCH_BATCH_GROUP];
+    for (int group = 0; group < n; group += SEARCH_BATCH_GROUP)
+    {
+        int num_of_active = 0;
+        for (int i = group; i < n && i < group + SEARCH_BATCH_GROUP; i++)
+        {
+            cursor[i - group] = root;
+            active[num_of_active++] = i - group;
+        }
+        while (num_of_active > 0)
+        {
+            int still_active = 0;
+            for (int j = 0; j < num_of_active; j++)
+            {
+                int i = active[j];
+                node_type* r = cursor[i];
+                if (r == nullptr)
+                {
+                    out[group + i] = nullptr;
+                    continue;
+                }
+                Comparison result = compare(keys[group + i], r);
+                if (result == Comparison::EQUAL)
+                {
+                    out[group + i] = r;
+                    continue;
+                }
+                r = (result == Comparison::LESS_THAN) ? r->left : r->right;
+                if (r != nullptr)
+                {
+                    __builtin_prefetch(r);
+                }
+                cursor[i] = r;
+                active[still_active++] = i;
+            }
+            num_of_active = still_active;
+        }
+    }
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::get_closest_left(ptr_type* data)
+{
+    node_type* r = root;
+    node_type* last_left_father = nullptr;    // last node the descent went right from
+    int depth = 0;
+    while (r != nullptr)
+    {
+        depth++;
+        Comparison result = compare(data, r);
+        if (result == Comparison::EQUAL)
+        {
+            count([depth](auto& counters) { counters.count_descent(AVLDescent::SEARCH, depth); });
+            if (r->left != nullptr)
+            {
+                return get_max_node_by_root(r->left);
+            }
+            return last_left_father;
+        }
+        if (result == Comparison::LESS_THAN)
+        {
+            r = r->left;
+        }
+        else
+        {
+            last_left_father = r;
+            r = r->right;
+        }
+    }
+    count([depth](auto& counters) { counters.count_descent(AVLDescent::SEARCH, depth); });
+    return nullptr;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::get_closest_right(ptr_type* data)
+{
+    node_type* r = root;
+    node_type* last_right_father = nullptr;   // last node the descent went left from
+    int depth = 0;
+    while (r != nullptr)
+    {
+        depth++;
+        Comparison result = compare(data, r);
+        if (result == Comparison::EQUAL)
+        {
+            count([depth](auto& counters) { counters.count_descent(AVLDescent::SEARCH, depth); });
+            if (r->right != nullptr)
+            {
+                return get_min_node_by_root(r->right);
+            }
+            return last_right_father;
+        }
+        if (result == Comparison::GREATER_THAN)
+        {
+            r = r->right;
+        }
+        else
+        {
+            last_right_father = r;
+            r = r->left;
+        }
+    }
+    count([depth](auto& counters) { counters.count_descent(AVLDescent::SEARCH, depth); });
+    return nullptr;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::get_prev_node(node_type* node)
+{
+    if (node == nullptr)
+    {
+        return nullptr;
+    }
+    if (node->left != nullptr)
+    {
+        return get_max_node_by_root(node->left);
+    }
+    while (node->parent != nullptr && node->parent->left == node)
+    {
+        node = node->parent;
+    }
+    return node->parent;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::get_next_node(node_type* node)
+{
+    if (node == nullptr)
+    {
+        return nullptr;
+    }
+    if (node->right != nullptr)
+    {
+        return get_min_node_by_root(node->right);
+    }
+    while (node->parent != nullptr && node->parent->right == node)
+    {
+        node = node->parent;
+    }
+    return node->parent;
+}
+
+
+/******************************************************* order statistics functions *******************************************************/
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::select(int k)
+{
+    if (k < 0 || k >= num_of_nodes)
+    {
+        return nullptr;
+    }
+    node_type* r = root;
+    while (r != nullptr)
+    {
+        int left_size = get_size(r->left);
+        if (k == left_size)
+        {
+            return r;
+        }
+        if (k < left_size)
+        {
+            r = r->left;
+        }
+        else
+        {
+            k -= left_size + 1;
+            r = r->right;
+        }
+    }
+    return nullptr;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+int AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::count_smaller(ptr_type* data, bool inclusive)
+{
+    node_type* r = root;
+    int smaller = 0;
+    int depth = 0;
+    while (r != nullptr)
+    {
+        depth++;
+        Comparison result = compare(data, r);
+        if (result == Comparison::GREATER_THAN || (result == Comparison::EQUAL && inclusive))
+        {
+            smaller += get_size(r->left) + 1;
+            r = r->right;
+        }
+        else if (result == Comparison::EQUAL)
+        {
+            smaller += get_size(r->left);
+            break;
+        }
+        else
+        {
+            r = r->left;
+        }
+    }
+    count([depth](auto& counters) { counters.count_descent(AVLDescent::SEARCH, depth); });
+    return smaller;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+int AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::rank(ptr_type* data)
+{
+    return count_smaller(data, false);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+int AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::count_between(ptr_type* lo, ptr_type* hi)
+{
+    // both descents compare through compare(), so cached keys and the instrumentation apply - lo > hi counts
+    // at most as many nodes up to hi as nodes below lo
+    int count = count_smaller(hi, true) - count_smaller(lo, false);
+    return count > 0 ? count : 0;
+}
+
+
+/******************************************************* augmentation functions *******************************************************/
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::update_summary(node_type* r)
+{
+    if constexpr (AUGMENTED)
+    {
+        r->summary = augmentation::combine(augmentation::combine(get_summary(r->left), augmentation::summarize(r->get_data())),
+                                           get_summary(r->right));
+    }
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::summary_type AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::get_summary(node_type* r)
+{
+    if (r == nullptr)
+    {
+        return augmentation::identity();
+    }
+    return r->summary;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::summary_type AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::aggregate(ptr_type* lo, ptr_type* hi)
+{
+    static_assert(AUGMENTED, "aggregate needs an augmentation (see AVLAugmentedSummary)");
+    // descend to the top node in the range, below it the range is a suffix of its left subtree and a prefix of its right
+    node_type* r = root;
+    while (r != nullptr)
+    {
+        if (compare(lo, r) == Comparison::GREATER_THAN)
+        {
+            r = r->right;
+        }
+        else if (compare(hi, r) == Comparison::LESS_THAN)
+        {
+            r = r->left;
+        }
+        else
+        {
+            return augmentation::combine(augmentation::combine(aggregate_from(r->left, lo), augmentation::summarize(r->get_data())),
+                                         aggregate_to(r->right, hi));
+        }
+    }
+    return augmentation::identity();
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::summary_type AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::aggregate_from(node_type* r, ptr_type* lo)
+{
+    summary_type result = augmentation::identity();
+    while (r != nullptr)
+    {
+        if (compare(lo, r) == Comparison::GREATER_THAN)
+        {
+            r = r->right;
+        }
+        else
+        {
+            // r and its right subtree are in, and come after everything still to be found on the left
+            result = augmentation::combine(augmentation::combine(augmentation::summarize(r->get_data()), get_summary(r->right)), result);
+            r = r->left;
+        }
+    }
+    return result;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::summary_type AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::aggregate_to(node_type* r, ptr_type* hi)
+{
+    summary_type result = augmentation::identity();
+    while (r != nullptr)
+    {
+        if (compare(hi, r) == Comparison::LESS_THAN)
+        {
+            r = r->left;
+        }
+        else
+        {
+            result = augmentation::combine(result, augmentation::combine(get_summary(r->left), augmentation::summarize(r->get_data())));
+            r = r->right;
+        }
+    }
+    return result;
+}
+
+
+/******************************************************* travel functions *******************************************************/
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+ptr_type** AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::inorder()
+{
+    if (root == nullptr)
+    {
+        return nullptr;
+    }
+    ptr_type** elements_by_order = new ptr_type*[num_of_nodes];
+    export_inorder(elements_by_order);
+    return elements_by_order;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+int AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::export_inorder(ptr_type** out)
+{
+    export_in_parallel(root, out, num_of_threads);
+    return num_of_nodes;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::export_in_parallel(node_type* r, ptr_type** out, int threads)
+{
+    if (threads < 2 || get_size(r) < AVL_PARALLEL_CUTOFF)
+    {
+        int index = 0;
+        inorder_travel(r, out, index);
+        return;
+    }
+    int place = get_size(r->left);
+    out[place] = r->get_data();
+    avl_run_in_parallel([&]() { export_in_parallel(r->right, out + place + 1, threads - threads / 2); },
+                        [&]() { export_in_parallel(r->left, out, threads / 2); });
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::inorder_travel(node_type* r, ptr_type**& elements_by_order, int& index)
+{
+    if (r == nullptr)
+    {
+        return;
+    }
+    inorder_travel(r->left, elements_by_order, index);
+    elements_by_order[index] = r->get_data();
+    index++;
+    inorder_travel(r->right, elements_by_order, index);
+}
+
+
+/******************************************************* key lookup functions *******************************************************/
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+template <class probe_type>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::check_probe_type()
+{
+    static_assert(AVLIsTransparent<condition>::value || CACHED_KEYS || std::is_convertible<probe_type, ptr_type*>::value,
+                  "lookup by key needs a transparent condition (declare 'using is_transparent = void;') or a key extractor");
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+template <class probe_type>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::find(const probe_type& key)
+{
+    check_probe_type<probe_type>();
+    return search_node(key);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+template <class probe_type>
+bool AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::erase(const probe_type& key)
+{
+    check_probe_type<probe_type>();
+    return remove_node(key, false);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+template <class probe_type>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::iterator AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::lower_bound(const probe_type& key)
+{
+    check_probe_type<probe_type>();
+    return iterator(this, lower_bound_node(key));
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+template <class probe_type>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::iterator AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::upper_bound(const probe_type& key)
+{
+    check_probe_type<probe_type>();
+    return iterator(this, upper_bound_node(key));
+}
+
+
+/******************************************************* iterator functions *******************************************************/
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::iterator AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::begin()
+{
+    return iterator(this, min_node);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::iterator AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::end()
+{
+    return iterator(this, nullptr);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::reverse_iterator AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::rbegin()
+{
+    return reverse_iterator(end());
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::reverse_iterator AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::rend()
+{
+    return reverse_iterator(begin());
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::iterator AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::lower_bound(ptr_type* data)
+{
+    return iterator(this, lower_bound_node(data));
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::iterator AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::upper_bound(ptr_type* data)
+{
+    return iterator(this, upper_bound_node(data));
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+template <class probe_type>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::lower_bound_node(const probe_type& data)
+{
+    node_type* r = root;
+    node_type* bound = nullptr;
+    int depth = 0;
+    while (r != nullptr)
+    {
+        depth++;
+        if (compare(data, r) == Comparison::GREATER_THAN)
+        {
+            r = r->right;
+        }
+        else
+        {
+            bound = r;
+            r = r->left;
+        }
+    }
+    count([depth](auto& counters) { counters.count_descent(AVLDescent::SEARCH, depth); });
+    return bound;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+template <class probe_type>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::upper_bound_node(const probe_type& data)
+{
+    node_type* r = root;
+    node_type* bound = nullptr;
+    int depth = 0;
+    while (r != nullptr)
+    {
+        depth++;
+        if (compare(data, r) == Comparison::LESS_THAN)
+        {
+            bound = r;
+            r = r->left;
+        }
+        else
+        {
+            r = r->right;
+        }
+    }
+    count([depth](auto& counters) { counters.count_descent(AVLDescent::SEARCH, depth); });
+    return bound;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+template <class visitor_type>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::for_each_in_range(ptr_type* lo, ptr_type* hi, visitor_type visitor)
+{
+    node_type* r = lower_bound_node(lo);
+    while (r != nullptr && compare(hi, r) != Comparison::LESS_THAN)
+    {
+        visitor(r->get_data());
+        r = get_next_node(r);
+    }
+}
+
+
+/******************************************************* removing functions *******************************************************/
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+bool AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::remove(ptr_type* data)
+{
+    return remove_node(data, false);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+bool AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::remove_and_erase(ptr_type* data)
+{
+    static_assert(!owns_data, "remove_and_erase deletes pointed to data - a tree that owns its objects destroys them in remove");
+    return remove_node(data, true);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::find_successor(node_type* b)
+{
+    b = b->left;
+    while(b->right != nullptr)
+    {
+        b = b->right;
+    }
+    return b;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+template <class probe_type>
+bool AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::remove_node(const probe_type& data, bool erase)
+{
+    node_type* r = search_node(data, AVLDescent::REMOVE);
+    if (r == nullptr)
+    {
+        return false;
+    }
+    unlink_node(r);
+    if constexpr (!owns_data)
+    {
+        if (erase)
+        {
+            delete r->data;
+        }
+    }
+    node_allocator->deallocate(r);
+    return true;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::unlink_node(node_type* r)
+{
+    if (r == min_node)
+    {
+        min_node = get_next_node(r);
+    }
+    if (r == max_node)
+    {
+        max_node = get_prev_node(r);
+    }
+    node_type* retrace_from;
+    if (r->right != nullptr && r->left != nullptr) // junction has both children - the successor node takes its place
+    {
+        node_type* successor = find_successor(r);
+        if (successor->parent == r)
+        {
+            retrace_from = successor;
+        }
+        else
+        {
+            retrace_from = successor->parent;
+            successor->parent->right = successor->left;
+            set_parent(successor->left, successor->parent);
+            successor->left = r->left;
+            successor->left->parent = successor;
+        }
+        successor->right = r->right;
+        successor->right->parent = successor;
+        successor->height = r->height;
+        replace_child(r->parent, r, successor);
+    }
+    else // junction is leaf or has one child
+    {
+        node_type* child = (r->left != nullptr) ? r->left : r->right;
+        retrace_from = r->parent;
+        replace_child(r->parent, r, child);
+    }
+    num_of_nodes--;
+    retrace(retrace_from);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+template <class probe_type>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_handle AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::extract(const probe_type& key)
+{
+    check_probe_type<probe_type>();
+    node_type* r = search_node(key, AVLDescent::REMOVE);
+    if (r == nullptr)
+    {
+        return node_handle();
+    }
+    unlink_node(r);
+    r->left = nullptr;
+    r->right = nullptr;
+    r->parent = nullptr;
+    r->height = 0;
+    r->size = 1;
+    prepare_node(r);
+    return node_handle(node_allocator, r);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::erase_data_in_node(node_type*& r)
+{
+    if (r == nullptr)
+    {
+        return;
+    }
+    erase_data_in_node(r->left);
+    erase_data_in_node(r->right);
+    r->height = 0;  // for elegance
+    delete r->data;
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::erase_data()
+{
+    static_assert(!owns_data, "erase_data deletes pointed to data - a tree that owns its objects destroys them with its nodes");
+    erase_data_in_parallel(root, num_of_threads);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::erase_data_in_parallel(node_type* r, int threads)
+{
+    if (threads < 2 || get_size(r) < AVL_PARALLEL_CUTOFF)
+    {
+        erase_data_in_node(r);
+        return;
     }
-    return r;
+    avl_run_in_parallel([&]() { erase_data_in_parallel(r->right, threads - threads / 2); },
+                        [&]() { erase_data_in_parallel(r->left, threads / 2); });
+    r->height = 0;
+    delete r->data;
 }
 
 
-/******************************************************* balancing functions *******************************************************/
+/******************************************************* split and join functions *******************************************************/
 
 
-template <class ptr_type, class condition>
-AVLNode<ptr_type>* AVLTree<ptr_type, condition>::make_LL_rotation(AVLNode<ptr_type>*& r)
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+int AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::get_height(node_type* r)
 {
-    AVLNode<ptr_type>* A = r->left;
-    r->left = r->left->right;
-    A->right = r;
-    update_height(r);
-    update_height(A);
-    return A;
+    if (r == nullptr)
+    {
+        return EMPTY_TREE;
+    }
+    return r->height;
 }
 
 
-template <class ptr_type, class condition>
-AVLNode<ptr_type>* AVLTree<ptr_type, condition>::make_RR_rotation(AVLNode<ptr_type>*& r)
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::link_node(node_type* l, node_type* k, node_type* r)
 {
-    AVLNode<ptr_type>* A = r->right;
-    r->right = r->right->left;
-    A->left = r;
-    update_height(r);
-    update_height(A);
-    return A;
+    k->left = l;
+    k->right = r;
+    set_parent(l, k);
+    set_parent(r, k);
+    update_node(k);
+    return k;
 }
 
 
-template <class ptr_type, class condition>
-AVLNode<ptr_type>* AVLTree<ptr_type, condition>::make_RL_rotation(AVLNode<ptr_type>*& r)
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::join_nodes(node_type* l, node_type* k, node_type* r)
 {
-    r->right = make_LL_rotation(r->right);
-    update_height(r);
-    return make_RR_rotation(r);
+    node_type* joined;
+    if (get_height(l) > get_height(r) + 1)
+    {
+        joined = join_right(l, k, r);
+    }
+    else if (get_height(r) > get_height(l) + 1)
+    {
+        joined = join_left(l, k, r);
+    }
+    else
+    {
+        joined = link_node(l, k, r);
+    }
+    joined->parent = nullptr;
+    return joined;
 }
 
 
-template <class ptr_type, class condition>
-AVLNode<ptr_type>* AVLTree<ptr_type, condition>::make_LR_rotation(AVLNode<ptr_type>*& r)
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::join_right(node_type* l, node_type* k, node_type* r)
 {
-    r->left = make_RR_rotation(r->left);
-    update_height(r);
-    return make_LL_rotation(r);
+    node_type* c = l->right;
+    if (get_height(c) <= get_height(r) + 1)
+    {
+        l->right = link_node(c, k, r);
+    }
+    else
+    {
+        l->right = join_right(c, k, r);
+    }
+    l->right->parent = l;
+    update_node(l);
+    return balance_tree(l);
 }
 
 
-template <class ptr_type, class condition>
-AVLNode<ptr_type>* AVLTree<ptr_type, condition>::balance_tree(AVLNode<ptr_type>*& r)
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::join_left(node_type* l, node_type* k, node_type* r)
 {
-    int bf = get_bf(r);
-    if (bf == UNBALANCED_POSITIVE_BF)
+    node_type* c = r->left;
+    if (get_height(c) <= get_height(l) + 1)
     {
-        if (get_bf(r->left) >= 0)
-        {
-            r = make_LL_rotation(r);
-            return r;
-        }
-        else
-        {
-            r = make_LR_rotation(r);
-            return r;
-        }
+        r->left = link_node(l, k, c);
     }
-    if (bf == UNBALANCED_NEGATIVE_BF)
+    else
     {
-        if (get_bf(r->right) <= 0)
-        {
-            r = make_RR_rotation(r);
-            return r;
-        }
-        else
-        {
-            r = make_RL_rotation(r);
-            return r;
-        }
+        r->left = join_left(l, k, c);
     }
-    return r;
+    r->left->parent = r;
+    update_node(r);
+    return balance_tree(r);
 }
 
 
-template <class ptr_type, class condition>
-int AVLTree<ptr_type, condition>::get_bf(AVLNode<ptr_type>*& r)
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::split_last(node_type* t, node_type*& last)
 {
-    if (r->left == nullptr && r->right != nullptr)
-    {
-        return (0 - 1 - r->right->height);
-    }
-    if (r->left != nullptr && r->right == nullptr)
+    if (t->right == nullptr)
     {
-        return (r->left->height + 1);
+        last = t;
+        set_parent(t->left, nullptr);
+        return t->left;
     }
-    if (r->left != nullptr && r->right != nullptr)
+    node_type* l = t->left;
+    set_parent(l, nullptr);
+    node_type* rest = split_last(t->right, last);
+    return join_nodes(l, t, rest);
+}
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::join_without_pivot(node_type* l, node_type* r)
+{
+    if (l == nullptr)
     {
-        return (r->left->height - r->right->height);
+        return r;
     }
-    return 0;
+    node_type* last;
+    l = split_last(l, last);
+    return join_nodes(l, last, r);
 }
 
 
-template <class ptr_type, class condition>
-void AVLTree<ptr_type, condition>::update_height(AVLNode<ptr_type>*& r)
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+template <class probe_type>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::split_nodes(node_type* t, const probe_type& data, node_type*& smaller, node_type*& equal, node_type*& bigger)
 {
-    if (r->left == nullptr && r->right != nullptr)
+    if (t == nullptr)
     {
-        r->height = 1 + r->right->height;
+        smaller = nullptr;
+        equal = nullptr;
+        bigger = nullptr;
+        return;
     }
-    if (r->left != nullptr && r->right == nullptr)
+    node_type* l = t->left;
+    node_type* r = t->right;
+    set_parent(l, nullptr);
+    set_parent(r, nullptr);
+    Comparison result = compare(data, t);
+    if (result == Comparison::EQUAL)
     {
-        r->height = 1 + r->left->height;
+        smaller = l;
+        equal = link_node(nullptr, t, nullptr);
+        equal->parent = nullptr;
+        bigger = r;
     }
-    if (r->left != nullptr && r->right != nullptr)
+    else if (result == Comparison::LESS_THAN)
     {
-        if (r->left->height > r->right->height)
-        {
-            r->height = r->left->height + 1;
-        }
-        else
-        {
-            r->height = r->right->height + 1;
-        }
+        node_type* bigger_in_l;
+        split_nodes(l, data, smaller, equal, bigger_in_l);
+        bigger = join_nodes(bigger_in_l, t, r);
     }
-    if (r->left == nullptr && r->right == nullptr)
+    else
     {
-        r->height = 0;
+        node_type* smaller_in_r;
+        split_nodes(r, data, smaller_in_r, equal, bigger);
+        smaller = join_nodes(l, t, smaller_in_r);
     }
 }
 
 
-/******************************************************* insert functions *******************************************************/
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+template <class probe_type>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::split(const probe_type& data, AVLTree& smaller, AVLTree& bigger)
+{
+    check_probe_type<probe_type>();
+    // this tree may be smaller or bigger - its nodes are taken before the nodes the outputs had are freed
+    node_type* t = take_root_of(*this);
+    std::shared_ptr<allocator_type> nodes_allocator = node_allocator;
+    if (&smaller != this)
+    {
+        smaller.free_all_nodes();
+    }
+    if (&bigger != this)
+    {
+        bigger.free_all_nodes();
+    }
+    smaller.node_allocator = nodes_allocator;
+    bigger.node_allocator = nodes_allocator;
+    node_type* equal;
+    split_nodes(t, data, smaller.root, equal, bigger.root);
+    if (equal != nullptr)
+    {
+        equal->parent = nullptr;
+        bigger.root = join_nodes(nullptr, equal, bigger.root);
+    }
+    smaller.num_of_nodes = get_size(smaller.root);
+    bigger.num_of_nodes = get_size(bigger.root);
+    smaller.refresh_fingers();
+    bigger.refresh_fingers();
+}
 
 
-template <class ptr_type, class condition>
-AVLNode<ptr_type>* AVLTree<ptr_type, condition>::insert(ptr_type* data)
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::hand_slabs_to(allocator_type& keeper)
 {
-    AVLNode<ptr_type>* r_new_junction = nullptr;
-    root = insert_node(root, data, r_new_junction);
-    return r_new_junction;
+    if (node_allocator == nullptr)
+    {
+        return;
+    }
+    keeper.keep_slabs_of(*node_allocator);
+    node_allocator = std::make_shared<allocator_type>();
 }
 
 
-template <class ptr_type, class condition>
-AVLNode<ptr_type>* AVLTree<ptr_type, condition>::insert_node(AVLNode<ptr_type>*& r, ptr_type* data, AVLNode<ptr_type>*& r_new_junction)
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::join(AVLTree& smaller, ptr_type* pivot, AVLTree& bigger)
 {
-    if (r == nullptr)
+    if (this != &smaller && this != &bigger)
     {
-        r = new AVLNode<ptr_type>(data);
-        r_new_junction = r;
-        num_of_nodes++;
-        return r;
+        free_all_nodes();
+    }
+    adopt_nodes_of(smaller);
+    adopt_nodes_of(bigger);
+    node_type* l = take_root_of(smaller);
+    node_type* r = take_root_of(bigger);
+    if (pivot != nullptr)
+    {
+        root = join_nodes(l, new_node(pivot), r);
     }
     else
     {
-        condition cond;
-        Comparison result = cond(data, r->data);
-        if (result == Comparison::LESS_THAN)
-        {
-            r->left = insert_node(r->left, data, r_new_junction);
-            update_height(r);
-            return balance_tree(r);
-        }
-        if (result == Comparison::GREATER_THAN)
-        {
-            r->right = insert_node(r->right, data, r_new_junction);
-            update_height(r);
-            return balance_tree(r);
-        }
-        if (result == Comparison::EQUAL)
-        {
-            r_new_junction = nullptr;
-            return r;
-        }
-        return r;
+        root = join_without_pivot(l, r);
     }
+    num_of_nodes = get_size(root);
+    refresh_fingers();
 }
 
 
-/******************************************************* search functions *******************************************************/
-
-
-template <class ptr_type, class condition>
-AVLNode<ptr_type>* AVLTree<ptr_type, condition>::search(ptr_type* data)
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::take_root_of(AVLTree& other)
 {
-    AVLNode<ptr_type>* requested = nullptr;
-    return search_node(root, data, requested);
+    node_type* r = other.root;
+    other.root = nullptr;
+    other.min_node = nullptr;
+    other.max_node = nullptr;
+    other.num_of_nodes = 0;
+    return r;
 }
 
-template <class ptr_type, class condition>
-AVLNode<ptr_type>* AVLTree<ptr_type, condition>::search_node(AVLNode<ptr_type> *&r, ptr_type* data, AVLNode<ptr_type> *&requested)
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::adopt_nodes_of(AVLTree& other)
 {
-    if (r == nullptr)
+    get_node_allocator();
+    if (other.node_allocator == node_allocator || other.node_allocator == nullptr)
     {
-        return nullptr;
+        return;
+    }
+    if (other.node_allocator.use_count() == 1)
+    {
+        node_allocator->absorb(*other.node_allocator);
+        other.node_allocator = node_allocator;
+    }
+    else if (node_allocator.use_count() == 1)
+    {
+        // the allocator of other is shared with more trees - this tree moves its nodes there and shares it too
+        other.node_allocator->absorb(*node_allocator);
+        node_allocator = other.node_allocator;
     }
     else
     {
-        condition cond;
-        AVLNode<ptr_type>* temp;
-        Comparison result = cond(data, r->data);
-        if (result == Comparison::LESS_THAN)
-        {
-            temp = search_node(r->left, data, requested);
-            if (temp != nullptr)
-            {
-                return temp;
-            }
-            return nullptr;
-        }
-        if (result == Comparison::GREATER_THAN)
-        {
-            temp = search_node(r->right, data, requested);
-            if (temp != nullptr)
-            {
-                return temp;
-            }
-            return nullptr;
-        }
-        if (result == Comparison::EQUAL)
-        {
-            requested = r;
-            return r;
-        }
+        // both allocators are shared with more trees, so neither memory can move - copy the nodes of other in O(n)
+        other.root = reallocate_nodes(other.root, *other.node_allocator);
+        set_parent(other.root, nullptr);
+        other.node_allocator = node_allocator;
     }
-    return nullptr;
 }
 
 
-template <class ptr_type, class condition>
-AVLNode<ptr_type>* AVLTree<ptr_type, condition>::get_closest_left(ptr_type* data)
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::reallocate_nodes(node_type* r, allocator_type& from)
 {
-    AVLNode<ptr_type>* requested = search(data);
-    if (requested == nullptr)
+    if (r == nullptr)
     {
         return nullptr;
     }
-    if (requested->left == nullptr)
+    node_type* copy = node_allocator->allocate(std::move(*r));
+    count([](auto& counters) { counters.count_allocations(1); });
+    copy->left = reallocate_nodes(r->left, from);
+    copy->right = reallocate_nodes(r->right, from);
+    set_parent(copy->left, copy);
+    set_parent(copy->right, copy);
+    from.deallocate(r);
+    return copy;
+}
+
+
+/******************************************************* set operation functions *******************************************************/
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+auto AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::get_probe(node_type* r)
+{
+    if constexpr (CACHED_KEYS)
     {
-        condition cond;
-        AVLNode<ptr_type>* father = get_father(root, requested->data);
-        while (father != nullptr)
-        {
-            Comparison result_cond = cond(data, father->data);
-            if (result_cond == Comparison::GREATER_THAN)
-            {
-                return father;
-            }
-            if (result_cond == Comparison::LESS_THAN)
-            {
-                father = get_father(root, father->data);
-            }
-        }
-        return nullptr;
+        return r->key;
     }
-    if (requested->left != nullptr)
+    else
     {
-        return get_max_node_by_root(requested->left);
+        return r->get_data();
     }
-    return nullptr;
 }
 
 
-template <class ptr_type, class condition>
-AVLNode<ptr_type>* AVLTree<ptr_type, condition>::get_closest_right(ptr_type* data)
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::unite_nodes(node_type* t1, node_type* t2)
 {
-    AVLNode<ptr_type>* requested = search(data);
-    if (requested == nullptr)
+    if (t1 == nullptr)
     {
-        return nullptr;
+        return t2;
     }
-    if (requested->right == nullptr)
+    if (t2 == nullptr)
     {
-        condition cond;
-        AVLNode<ptr_type>* father = get_father(root, requested->data);
-        while (father != nullptr)
-        {
-            Comparison result_cond = cond(data, father->data);
-            if (result_cond == Comparison::LESS_THAN)
-            {
-                return father;
-            }
-            if (result_cond == Comparison::GREATER_THAN)
-            {
-                father = get_father(root, father->data);
-            }
-        }
-        return nullptr;
+        return t1;
     }
-    if (requested->right != nullptr)
+    node_type* l2 = t2->left;
+    node_type* r2 = t2->right;
+    set_parent(l2, nullptr);
+    set_parent(r2, nullptr);
+    node_type *l1, *equal, *r1;
+    split_nodes(t1, get_probe(t2), l1, equal, r1);
+    node_type* l = unite_nodes(l1, l2);
+    node_type* r = unite_nodes(r1, r2);
+    if (equal != nullptr)
     {
-        return get_min_node_by_root(requested->right);
+        node_allocator->deallocate(t2);
+        return join_nodes(l, equal, r);
     }
-    return nullptr;
+    return join_nodes(l, t2, r);
 }
 
 
-template <class ptr_type, class condition>
-AVLNode<ptr_type>* AVLTree<ptr_type, condition>::get_father(AVLNode<ptr_type>* r, ptr_type* data)
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::intersect_nodes(node_type* t1, node_type* t2)
 {
-    if (r == nullptr || data == root->data)
+    if (t1 == nullptr || t2 == nullptr)
     {
+        destructor(t1, *node_allocator);
+        destructor(t2, *node_allocator);
         return nullptr;
     }
-    else
+    node_type* l2 = t2->left;
+    node_type* r2 = t2->right;
+    set_parent(l2, nullptr);
+    set_parent(r2, nullptr);
+    node_type *l1, *equal, *r1;
+    split_nodes(t1, get_probe(t2), l1, equal, r1);
+    node_allocator->deallocate(t2);
+    node_type* l = intersect_nodes(l1, l2);
+    node_type* r = intersect_nodes(r1, r2);
+    if (equal != nullptr)
     {
-        condition cond;
-        if (check_if_father(r, data))
-        {
-            return r;
-        }
-        if (cond(data, r->data) == Comparison::LESS_THAN)
-        {
-            return get_father(r->left, data);
-        }
-        if (cond(data, r->data) == Comparison::GREATER_THAN)
-        {
-            return get_father(r->right, data);
-        }
+        return join_nodes(l, equal, r);
     }
-    return nullptr;
+    return join_without_pivot(l, r);
 }
 
 
-template <class ptr_type, class condition>
-bool AVLTree<ptr_type, condition>::check_if_father(AVLNode<ptr_type>* r, ptr_type* data)
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+typename AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::node_type* AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::subtract_nodes(node_type* t1, node_type* t2)
 {
-    condition cond;
-    if (r->right != nullptr)
+    if (t1 == nullptr || t2 == nullptr)
     {
-        if (cond(data, r->right->data) == Comparison::EQUAL)
-        {
-            return true;
-        }
+        destructor(t2, *node_allocator);
+        return t1;
     }
-    if (r->left != nullptr)
+    node_type* l2 = t2->left;
+    node_type* r2 = t2->right;
+    set_parent(l2, nullptr);
+    set_parent(r2, nullptr);
+    node_type *l1, *equal, *r1;
+    split_nodes(t1, get_probe(t2), l1, equal, r1);
+    node_allocator->deallocate(t2);
+    if (equal != nullptr)
     {
-        if (cond(data, r->left->data) == Comparison::EQUAL)
-        {
-            return true;
-        }
+        node_allocator->deallocate(equal);
     }
-    return false;
+    node_type* l = subtract_nodes(l1, l2);
+    node_type* r = subtract_nodes(r1, r2);
+    return join_without_pivot(l, r);
 }
 
 
-/******************************************************* travel functions *******************************************************/
-
-
-template <class ptr_type, class condition>
-ptr_type** AVLTree<ptr_type, condition>::inorder()
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::unite(AVLTree& other)
 {
-    if (root == nullptr)
+    if (&other == this)
     {
-        return nullptr;
+        return;
     }
-    ptr_type** elements_by_order = new ptr_type*[num_of_nodes];
-    int* i = new int(0);
-    inorder_travel(root, elements_by_order, i);
-    delete i;
-    return elements_by_order;
+    adopt_nodes_of(other);
+    root = unite_nodes(root, take_root_of(other));
+    set_parent(root, nullptr);
+    num_of_nodes = get_size(root);
+    refresh_fingers();
 }
 
 
-template <class ptr_type, class condition>
-void AVLTree<ptr_type, condition>::inorder_travel(AVLNode<ptr_type>* r, ptr_type**& elements_by_order, int*& index)
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::intersect(AVLTree& other)
 {
-    if (r == nullptr)
+    if (&other == this)
     {
         return;
     }
-    inorder_travel(r->left, elements_by_order, index);
-    elements_by_order[*index] = r->data;
-    (*index)++;
-    inorder_travel(r->right, elements_by_order, index);
+    adopt_nodes_of(other);
+    root = intersect_nodes(root, take_root_of(other));
+    set_parent(root, nullptr);
+    num_of_nodes = get_size(root);
+    refresh_fingers();
 }
 
 
-/******************************************************* removing functions *******************************************************/
-
-
-template <class ptr_type, class condition>
-bool AVLTree<ptr_type, condition>::remove(ptr_type* data)
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::subtract(AVLTree& other)
 {
-    bool* result = new bool();
-    *result = false;
-    remove_node(root, data, result, false);
-    bool value = *result;
-    delete result;
-    if (value == true)
+    if (&other == this)
     {
-        num_of_nodes--;
+        free_all_nodes();
+        return;
     }
-    return value;
+    adopt_nodes_of(other);
+    root = subtract_nodes(root, take_root_of(other));
+    set_parent(root, nullptr);
+    num_of_nodes = get_size(root);
+    refresh_fingers();
 }
 
 
-template <class ptr_type, class condition>
-bool AVLTree<ptr_type, condition>::remove_and_erase(ptr_type* data)
+/******************************************************* destructor *******************************************************/
+
+
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::destructor(node_type*& r, allocator_type& pool)
 {
-    bool* result = new bool();
-    *result = false;
-    remove_node(root, data, result, true);
-    bool value = *result;
-    delete result;
-    if (value == true)
+    if (r == nullptr)
     {
-        num_of_nodes--;
+        return;
     }
-    return value;
+    destructor(r->left, pool);
+    destructor(r->right, pool);
+    pool.deallocate(r);
 }
 
 
-template <class ptr_type, class condition>
-AVLNode<ptr_type>* AVLTree<ptr_type, condition>::find_successor(AVLNode<ptr_type>* b)
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::destructor_in_parallel(node_type* r, allocator_type& pool, int threads)
 {
-    b = b->left;
-    while(b->right != nullptr)
+    if (threads < 2 || get_size(r) < AVL_PARALLEL_CUTOFF)
     {
-        b = b->right;
+        destructor(r, pool);
+        return;
     }
-    return b;
+    // a node freed to another pool of the same type is handed back to pool by absorb
+    allocator_type right_pool;
+    avl_run_in_parallel([&]() { destructor_in_parallel(r->right, right_pool, threads - threads / 2); },
+                        [&]() { destructor_in_parallel(r->left, pool, threads / 2); });
+    pool.absorb(right_pool);
+    pool.deallocate(r);
 }
 
 
-template <class ptr_type, class condition>
-AVLNode<ptr_type>* AVLTree<ptr_type, condition>::remove_node(AVLNode<ptr_type> *&r, ptr_type* data, bool*& result, bool erase)
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::free_all_nodes(bool in_parallel)
 {
-    if (r == nullptr)
+    if (node_allocator == nullptr)
     {
-        *result = *result + false;
-        return nullptr;
+        return;     // the tree never allocated, so it has no nodes
+    }
+    // objects owned by the nodes must be destroyed one by one, unless they have nothing to destroy
+    if (allocator_type::BULK_RELEASE && node_allocator.use_count() == 1 && (!owns_data || std::is_trivially_destructible<ptr_type>::value))
+    {
+        node_allocator->release();
     }
     else
     {
-        condition cond;
-        Comparison comp_result = cond(data, r->data);
-        if (comp_result == Comparison::EQUAL)
-        {
-            if (r->right == nullptr && r->left == nullptr) // junction is leaf
-            {
-                AVLNode<ptr_type>* temp = r;
-                if (erase)
-                {
-                    delete temp->data;
-                }
-                delete temp;
-                r = nullptr;
-                *result = true;
-                return r;
-            }
-            if (r->right == nullptr && r->left != nullptr) // junction has only left child
-            {
-                AVLNode<ptr_type>* temp = r;
-                r = r->left;
-                if (erase)
-                {
-                    delete temp->data;
-                }
-                delete temp;
-                *result = true;
-                return r;
-            }
-            if (r->right != nullptr && r->left == nullptr) // junction has only right child
-            {
-                AVLNode<ptr_type>* temp = r;
-                r = r->right;
-                if (erase)
-                {
-                    delete temp->data;
-                }
-                delete temp;
-                *result = true;
-                return r;
-            }
-            if (r->right != nullptr && r->left != nullptr) // junction has both children
-            {
-                AVLNode<ptr_type>* successor = find_successor(r);
-                AVLNode<ptr_type>* temp2;
-                temp2 = r;
-                if (erase)
-                {
-                    delete temp2->data;
-                }
-                r->data = successor->data;
-                remove_node(r->left, successor->data, result, false);
-                update_height(r);
-                *result = true;
-                return balance_tree(r);
-            }
-        }
-        if (comp_result == Comparison::LESS_THAN)
-        {
-            r->left = remove_node(r->left, data, result, erase);
-            update_height(r);
-            return balance_tree(r);
-        }
-        if (comp_result == Comparison::GREATER_THAN)
-        {
-            r->right = remove_node(r->right, data, result, erase);
-            update_height(r);
-            return balance_tree(r);
-        }
+        destructor_in_parallel(root, *node_allocator, in_parallel ? num_of_threads : 1);
     }
-    return nullptr;
+    root = nullptr;
+    min_node = nullptr;
+    max_node = nullptr;
+    num_of_nodes = 0;
 }
 
 
-template <class ptr_type, class condition>
-void AVLTree<ptr_type, condition>::erase_data_in_node(AVLNode<ptr_type>*& r)
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+AVLPoolStats AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::get_pool_stats()
 {
-    if (r == nullptr)
+    if (node_allocator == nullptr)
     {
-        return;
+        return AVLPoolStats();
     }
-    erase_data_in_node(r->left);
-    erase_data_in_node(r->right);
-    r->height = 0;  // for elegance
-    delete r->data;
+    return node_allocator->get_stats();
 }
 
-
-template <class ptr_type, class condition>
-void AVLTree<ptr_type, condition>::erase_data()
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+AVLTreeStats AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::get_tree_stats()
 {
-    erase_data_in_node(root);
+    static_assert(INSTRUMENTED, "get_tree_stats needs an instrumentation (see AVLStats.h)");
+    return counters.snapshot();
 }
 
-
-/******************************************************* destructor *******************************************************/
-
-
-template <class ptr_type, class condition>
-void AVLTree<ptr_type, condition>::destructor(AVLNode<ptr_type>*& r)
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+void AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::reset_tree_stats()
 {
-    if (r == nullptr)
-    {
-        return;
-    }
-    destructor(r->left);
-    destructor(r->right);
-    delete r;
+    static_assert(INSTRUMENTED, "reset_tree_stats needs an instrumentation (see AVLStats.h)");
+    counters.reset();
 }
 
-template <class ptr_type, class condition>
-AVLTree<ptr_type, condition>::~AVLTree()
+template <class ptr_type, class condition, template <class> class allocator, class key_extractor, class augmentation, class instrumentation, bool owns_data>
+AVLTree<ptr_type, condition, allocator, key_extractor, augmentation, instrumentation, owns_data>::~AVLTree()
 {
-    destructor(root);
+    free_all_nodes();
 }
 
 #endif //AVL_AVLTREE_H
\ No newline at end of file
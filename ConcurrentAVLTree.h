@@ -0,0 +1,1112 @@
+#ifndef AVL_CONCURRENTAVLTREE_H
+#define AVL_CONCURRENTAVLTREE_H
+
+#include "AVLTree.h"
+#include "AVLEpoch.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+
+// tiny lock of a concurrent node - held only for the few stores of a link, unlink or rotation
+class AVLSpinLock
+{
+private:
+    std::atomic<bool> locked;
+
+    static const int SPINS_BEFORE_YIELD = 64;
+
+public:
+    AVLSpinLock() : locked(false) {}
+
+    void lock()
+    {
+        int spins = 0;
+        while (locked.exchange(true, std::memory_order_acquire))
+        {
+            while (locked.load(std::memory_order_relaxed))
+            {
+                if (++spins == SPINS_BEFORE_YIELD)
+                {
+                    spins = 0;
+                    std::this_thread::yield();
+                }
+            }
+        }
+    }
+
+    void unlock()
+    {
+        locked.store(false, std::memory_order_release);
+    }
+};
+
+
+/** AVL tree for many concurrent readers and writers (Bronson et al., "A Practical Concurrent Binary Search Tree")
+ * readers and the descent of writers take no lock: every node has a version that a rotation changes when it
+ * moves the node down, and a descent checks the version of the node it came from after every step, going back
+ * up only as far as needed (hand-over-hand optimistic validation)
+ * writers lock only the nodes they link, unlink or rotate, so writes of distant keys run in parallel
+ * a removed node with two children stays in the tree as a routing node (data nullptr) until it has at most
+ * one child, balance is fixed from the changed node up, and unlinked nodes are freed by the epoch manager
+ * nodes keep their key (see AVLTree's key_extractor) - a routing node must stay comparable after its data is gone
+ * keys are ordered by operator<
+ */
+template <class ptr_type, class key_extractor>
+class ConcurrentAVLTree
+{
+public:
+    typedef typename std::decay<decltype(key_extractor()(std::declval<const ptr_type*>()))>::type key_type;
+    typedef AVLEpochManager::Guard read_guard;
+
+    struct ConcurrentNode
+    {
+        const key_type key;
+        std::atomic<ptr_type*> data;    // nullptr for a routing node
+        std::atomic<int> height;        // 1 for a leaf, the height of an empty subtree is 0
+        std::atomic<uint64_t> version;  // UNLINKED, or a count of the rotations that moved the node down + SHRINKING
+        std::atomic<ConcurrentNode*> parent;
+        std::atomic<ConcurrentNode*> left;
+        std::atomic<ConcurrentNode*> right;
+        AVLSpinLock lock;
+
+        ConcurrentNode(const key_type& key, ptr_type* data, ConcurrentNode* parent) :
+                key(key), data(data), height(1), version(0), parent(parent), left(nullptr), right(nullptr) {}
+    };
+
+    typedef ConcurrentNode node_type;
+
+private:
+    enum class Attempt { DONE, RETRY };
+
+    // - sub function for all descents: compares key to the key of node r
+    static Comparison compare(const key_type& key, node_type* r);
+
+    // - sub function for all descents: returns the 'side' child of r
+    static node_type* get_child(node_type* r, Comparison side);
+
+    // - sub function for all descents: waits until the rotation that is moving r down is done
+    static void wait_until_not_changing(node_type* r);
+
+    // - sub function for search: validated descent below node, which had node_version when the parent was checked
+    Attempt attempt_search(const key_type& key, node_type* node, Comparison side, uint64_t node_version, ptr_type*& result);
+
+    // - sub function for insert: validated descent, links a new node (or revives a routing node) for data
+    Attempt attempt_insert(const key_type& key, ptr_type* data, node_type* node, Comparison side, uint64_t node_version, bool& inserted);
+
+    // -- sub function for attempt_insert: links a new leaf as the 'side' child of node
+    Attempt attempt_link(const key_type& key, ptr_type* data, node_type* node, Comparison side, uint64_t node_version);
+
+    // -- sub function for attempt_insert: puts data back in a routing node with the same key
+    Attempt attempt_revive(node_type* r, ptr_type* data, bool& inserted);
+
+    // - sub function for remove: validated descent, removes the node of key
+    Attempt attempt_remove(const key_type& key, node_type* node, Comparison side, uint64_t node_version, ptr_type*& removed);
+
+    // -- sub function for attempt_remove: unlinks n from parent, or makes it a routing node if it has two children
+    Attempt attempt_remove_node(node_type* parent, node_type* n, ptr_type*& removed);
+
+    // - sub function for the writers: fixes heights, balance and routing nodes from node up, locking as it goes
+    void fix_height_and_rebalance(node_type* node);
+
+    // -- sub function for fixing: returns the new height of node, or what must be done to it
+    int node_condition(node_type* node);
+
+    // -- sub function for fixing, node locked: updates the height of node, returns the next node to fix
+    node_type* fix_height_nl(node_type* node);
+
+    // -- sub function for fixing, parent and n locked: unlinks or rotates n, returns the next node to fix
+    node_type* rebalance_nl(node_type* parent, node_type* n);
+
+    // --- sub functions for rebalance_nl: rotate n towards its lighter side, choosing single or double rotation
+    node_type* rebalance_to_right_nl(node_type* parent, node_type* n, node_type* n_left, int h_right);
+    node_type* rebalance_to_left_nl(node_type* parent, node_type* n, node_type* n_right, int h_left);
+
+    // --- sub functions for rebalance: the rotations, all nodes that move down are locked and have their version changed
+    node_type* rotate_right_nl(node_type* parent, node_type* n, node_type* n_left, int h_right, int h_left_left, node_type* n_left_right, int h_left_right);
+    node_type* rotate_left_nl(node_type* parent, node_type* n, int h_left, node_type* n_right, node_type* n_right_left, int h_right_left, int h_right_right);
+    node_type* rotate_right_over_left_nl(node_type* parent, node_type* n, node_type* n_left, int h_right, int h_left_left, node_type* n_left_right, int h_left_right_left);
+    node_type* rotate_left_over_right_nl(node_type* parent, node_type* n, int h_left, node_type* n_right, node_type* n_right_left, int h_right_right, int h_right_left_right);
+
+    // --- sub function for rebalance_nl: unlinks a routing node with at most one child
+    bool attempt_unlink_nl(node_type* parent, node_type* n);
+
+    // - sub function for the writers: hands an unlinked node to the epoch manager
+    void retire(node_type* n);
+
+    // - sub function for retire: frees a node that no thread can hold anymore
+    static void free_node(void* node, void* tree);
+
+    // - sub function for remove_and_erase: erases data that no thread can hold anymore
+    static void free_data(void* data, void* tree);
+
+    // - sub function for get_num_of_nodes: counts the nodes with data under r
+    int count_nodes(node_type* r);
+
+    // - sub function for destructor: frees all nodes
+    void destructor(node_type* r);
+
+    static int get_height(node_type* r);
+    static bool can_unlink(node_type* n);
+    static uint64_t begin_change(uint64_t version);
+    static uint64_t end_change(uint64_t version);
+
+    node_type root_holder;      // never moves, the root is its right child
+    AVLEpochManager epochs;
+
+    static const uint64_t UNLINKED = 1;
+    static const uint64_t SHRINKING = 2;
+    static const uint64_t SHRINK_COUNT_INCREMENT = 4;
+    static const int UNLINK_REQUIRED = -1;
+    static const int REBALANCE_REQUIRED = -2;
+    static const int NOTHING_REQUIRED = -3;
+    static const int SPINS_BEFORE_LOCK = 100;
+    static const int MAX_PENDING_FIXES = 16;
+
+public:
+    // constructor
+    ConcurrentAVLTree() : root_holder(key_type(), nullptr, nullptr) {}
+
+    ConcurrentAVLTree(const ConcurrentAVLTree&) = delete;
+    ConcurrentAVLTree& operator=(const ConcurrentAVLTree&) = delete;
+
+    /** pins the tree until the guard is destroyed - data returned by search and remove stays valid while the
+     * guard lives even if another thread removes and erases it meanwhile
+     */
+    read_guard lock_for_reading();
+
+    /** returns the data of the node with 'key'
+     *  returns nullptr - if node doesn't exist
+     */
+    ptr_type* search(const key_type& key);
+
+    /** inserts a new node to the tree
+     * returns true - if node is created
+     * returns false - if a node with the same key already exists
+     */
+    bool insert(ptr_type* data);
+
+    /** removes the node with 'key'
+     * returns the data of the node removed
+     * returns nullptr - if node doesn't exist
+     */
+    ptr_type* remove(const key_type& key);
+
+    /** removes the node with 'key' and calls the destructor of its data once no thread can hold it
+     * returns true - if node is found and removed
+     * returns false - if node doesn't exist
+     */
+    bool remove_and_erase(const key_type& key);
+
+    // returns how many nodes the tree consists - walks the tree, exact only while no thread writes
+    int get_num_of_nodes();
+
+    // returns the height of the tree (routing nodes included) - exact only while no thread writes
+    int get_tree_height();
+
+    // destructor - DOES NOT erase the data pointed to, no other thread may use the tree
+    ~ConcurrentAVLTree();
+};
+
+
+/******************************************************* node details functions *******************************************************/
+
+
+template <class ptr_type, class key_extractor>
+Comparison ConcurrentAVLTree<ptr_type, key_extractor>::compare(const key_type& key, node_type* r)
+{
+    if (key < r->key)
+    {
+        return Comparison::LESS_THAN;
+    }
+    if (r->key < key)
+    {
+        return Comparison::GREATER_THAN;
+    }
+    return Comparison::EQUAL;
+}
+
+
+template <class ptr_type, class key_extractor>
+typename ConcurrentAVLTree<ptr_type, key_extractor>::node_type* ConcurrentAVLTree<ptr_type, key_extractor>::get_child(node_type* r, Comparison side)
+{
+    return (side == Comparison::LESS_THAN) ? r->left.load() : r->right.load();
+}
+
+
+template <class ptr_type, class key_extractor>
+void ConcurrentAVLTree<ptr_type, key_extractor>::wait_until_not_changing(node_type* r)
+{
+    for (int i = 0; i < SPINS_BEFORE_LOCK; i++)
+    {
+        if ((r->version.load() & SHRINKING) == 0)
+        {
+            return;
+        }
+    }
+    // the rotating thread holds the lock of r until it's done
+    r->lock.lock();
+    r->lock.unlock();
+}
+
+
+template <class ptr_type, class key_extractor>
+int ConcurrentAVLTree<ptr_type, key_extractor>::get_height(node_type* r)
+{
+    return (r == nullptr) ? 0 : r->height.load();
+}
+
+
+template <class ptr_type, class key_extractor>
+bool ConcurrentAVLTree<ptr_type, key_extractor>::can_unlink(node_type* n)
+{
+    return n->left.load() == nullptr || n->right.load() == nullptr;
+}
+
+
+template <class ptr_type, class key_extractor>
+uint64_t ConcurrentAVLTree<ptr_type, key_extractor>::begin_change(uint64_t version)
+{
+    return version | SHRINKING;
+}
+
+
+template <class ptr_type, class key_extractor>
+uint64_t ConcurrentAVLTree<ptr_type, key_extractor>::end_change(uint64_t version)
+{
+    return (version | (SHRINK_COUNT_INCREMENT - 1)) + 1;
+}
+
+
+template <class ptr_type, class key_extractor>
+void ConcurrentAVLTree<ptr_type, key_extractor>::retire(node_type* n)
+{
+    epochs.retire(n, free_node, this);
+}
+
+
+template <class ptr_type, class key_extractor>
+void ConcurrentAVLTree<ptr_type, key_extractor>::free_node(void* node, void*)
+{
+    delete static_cast<node_type*>(node);
+}
+
+
+template <class ptr_type, class key_extractor>
+void ConcurrentAVLTree<ptr_type, key_extractor>::free_data(void* data, void*)
+{
+    delete static_cast<ptr_type*>(data);
+}
+
+
+/******************************************************* search functions *******************************************************/
+
+
+template <class ptr_type, class key_extractor>
+typename ConcurrentAVLTree<ptr_type, key_extractor>::read_guard ConcurrentAVLTree<ptr_type, key_extractor>::lock_for_reading()
+{
+    return read_guard(epochs);
+}
+
+
+template <class ptr_type, class key_extractor>
+ptr_type* ConcurrentAVLTree<ptr_type, key_extractor>::search(const key_type& key)
+{
+    read_guard guard(epochs);
+    ptr_type* result = nullptr;
+    while (attempt_search(key, &root_holder, Comparison::GREATER_THAN, 0, result) == Attempt::RETRY)
+    {
+    }
+    return result;
+}
+
+
+template <class ptr_type, class key_extractor>
+typename ConcurrentAVLTree<ptr_type, key_extractor>::Attempt ConcurrentAVLTree<ptr_type, key_extractor>::attempt_search(const key_type& key, node_type* node, Comparison side, uint64_t node_version, ptr_type*& result)
+{
+    while (true)
+    {
+        node_type* child = get_child(node, side);
+        if (node->version.load() != node_version)
+        {
+            return Attempt::RETRY;
+        }
+        if (child == nullptr)
+        {
+            result = nullptr;
+            return Attempt::DONE;
+        }
+        Comparison next = compare(key, child);
+        if (next == Comparison::EQUAL)
+        {
+            result = child->data.load();
+            return Attempt::DONE;
+        }
+        uint64_t child_version = child->version.load();
+        if ((child_version & SHRINKING) != 0)
+        {
+            wait_until_not_changing(child);
+        }
+        else if (child_version != UNLINKED && child == get_child(node, side))
+        {
+            // the step to child was valid - below it only child's version matters
+            if (node->version.load() != node_version)
+            {
+                return Attempt::RETRY;
+            }
+            if (attempt_search(key, child, next, child_version, result) == Attempt::DONE)
+            {
+                return Attempt::DONE;
+            }
+        }
+    }
+}
+
+
+/******************************************************* insert functions *******************************************************/
+
+
+template <class ptr_type, class key_extractor>
+bool ConcurrentAVLTree<ptr_type, key_extractor>::insert(ptr_type* data)
+{
+    read_guard guard(epochs);
+    key_type key = key_extractor()(data);
+    bool inserted = false;
+    while (attempt_insert(key, data, &root_holder, Comparison::GREATER_THAN, 0, inserted) == Attempt::RETRY)
+    {
+    }
+    return inserted;
+}
+
+
+template <class ptr_type, class key_extractor>
+typename ConcurrentAVLTree<ptr_type, key_extractor>::Attempt ConcurrentAVLTree<ptr_type, key_extractor>::attempt_insert(const key_type& key, ptr_type* data, node_type* node, Comparison side, uint64_t node_version, bool& inserted)
+{
+    while (true)
+    {
+        node_type* child = get_child(node, side);
+        if (node->version.load() != node_version)
+        {
+            return Attempt::RETRY;
+        }
+        if (child == nullptr)
+        {
+            if (attempt_link(key, data, node, side, node_version) == Attempt::DONE)
+            {
+                inserted = true;
+                return Attempt::DONE;
+            }
+            continue;
+        }
+        Comparison next = compare(key, child);
+        if (next == Comparison::EQUAL)
+        {
+            if (attempt_revive(child, data, inserted) == Attempt::DONE)
+            {
+                return Attempt::DONE;
+            }
+            continue;
+        }
+        uint64_t child_version = child->version.load();
+        if ((child_version & SHRINKING) != 0)
+        {
+            wait_until_not_changing(child);
+        }
+        else if (child_version != UNLINKED && child == get_child(node, side))
+        {
+            if (node->version.load() != node_version)
+            {
+                return Attempt::RETRY;
+            }
+            if (attempt_insert(key, data, child, next, child_version, inserted) == Attempt::DONE)
+            {
+                return Attempt::DONE;
+            }
+        }
+    }
+}
+
+
+template <class ptr_type, class key_extractor>
+typename ConcurrentAVLTree<ptr_type, key_extractor>::Attempt ConcurrentAVLTree<ptr_type, key_extractor>::attempt_link(const key_type& key, ptr_type* data, node_type* node, Comparison side, uint64_t node_version)
+{
+    {
+        std::lock_guard<AVLSpinLock> lock(node->lock);
+        if (node->version.load() != node_version || get_child(node, side) != nullptr)
+        {
+            return Attempt::RETRY;
+        }
+        node_type* leaf = new node_type(key, data, node);
+        if (side == Comparison::LESS_THAN)
+        {
+            node->left.store(leaf);
+        }
+        else
+        {
+            node->right.store(leaf);
+        }
+    }
+    fix_height_and_rebalance(node);
+    return Attempt::DONE;
+}
+
+
+template <class ptr_type, class key_extractor>
+typename ConcurrentAVLTree<ptr_type, key_extractor>::Attempt ConcurrentAVLTree<ptr_type, key_extractor>::attempt_revive(node_type* r, ptr_type* data, bool& inserted)
+{
+    std::lock_guard<AVLSpinLock> lock(r->lock);
+    if (r->version.load() == UNLINKED)
+    {
+        return Attempt::RETRY;
+    }
+    inserted = (r->data.load() == nullptr);
+    if (inserted)
+    {
+        r->data.store(data);
+    }
+    return Attempt::DONE;
+}
+
+
+/******************************************************* remove functions *******************************************************/
+
+
+template <class ptr_type, class key_extractor>
+ptr_type* ConcurrentAVLTree<ptr_type, key_extractor>::remove(const key_type& key)
+{
+    read_guard guard(epochs);
+    ptr_type* removed = nullptr;
+    while (attempt_remove(key, &root_holder, Comparison::GREATER_THAN, 0, removed) == Attempt::RETRY)
+    {
+    }
+    return removed;
+}
+
+
+template <class ptr_type, class key_extractor>
+bool ConcurrentAVLTree<ptr_type, key_extractor>::remove_and_erase(const key_type& key)
+{
+    ptr_type* removed = remove(key);
+    if (removed == nullptr)
+    {
+        return false;
+    }
+    epochs.retire(removed, free_data, this);
+    return true;
+}
+
+
+template <class ptr_type, class key_extractor>
+typename ConcurrentAVLTree<ptr_type, key_extractor>::Attempt ConcurrentAVLTree<ptr_type, key_extractor>::attempt_remove(const key_type& key, node_type* node, Comparison side, uint64_t node_version, ptr_type*& removed)
+{
+    while (true)
+    {
+        node_type* child = get_child(node, side);
+        if (node->version.load() != node_version)
+        {
+            return Attempt::RETRY;
+        }
+        if (child == nullptr)
+        {
+            removed = nullptr;
+            return Attempt::DONE;
+        }
+        Comparison next = compare(key, child);
+        if (next == Comparison::EQUAL)
+        {
+            if (attempt_remove_node(node, child, removed) == Attempt::DONE)
+            {
+                return Attempt::DONE;
+            }
+            continue;
+        }
+        uint64_t child_version = child->version.load();
+        if ((child_version & SHRINKING) != 0)
+        {
+            wait_until_not_changing(child);
+        }
+        else if (child_version != UNLINKED && child == get_child(node, side))
+        {
+            if (node->version.load() != node_version)
+            {
+                return Attempt::RETRY;
+            }
+            if (attempt_remove(key, child, next, child_version, removed) == Attempt::DONE)
+            {
+                return Attempt::DONE;
+            }
+        }
+    }
+}
+
+
+template <class ptr_type, class key_extractor>
+typename ConcurrentAVLTree<ptr_type, key_extractor>::Attempt ConcurrentAVLTree<ptr_type, key_extractor>::attempt_remove_node(node_type* parent, node_type* n, ptr_type*& removed)
+{
+    if (n->data.load() == nullptr)
+    {
+        removed = nullptr;
+        return Attempt::DONE;
+    }
+    if (!can_unlink(n))
+    {
+        // junction has both children - it stays as a routing node until one of them is gone
+        std::lock_guard<AVLSpinLock> lock(n->lock);
+        if (n->version.load() == UNLINKED || can_unlink(n))
+        {
+            return Attempt::RETRY;
+        }
+        removed = n->data.exchange(nullptr);
+        return Attempt::DONE;
+    }
+    {
+        std::lock_guard<AVLSpinLock> parent_lock(parent->lock);
+        if (parent->version.load() == UNLINKED || n->parent.load() != parent)
+        {
+            return Attempt::RETRY;
+        }
+        std::lock_guard<AVLSpinLock> lock(n->lock);
+        removed = n->data.load();
+        if (removed == nullptr)
+        {
+            return Attempt::DONE;
+        }
+        if (!can_unlink(n))
+        {
+            return Attempt::RETRY;
+        }
+        node_type* child = (n->left.load() != nullptr) ? n->left.load() : n->right.load();
+        if (parent->left.load() == n)
+        {
+            parent->left.store(child);
+        }
+        else
+        {
+            parent->right.store(child);
+        }
+        if (child != nullptr)
+        {
+            child->parent.store(parent);
+        }
+        n->version.store(UNLINKED);
+        n->data.store(nullptr);
+        retire(n);
+    }
+    fix_height_and_rebalance(parent);
+    return Attempt::DONE;
+}
+
+
+/******************************************************* balance functions *******************************************************/
+
+
+template <class ptr_type, class key_extractor>
+void ConcurrentAVLTree<ptr_type, key_extractor>::fix_height_and_rebalance(node_type* node)
+{
+    // parents of rotations that left a lower node to fix first - their heights changed too
+    node_type* pending[MAX_PENDING_FIXES];
+    int num_of_pending = 0;
+    while (true)
+    {
+        if (node == nullptr || node->parent.load() == nullptr)
+        {
+            if (num_of_pending == 0)
+            {
+                return;
+            }
+            node = pending[--num_of_pending];
+            continue;
+        }
+        int condition = node_condition(node);
+        if (condition == NOTHING_REQUIRED || node->version.load() == UNLINKED)
+        {
+            node = nullptr;
+            continue;
+        }
+        if (condition != UNLINK_REQUIRED && condition != REBALANCE_REQUIRED)
+        {
+            std::lock_guard<AVLSpinLock> lock(node->lock);
+            node = fix_height_nl(node);
+            continue;
+        }
+        node_type* parent = node->parent.load();
+        std::lock_guard<AVLSpinLock> parent_lock(parent->lock);
+        if (parent->version.load() != UNLINKED && node->parent.load() == parent)
+        {
+            std::lock_guard<AVLSpinLock> lock(node->lock);
+            node_type* next = rebalance_nl(parent, node);
+            if (next != nullptr && next != parent && next != parent->parent.load() && num_of_pending < MAX_PENDING_FIXES)
+            {
+                pending[num_of_pending++] = parent;
+            }
+            node = next;
+        }
+    }
+}
+
+
+template <class ptr_type, class key_extractor>
+int ConcurrentAVLTree<ptr_type, key_extractor>::node_condition(node_type* node)
+{
+    node_type* n_left = node->left.load();
+    node_type* n_right = node->right.load();
+    if ((n_left == nullptr || n_right == nullptr) && node->data.load() == nullptr)
+    {
+        return UNLINK_REQUIRED;
+    }
+    int h_node = node->height.load();
+    int h_left = get_height(n_left);
+    int h_right = get_height(n_right);
+    int h_new = 1 + (h_left > h_right ? h_left : h_right);
+    int bf = h_left - h_right;
+    if (bf < -1 || bf > 1)
+    {
+        return REBALANCE_REQUIRED;
+    }
+    return (h_node != h_new) ? h_new : NOTHING_REQUIRED;
+}
+
+
+template <class ptr_type, class key_extractor>
+typename ConcurrentAVLTree<ptr_type, key_extractor>::node_type* ConcurrentAVLTree<ptr_type, key_extractor>::fix_height_nl(node_type* node)
+{
+    int condition = node_condition(node);
+    if (condition == REBALANCE_REQUIRED || condition == UNLINK_REQUIRED)
+    {
+        return node;
+    }
+    if (condition == NOTHING_REQUIRED)
+    {
+        return nullptr;
+    }
+    node->height.store(condition);
+    return node->parent.load();
+}
+
+
+template <class ptr_type, class key_extractor>
+typename ConcurrentAVLTree<ptr_type, key_extractor>::node_type* ConcurrentAVLTree<ptr_type, key_extractor>::rebalance_nl(node_type* parent, node_type* n)
+{
+    node_type* n_left = n->left.load();
+    node_type* n_right = n->right.load();
+    if ((n_left == nullptr || n_right == nullptr) && n->data.load() == nullptr)
+    {
+        return attempt_unlink_nl(parent, n) ? fix_height_nl(parent) : n;
+    }
+    int h_node = n->height.load();
+    int h_left = get_height(n_left);
+    int h_right = get_height(n_right);
+    int h_new = 1 + (h_left > h_right ? h_left : h_right);
+    int bf = h_left - h_right;
+    if (bf > 1)
+    {
+        return rebalance_to_right_nl(parent, n, n_left, h_right);
+    }
+    if (bf < -1)
+    {
+        return rebalance_to_left_nl(parent, n, n_right, h_left);
+    }
+    if (h_new != h_node)
+    {
+        n->height.store(h_new);
+        return fix_height_nl(parent);
+    }
+    return nullptr;
+}
+
+
+template <class ptr_type, class key_extractor>
+typename ConcurrentAVLTree<ptr_type, key_extractor>::node_type* ConcurrentAVLTree<ptr_type, key_extractor>::rebalance_to_right_nl(node_type* parent, node_type* n, node_type* n_left, int h_right)
+{
+    std::unique_lock<AVLSpinLock> left_lock(n_left->lock);
+    int h_left = n_left->height.load();
+    if (h_left - h_right <= 1)
+    {
+        return n;   // balanced meanwhile - fix again
+    }
+    node_type* n_left_right = n_left->right.load();
+    int h_left_left = get_height(n_left->left.load());
+    int h_left_right = get_height(n_left_right);
+    if (h_left_left >= h_left_right)
+    {
+        return rotate_right_nl(parent, n, n_left, h_right, h_left_left, n_left_right, h_left_right);
+    }
+    {
+        std::lock_guard<AVLSpinLock> left_right_lock(n_left_right->lock);
+        h_left_right = n_left_right->height.load();
+        if (h_left_left >= h_left_right)
+        {
+            return rotate_right_nl(parent, n, n_left, h_right, h_left_left, n_left_right, h_left_right);
+        }
+        int h_left_right_left = get_height(n_left_right->left.load());
+        int bf = h_left_left - h_left_right_left;
+        if (bf >= -1 && bf <= 1)
+        {
+            return rotate_right_over_left_nl(parent, n, n_left, h_right, h_left_left, n_left_right, h_left_right_left);
+        }
+    }
+    // a double rotation would leave n_left unbalanced (n_left_right isn't fixed yet) - rotate n_left first
+    return rebalance_to_left_nl(n, n_left, n_left_right, h_left_left);
+}
+
+
+template <class ptr_type, class key_extractor>
+typename ConcurrentAVLTree<ptr_type, key_extractor>::node_type* ConcurrentAVLTree<ptr_type, key_extractor>::rebalance_to_left_nl(node_type* parent, node_type* n, node_type* n_right, int h_left)
+{
+    std::unique_lock<AVLSpinLock> right_lock(n_right->lock);
+    int h_right = n_right->height.load();
+    if (h_left - h_right >= -1)
+    {
+        return n;
+    }
+    node_type* n_right_left = n_right->left.load();
+    int h_right_left = get_height(n_right_left);
+    int h_right_right = get_height(n_right->right.load());
+    if (h_right_right >= h_right_left)
+    {
+        return rotate_left_nl(parent, n, h_left, n_right, n_right_left, h_right_left, h_right_right);
+    }
+    {
+        std::lock_guard<AVLSpinLock> right_left_lock(n_right_left->lock);
+        h_right_left = n_right_left->height.load();
+        if (h_right_right >= h_right_left)
+        {
+            return rotate_left_nl(parent, n, h_left, n_right, n_right_left, h_right_left, h_right_right);
+        }
+        int h_right_left_right = get_height(n_right_left->right.load());
+        int bf = h_right_right - h_right_left_right;
+        if (bf >= -1 && bf <= 1)
+        {
+            return rotate_left_over_right_nl(parent, n, h_left, n_right, n_right_left, h_right_right, h_right_left_right);
+        }
+    }
+    return rebalance_to_right_nl(n, n_right, n_right_left, h_right_right);
+}
+
+
+template <class ptr_type, class key_extractor>
+typename ConcurrentAVLTree<ptr_type, key_extractor>::node_type* ConcurrentAVLTree<ptr_type, key_extractor>::rotate_right_nl(node_type* parent, node_type* n, node_type* n_left, int h_right, int h_left_left, node_type* n_left_right, int h_left_right)
+{
+    uint64_t node_version = n->version.load();
+    node_type* parent_left = parent->left.load();
+    n->version.store(begin_change(node_version));
+
+    n->left.store(n_left_right);
+    if (n_left_right != nullptr)
+    {
+        n_left_right->parent.store(n);
+    }
+    n_left->right.store(n);
+    n->parent.store(n_left);
+    if (parent_left == n)
+    {
+        parent->left.store(n_left);
+    }
+    else
+    {
+        parent->right.store(n_left);
+    }
+    n_left->parent.store(parent);
+
+    int h_node = 1 + (h_left_right > h_right ? h_left_right : h_right);
+    n->height.store(h_node);
+    n_left->height.store(1 + (h_left_left > h_node ? h_left_left : h_node));
+    n->version.store(end_change(node_version));
+
+    // returns the node that may still need fixing - the lowest first
+    int bf_node = h_left_right - h_right;
+    if (bf_node < -1 || bf_node > 1)
+    {
+        return n;
+    }
+    if ((n_left_right == nullptr || h_right == 0) && n->data.load() == nullptr)
+    {
+        return n;
+    }
+    int bf_left = h_left_left - h_node;
+    if (bf_left < -1 || bf_left > 1)
+    {
+        return n_left;
+    }
+    if (h_left_left == 0 && n_left->data.load() == nullptr)
+    {
+        return n_left;
+    }
+    return fix_height_nl(parent);
+}
+
+
+template <class ptr_type, class key_extractor>
+typename ConcurrentAVLTree<ptr_type, key_extractor>::node_type* ConcurrentAVLTree<ptr_type, key_extractor>::rotate_left_nl(node_type* parent, node_type* n, int h_left, node_type* n_right, node_type* n_right_left, int h_right_left, int h_right_right)
+{
+    uint64_t node_version = n->version.load();
+    node_type* parent_left = parent->left.load();
+    n->version.store(begin_change(node_version));
+
+    n->right.store(n_right_left);
+    if (n_right_left != nullptr)
+    {
+        n_right_left->parent.store(n);
+    }
+    n_right->left.store(n);
+    n->parent.store(n_right);
+    if (parent_left == n)
+    {
+        parent->left.store(n_right);
+    }
+    else
+    {
+        parent->right.store(n_right);
+    }
+    n_right->parent.store(parent);
+
+    int h_node = 1 + (h_left > h_right_left ? h_left : h_right_left);
+    n->height.store(h_node);
+    n_right->height.store(1 + (h_node > h_right_right ? h_node : h_right_right));
+    n->version.store(end_change(node_version));
+
+    int bf_node = h_right_left - h_left;
+    if (bf_node < -1 || bf_node > 1)
+    {
+        return n;
+    }
+    if ((n_right_left == nullptr || h_left == 0) && n->data.load() == nullptr)
+    {
+        return n;
+    }
+    int bf_right = h_right_right - h_node;
+    if (bf_right < -1 || bf_right > 1)
+    {
+        return n_right;
+    }
+    if (h_right_right == 0 && n_right->data.load() == nullptr)
+    {
+        return n_right;
+    }
+    return fix_height_nl(parent);
+}
+
+
+template <class ptr_type, class key_extractor>
+typename ConcurrentAVLTree<ptr_type, key_extractor>::node_type* ConcurrentAVLTree<ptr_type, key_extractor>::rotate_right_over_left_nl(node_type* parent, node_type* n, node_type* n_left, int h_right, int h_left_left, node_type* n_left_right, int h_left_right_left)
+{
+    uint64_t node_version = n->version.load();
+    uint64_t left_version = n_left->version.load();
+    node_type* parent_left = parent->left.load();
+    node_type* n_left_right_left = n_left_right->left.load();
+    node_type* n_left_right_right = n_left_right->right.load();
+    int h_left_right_right = get_height(n_left_right_right);
+    n->version.store(begin_change(node_version));
+    n_left->version.store(begin_change(left_version));
+
+    n->left.store(n_left_right_right);
+    if (n_left_right_right != nullptr)
+    {
+        n_left_right_right->parent.store(n);
+    }
+    n_left->right.store(n_left_right_left);
+    if (n_left_right_left != nullptr)
+    {
+        n_left_right_left->parent.store(n_left);
+    }
+    n_left_right->left.store(n_left);
+    n_left->parent.store(n_left_right);
+    n_left_right->right.store(n);
+    n->parent.store(n_left_right);
+    if (parent_left == n)
+    {
+        parent->left.store(n_left_right);
+    }
+    else
+    {
+        parent->right.store(n_left_right);
+    }
+    n_left_right->parent.store(parent);
+
+    int h_node = 1 + (h_left_right_right > h_right ? h_left_right_right : h_right);
+    n->height.store(h_node);
+    int h_left = 1 + (h_left_left > h_left_right_left ? h_left_left : h_left_right_left);
+    n_left->height.store(h_left);
+    n_left_right->height.store(1 + (h_left > h_node ? h_left : h_node));
+    n->version.store(end_change(node_version));
+    n_left->version.store(end_change(left_version));
+
+    int bf_node = h_left_right_right - h_right;
+    if (bf_node < -1 || bf_node > 1)
+    {
+        return n;
+    }
+    if ((n_left_right_right == nullptr || h_right == 0) && n->data.load() == nullptr)
+    {
+        return n;
+    }
+    if ((n_left_right_left == nullptr || h_left_left == 0) && n_left->data.load() == nullptr)
+    {
+        return n_left;      // a routing node that lost a child - unlinked next
+    }
+    int bf_left_right = h_left - h_node;
+    if (bf_left_right < -1 || bf_left_right > 1)
+    {
+        return n_left_right;
+    }
+    return fix_height_nl(parent);
+}
+
+
+template <class ptr_type, class key_extractor>
+typename ConcurrentAVLTree<ptr_type, key_extractor>::node_type* ConcurrentAVLTree<ptr_type, key_extractor>::rotate_left_over_right_nl(node_type* parent, node_type* n, int h_left, node_type* n_right, node_type* n_right_left, int h_right_right, int h_right_left_right)
+{
+    uint64_t node_version = n->version.load();
+    uint64_t right_version = n_right->version.load();
+    node_type* parent_left = parent->left.load();
+    node_type* n_right_left_left = n_right_left->left.load();
+    node_type* n_right_left_right = n_right_left->right.load();
+    int h_right_left_left = get_height(n_right_left_left);
+    n->version.store(begin_change(node_version));
+    n_right->version.store(begin_change(right_version));
+
+    n->right.store(n_right_left_left);
+    if (n_right_left_left != nullptr)
+    {
+        n_right_left_left->parent.store(n);
+    }
+    n_right->left.store(n_right_left_right);
+    if (n_right_left_right != nullptr)
+    {
+        n_right_left_right->parent.store(n_right);
+    }
+    n_right_left->right.store(n_right);
+    n_right->parent.store(n_right_left);
+    n_right_left->left.store(n);
+    n->parent.store(n_right_left);
+    if (parent_left == n)
+    {
+        parent->left.store(n_right_left);
+    }
+    else
+    {
+        parent->right.store(n_right_left);
+    }
+    n_right_left->parent.store(parent);
+
+    int h_node = 1 + (h_left > h_right_left_left ? h_left : h_right_left_left);
+    n->height.store(h_node);
+    int h_right = 1 + (h_right_left_right > h_right_right ? h_right_left_right : h_right_right);
+    n_right->height.store(h_right);
+    n_right_left->height.store(1 + (h_node > h_right ? h_node : h_right));
+    n->version.store(end_change(node_version));
+    n_right->version.store(end_change(right_version));
+
+    int bf_node = h_right_left_left - h_left;
+    if (bf_node < -1 || bf_node > 1)
+    {
+        return n;
+    }
+    if ((n_right_left_left == nullptr || h_left == 0) && n->data.load() == nullptr)
+    {
+        return n;
+    }
+    if ((n_right_left_right == nullptr || h_right_right == 0) && n_right->data.load() == nullptr)
+    {
+        return n_right;
+    }
+    int bf_right_left = h_right - h_node;
+    if (bf_right_left < -1 || bf_right_left > 1)
+    {
+        return n_right_left;
+    }
+    return fix_height_nl(parent);
+}
+
+
+template <class ptr_type, class key_extractor>
+bool ConcurrentAVLTree<ptr_type, key_extractor>::attempt_unlink_nl(node_type* parent, node_type* n)
+{
+    node_type* parent_left = parent->left.load();
+    node_type* parent_right = parent->right.load();
+    if (parent_left != n && parent_right != n)
+    {
+        return false;
+    }
+    node_type* n_left = n->left.load();
+    node_type* n_right = n->right.load();
+    if (n_left != nullptr && n_right != nullptr)
+    {
+        return false;
+    }
+    node_type* splice = (n_left != nullptr) ? n_left : n_right;
+    if (parent_left == n)
+    {
+        parent->left.store(splice);
+    }
+    else
+    {
+        parent->right.store(splice);
+    }
+    if (splice != nullptr)
+    {
+        splice->parent.store(parent);
+    }
+    n->version.store(UNLINKED);
+    n->data.store(nullptr);
+    retire(n);
+    return true;
+}
+
+
+/******************************************************* tree details functions *******************************************************/
+
+
+template <class ptr_type, class key_extractor>
+int ConcurrentAVLTree<ptr_type, key_extractor>::get_num_of_nodes()
+{
+    read_guard guard(epochs);
+    return count_nodes(root_holder.right.load());
+}
+
+
+template <class ptr_type, class key_extractor>
+int ConcurrentAVLTree<ptr_type, key_extractor>::count_nodes(node_type* r)
+{
+    if (r == nullptr)
+    {
+        return 0;
+    }
+    return (r->data.load() != nullptr ? 1 : 0) + count_nodes(r->left.load()) + count_nodes(r->right.load());
+}
+
+
+template <class ptr_type, class key_extractor>
+int ConcurrentAVLTree<ptr_type, key_extractor>::get_tree_height()
+{
+    read_guard guard(epochs);
+    return get_height(root_holder.right.load()) - 1;
+}
+
+
+/******************************************************* destructor *******************************************************/
+
+
+template <class ptr_type, class key_extractor>
+void ConcurrentAVLTree<ptr_type, key_extractor>::destructor(node_type* r)
+{
+    if (r == nullptr)
+    {
+        return;
+    }
+    destructor(r->left.load());
+    destructor(r->right.load());
+    delete r;
+}
+
+
+template <class ptr_type, class key_extractor>
+ConcurrentAVLTree<ptr_type, key_extractor>::~ConcurrentAVLTree()
+{
+    destructor(root_holder.right.load());
+}
+
+#endif //AVL_CONCURRENTAVLTREE_H
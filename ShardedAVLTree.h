@@ -0,0 +1,562 @@
+#ifndef AVL_SHARDEDAVLTREE_H
+#define AVL_SHARDEDAVLTREE_H
+
+#include "AVLTree.h"
+#include "AVLParallel.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+
+
+/** AVL tree for many writers, range partitioned into shards - every shard is an AVLTree with a lock of its own,
+ * holding the keys from its low boundary up to the low boundary of the next shard, so writes of keys in different
+ * shards run in parallel
+ * every shard counts the operations it serves, and a shard that served REBALANCE_PERIOD of them compares its load
+ * with its neighbors and hands its edge keys to a lighter neighbor (split of its tree, join into the neighbor's),
+ * moving the boundary between them - shards start out unused and are opened this way as load grows, or evenly
+ * by build_from_array
+ * boundaries are kept as keys (see AVLTree's key_extractor), so routing never touches data that may be erased
+ * ordered iteration and the neighbor queries cross the shard edges, locking the shards they pass in order
+ * data returned stays valid as long as it isn't erased - the nodes aren't exposed, they may move between shards
+ * every shard has an unlocked pool of its own, and nodes move between shards without being copied (see move_to_right)
+ */
+template <class ptr_type, class condition, class key_extractor>
+class ShardedAVLTree
+{
+public:
+    typedef typename std::decay<decltype(key_extractor()(std::declval<const ptr_type*>()))>::type key_type;
+    typedef AVLTree<ptr_type, condition> tree_type;
+
+private:
+    struct alignas(64) Shard
+    {
+        std::mutex lock;
+        tree_type tree;
+        long ops = 0;       // operations served since the last rebalance of the shard, guarded by lock
+    };
+
+    // - sub function for all operations: returns the shard whose range holds key, by the boundaries (without locking)
+    int find_shard(const key_type& key);
+
+    // - sub function for all operations: tells if key is in the range of shard s, lock of s must be held
+    bool owns(int s, const key_type& key);
+
+    // - sub function for all operations: locks the shard of key and returns it (retries if a rebalance moved the key away)
+    int lock_shard_of(const key_type& key);
+
+    // - sub function for all operations: counts an operation of locked shard s, returns true if it's due for rebalance
+    bool count_op(int s);
+
+    /** - sub function for all operations: rebalances busy shard s with its lighter neighbor
+     * moves the edge keys of s so that the loads seen since the last rebalance would have been even
+     */
+    void rebalance_around(int s);
+
+    // -- sub function for rebalance_around: moves the k biggest nodes of shard s to shard s+1, both locked
+    void move_to_right(int s, int k);
+
+    // -- sub function for rebalance_around: moves the k smallest nodes of shard s to shard s-1, both locked
+    void move_to_left(int s, int k);
+
+    // - sub function for the neighbor queries: locks shards first..last in order
+    void lock_span(int first, int last);
+
+    // - sub function for the neighbor queries: unlocks shards first..last
+    void unlock_span(int first, int last);
+
+    int num_of_shards;
+    typename tree_type::allocator_type retired_slabs;   // slabs of shards that gave nodes away, see move_to_right
+    std::mutex retired_lock;                            // guards retired_slabs, rebalances of other shards run meanwhile
+    std::unique_ptr<Shard[]> shards;
+    std::unique_ptr<std::atomic<key_type>[]> lows;  // low boundary of every used shard, lows[0] is unused
+    std::atomic<int> num_of_used_shards;            // shards from this one on are empty and get no keys
+
+    static const long REBALANCE_PERIOD = 1 << 14;  // operations of a shard between looks at its load
+    static const int LOAD_RATIO = 2;               // a shard gives keys to a neighbor with less than 1/2 of its load
+    static const int MIN_SHARD_SIZE = 64;          // smaller shards don't give keys away
+
+public:
+    /** constructor - num_of_shards 0 uses a shard per core
+     * key_type must be trivially copyable (the boundaries are atomic) and ordered by '<' like template condition
+     */
+    explicit ShardedAVLTree(int num_of_shards = 0);
+
+    ShardedAVLTree(const ShardedAVLTree&) = delete;
+    ShardedAVLTree& operator=(const ShardedAVLTree&) = delete;
+
+    /** builds tree from sorted array without duplicates, split evenly between all shards
+     * replaces the nodes the tree had - no other thread may use the tree meanwhile
+     */
+    void build_from_array(ptr_type** data_array, int size);
+
+    /** inserts a new node to the tree
+     * returns true - if node is created
+     * returns false - if node already exists
+     */
+    bool insert(ptr_type* data);
+
+    /** removes the node that points to 'data'
+     * returns true - if node is found and removed
+     * returns false - if node doesn't exist
+     */
+    bool remove(ptr_type* data);
+
+    /** removes the node that points to 'data' and calls its destructor
+     * returns true - if node is found and removed, and data is erased
+     * returns false - if node doesn't exist
+     */
+    bool remove_and_erase(ptr_type* data);
+
+    /** returns the data of the node that is equal to 'data'
+     *  returns nullptr - if node doesn't exist
+     */
+    ptr_type* search(ptr_type* data);
+
+    /**
+     * returns the data of the closest left neighbor node (smaller then the node), searching the shards to the left
+     * 'data' doesn't have to be in the tree
+     * returns nullptr - if doesn't exist
+     */
+    ptr_type* get_closest_left(ptr_type* data);
+
+    /**
+     * returns the data of the closest right neighbor node (bigger then the node), searching the shards to the right
+     * 'data' doesn't have to be in the tree
+     * returns nullptr - if doesn't exist
+     */
+    ptr_type* get_closest_right(ptr_type* data);
+
+    /** calls visitor(data) for every node between 'lo' and 'hi' (both included), by order
+     * the shards are locked hand over hand, so a rebalance can't make a node be visited twice or skipped -
+     * the visitor must not call the tree
+     */
+    template <class visitor_type>
+    void for_each_in_range(ptr_type* lo, ptr_type* hi, visitor_type visitor);
+
+    // returns how many nodes the tree consists (the shards are counted one after the other)
+    int get_num_of_nodes();
+
+    // returns how many shards the tree has
+    int get_num_of_shards();
+
+    // returns how many nodes shard s holds
+    int get_shard_size(int s);
+
+    // destructor - DOES NOT erase the data pointed to, no other thread may use the tree
+    ~ShardedAVLTree() = default;
+};
+
+
+/******************************************************* routing functions *******************************************************/
+
+
+template <class ptr_type, class condition, class key_extractor>
+ShardedAVLTree<ptr_type, condition, key_extractor>::ShardedAVLTree(int num_of_shards) :
+        num_of_shards(avl_resolve_num_of_threads(num_of_shards)),
+        shards(new Shard[this->num_of_shards]),
+        lows(new std::atomic<key_type>[this->num_of_shards]),
+        num_of_used_shards(1)
+{
+}
+
+
+template <class ptr_type, class condition, class key_extractor>
+int ShardedAVLTree<ptr_type, condition, key_extractor>::find_shard(const key_type& key)
+{
+    // the last used shard whose low boundary isn't bigger than key
+    int lo = 0;
+    int hi = num_of_used_shards.load() - 1;
+    while (lo < hi)
+    {
+        int mid = (lo + hi + 1) / 2;
+        if (key < lows[mid].load())
+        {
+            hi = mid - 1;
+        }
+        else
+        {
+            lo = mid;
+        }
+    }
+    return lo;
+}
+
+
+template <class ptr_type, class condition, class key_extractor>
+bool ShardedAVLTree<ptr_type, condition, key_extractor>::owns(int s, const key_type& key)
+{
+    // the boundaries of s only move while s is locked, and the last used shard stays last while it's locked
+    if (s > 0 && key < lows[s].load())
+    {
+        return false;
+    }
+    return s + 1 >= num_of_used_shards.load() || key < lows[s + 1].load();
+}
+
+
+template <class ptr_type, class condition, class key_extractor>
+int ShardedAVLTree<ptr_type, condition, key_extractor>::lock_shard_of(const key_type& key)
+{
+    while (true)
+    {
+        int s = find_shard(key);
+        shards[s].lock.lock();
+        if (owns(s, key))
+        {
+            return s;
+        }
+        shards[s].lock.unlock();
+    }
+}
+
+
+template <class ptr_type, class condition, class key_extractor>
+bool ShardedAVLTree<ptr_type, condition, key_extractor>::count_op(int s)
+{
+    return ++shards[s].ops >= REBALANCE_PERIOD && num_of_shards > 1;
+}
+
+
+template <class ptr_type, class condition, class key_extractor>
+void ShardedAVLTree<ptr_type, condition, key_extractor>::lock_span(int first, int last)
+{
+    for (int s = first; s <= last; s++)
+    {
+        shards[s].lock.lock();
+    }
+}
+
+
+template <class ptr_type, class condition, class key_extractor>
+void ShardedAVLTree<ptr_type, condition, key_extractor>::unlock_span(int first, int last)
+{
+    for (int s = first; s <= last; s++)
+    {
+        shards[s].lock.unlock();
+    }
+}
+
+
+/******************************************************* rebalance functions *******************************************************/
+
+
+template <class ptr_type, class condition, class key_extractor>
+void ShardedAVLTree<ptr_type, condition, key_extractor>::rebalance_around(int s)
+{
+    int first = (s > 0) ? s - 1 : s;
+    int last = (s + 1 < num_of_shards) ? s + 1 : s;
+    lock_span(first, last);
+    if (shards[s].ops < REBALANCE_PERIOD)
+    {
+        // another thread rebalanced s meanwhile
+        unlock_span(first, last);
+        return;
+    }
+    // a shard that isn't used yet has no load - the last used shard opens it
+    int used = num_of_used_shards.load();
+    long left_ops = (first < s) ? shards[first].ops : -1;
+    long right_ops = (last > s) ? (last < used ? shards[last].ops : 0) : -1;
+    int target = s;
+    if (left_ops >= 0 && (right_ops < 0 || left_ops < right_ops))
+    {
+        target = first;
+    }
+    else if (right_ops >= 0)
+    {
+        target = last;
+    }
+    long ops = shards[s].ops;
+    long target_ops = shards[target].ops;
+    int size = shards[s].tree.get_num_of_nodes();
+    if (target != s && ops > LOAD_RATIO * target_ops && size >= MIN_SHARD_SIZE)
+    {
+        // keys of s are assumed to share its load evenly
+        int k = static_cast<int>(size * (ops - target_ops) / (2 * ops));
+        if (k > 0)
+        {
+            if (target > s)
+            {
+                move_to_right(s, k);
+            }
+            else
+            {
+                move_to_left(s, k);
+            }
+        }
+        shards[target].ops = 0;
+    }
+    shards[s].ops = 0;
+    unlock_span(first, last);
+}
+
+
+template <class ptr_type, class condition, class key_extractor>
+void ShardedAVLTree<ptr_type, condition, key_extractor>::move_to_right(int s, int k)
+{
+    tree_type& from = shards[s].tree;
+    tree_type& to = shards[s + 1].tree;
+    ptr_type* boundary = from.select(from.get_num_of_nodes() - k)->data;
+    key_extractor extract;
+    key_type boundary_key = extract(boundary);
+    {
+        /** split and join relink the nodes in O(log n) without copying them - the pools of the shards stay apart:
+         * the pool of a shard only holds slabs whose nodes are all in the shard, so the shard can release them at once
+         * the moved nodes share slabs with nodes of s, so those slabs go to retired_slabs first and 'moved' gets
+         * a pool of its own, which s+1 absorbs in the join - both in O(1), and no pool is shared between shards
+         */
+        tree_type moved;
+        from.split(boundary, from, moved);
+        {
+            std::lock_guard<std::mutex> guard(retired_lock);
+            moved.hand_slabs_to(retired_slabs);
+        }
+        to.join(moved, nullptr, to);
+    }
+    lows[s + 1].store(boundary_key);
+    if (s + 1 == num_of_used_shards.load())
+    {
+        num_of_used_shards.store(s + 2);
+    }
+}
+
+
+template <class ptr_type, class condition, class key_extractor>
+void ShardedAVLTree<ptr_type, condition, key_extractor>::move_to_left(int s, int k)
+{
+    tree_type& from = shards[s].tree;
+    tree_type& to = shards[s - 1].tree;
+    ptr_type* boundary = from.select(k)->data;
+    key_extractor extract;
+    key_type boundary_key = extract(boundary);
+    {
+        // relinks the nodes without copying them and keeps the pools apart, like move_to_right
+        tree_type moved;
+        from.split(boundary, moved, from);
+        {
+            std::lock_guard<std::mutex> guard(retired_lock);
+            moved.hand_slabs_to(retired_slabs);
+        }
+        to.join(to, nullptr, moved);
+    }
+    lows[s].store(boundary_key);
+}
+
+
+/******************************************************* tree functions *******************************************************/
+
+
+template <class ptr_type, class condition, class key_extractor>
+void ShardedAVLTree<ptr_type, condition, key_extractor>::build_from_array(ptr_type** data_array, int size)
+{
+    if (size < 1 || data_array == nullptr)
+    {
+        return;
+    }
+    key_extractor extract;
+    int used = (size < num_of_shards) ? size : num_of_shards;
+    for (int s = 0; s < num_of_shards; s++)
+    {
+        int start = static_cast<int>(static_cast<long>(size) * s / used);
+        int end = static_cast<int>(static_cast<long>(size) * (s + 1) / used);
+        if (s < used)
+        {
+            shards[s].tree.build_from_array(data_array + start, end - start);
+            lows[s].store(extract(data_array[start]));
+        }
+        else
+        {
+            // drops the nodes the shard had
+            shards[s].tree = tree_type();
+        }
+        shards[s].ops = 0;
+    }
+    // every shard released its pool and the nodes it had in retired slabs are gone, so the retired slabs go too
+    retired_slabs.release();
+    num_of_used_shards.store(used);
+}
+
+
+template <class ptr_type, class condition, class key_extractor>
+bool ShardedAVLTree<ptr_type, condition, key_extractor>::insert(ptr_type* data)
+{
+    key_extractor extract;
+    int s = lock_shard_of(extract(data));
+    bool inserted = shards[s].tree.insert(data) != nullptr;
+    bool busy = count_op(s);
+    shards[s].lock.unlock();
+    if (busy)
+    {
+        rebalance_around(s);
+    }
+    return inserted;
+}
+
+
+template <class ptr_type, class condition, class key_extractor>
+bool ShardedAVLTree<ptr_type, condition, key_extractor>::remove(ptr_type* data)
+{
+    key_extractor extract;
+    int s = lock_shard_of(extract(data));
+    bool removed = shards[s].tree.remove(data);
+    bool busy = count_op(s);
+    shards[s].lock.unlock();
+    if (busy)
+    {
+        rebalance_around(s);
+    }
+    return removed;
+}
+
+
+template <class ptr_type, class condition, class key_extractor>
+bool ShardedAVLTree<ptr_type, condition, key_extractor>::remove_and_erase(ptr_type* data)
+{
+    key_extractor extract;
+    int s = lock_shard_of(extract(data));
+    bool removed = shards[s].tree.remove_and_erase(data);
+    bool busy = count_op(s);
+    shards[s].lock.unlock();
+    if (busy)
+    {
+        rebalance_around(s);
+    }
+    return removed;
+}
+
+
+template <class ptr_type, class condition, class key_extractor>
+ptr_type* ShardedAVLTree<ptr_type, condition, key_extractor>::search(ptr_type* data)
+{
+    key_extractor extract;
+    int s = lock_shard_of(extract(data));
+    typename tree_type::node_type* found = shards[s].tree.search(data);
+    ptr_type* result = (found == nullptr) ? nullptr : found->data;
+    bool busy = count_op(s);
+    shards[s].lock.unlock();
+    if (busy)
+    {
+        rebalance_around(s);
+    }
+    return result;
+}
+
+
+template <class ptr_type, class condition, class key_extractor>
+ptr_type* ShardedAVLTree<ptr_type, condition, key_extractor>::get_closest_left(ptr_type* data)
+{
+    key_extractor extract;
+    key_type key = extract(data);
+    // shards are locked from left to right like the rebalance does, so the span is widened by relocking it
+    for (int extra = 0; ; extra++)
+    {
+        int s = find_shard(key);
+        int first = (s > extra) ? s - extra : 0;
+        lock_span(first, s);
+        if (!owns(s, key))
+        {
+            unlock_span(first, s);
+            extra--;
+            continue;
+        }
+        typename tree_type::iterator next = shards[s].tree.lower_bound(data);
+        typename tree_type::node_type* found = (next == shards[s].tree.begin()) ? nullptr : (--next).get_node();
+        for (int t = s - 1; found == nullptr && t >= first; t--)
+        {
+            found = shards[t].tree.get_max_node();
+        }
+        ptr_type* result = (found == nullptr) ? nullptr : found->data;
+        unlock_span(first, s);
+        if (result != nullptr || first == 0)
+        {
+            return result;
+        }
+    }
+}
+
+
+template <class ptr_type, class condition, class key_extractor>
+ptr_type* ShardedAVLTree<ptr_type, condition, key_extractor>::get_closest_right(ptr_type* data)
+{
+    key_extractor extract;
+    key_type key = extract(data);
+    for (int extra = 0; ; extra++)
+    {
+        int s = find_shard(key);
+        int used = num_of_used_shards.load();
+        int last = (s + extra < used) ? s + extra : used - 1;
+        lock_span(s, last);
+        if (!owns(s, key))
+        {
+            unlock_span(s, last);
+            extra--;
+            continue;
+        }
+        typename tree_type::node_type* found = shards[s].tree.upper_bound(data).get_node();
+        for (int t = s + 1; found == nullptr && t <= last; t++)
+        {
+            found = shards[t].tree.get_min_node();
+        }
+        ptr_type* result = (found == nullptr) ? nullptr : found->data;
+        // the last used shard can't change while it's locked, so if it was searched there is nothing further right
+        bool searched_all = last + 1 >= num_of_used_shards.load();
+        unlock_span(s, last);
+        if (result != nullptr || searched_all)
+        {
+            return result;
+        }
+    }
+}
+
+
+template <class ptr_type, class condition, class key_extractor>
+template <class visitor_type>
+void ShardedAVLTree<ptr_type, condition, key_extractor>::for_each_in_range(ptr_type* lo, ptr_type* hi, visitor_type visitor)
+{
+    key_extractor extract;
+    key_type hi_key = extract(hi);
+    int s = lock_shard_of(extract(lo));
+    while (true)
+    {
+        shards[s].tree.for_each_in_range(lo, hi, visitor);
+        // the next shard is locked before this one is let go, so no rebalance can move nodes across the edge meanwhile
+        if (s + 1 >= num_of_used_shards.load() || hi_key < lows[s + 1].load())
+        {
+            shards[s].lock.unlock();
+            return;
+        }
+        shards[s + 1].lock.lock();
+        shards[s].lock.unlock();
+        s++;
+    }
+}
+
+
+template <class ptr_type, class condition, class key_extractor>
+int ShardedAVLTree<ptr_type, condition, key_extractor>::get_num_of_nodes()
+{
+    int total = 0;
+    for (int s = 0; s < num_of_shards; s++)
+    {
+        total += get_shard_size(s);
+    }
+    return total;
+}
+
+
+template <class ptr_type, class condition, class key_extractor>
+int ShardedAVLTree<ptr_type, condition, key_extractor>::get_num_of_shards()
+{
+    return num_of_shards;
+}
+
+
+template <class ptr_type, class condition, class key_extractor>
+int ShardedAVLTree<ptr_type, condition, key_extractor>::get_shard_size(int s)
+{
+    std::lock_guard<std::mutex> lock(shards[s].lock);
+    return shards[s].tree.get_num_of_nodes();
+}
+
+#endif //AVL_SHARDEDAVLTREE_H
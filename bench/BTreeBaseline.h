@@ -0,0 +1,548 @@
+#ifndef AVL_BENCH_BTREEBASELINE_H
+#define AVL_BENCH_BTREEBASELINE_H
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+
+
+/** B-tree map baseline for the benchmark suite (bench_suite.cpp)
+ * a textbook B-tree of minimum degree 'degree' (CLRS): every node but the root holds degree-1 to 2*degree-1 keys,
+ * inserts split full nodes on the way down and removes fill minimal nodes on the way down, so both are one descent
+ * keys and values are kept in separate arrays of the node so the binary search of a node touches only the keys,
+ * and leaves are allocated without the children array
+ * 'less' is a strict weak order on key_type (called as less(a, b))
+ */
+template <class key_type, class value_type, class less, int degree = 16>
+class BTreeBaseline
+{
+private:
+    static const int MAX_KEYS = 2 * degree - 1;
+
+    struct Node
+    {
+        int n;
+        bool leaf;
+        key_type keys[MAX_KEYS];
+        value_type values[MAX_KEYS];
+        Node* children[MAX_KEYS + 1];     // not allocated for leaves
+    };
+
+    // - sub function for all: allocates a node, leaves without the children array
+    static Node* new_node(bool leaf);
+
+    // - sub function for the destructor and build_sorted: frees the subtree of r
+    static void free_nodes(Node* r);
+
+    // - sub function for all: returns the place of the first key of r that is not smaller than key
+    int lower_bound(const Node* r, const key_type& key) const;
+
+    // - sub function for insert: splits the full child i of r around its median, which moves up to r
+    static void split_child(Node* r, int i);
+
+    // - sub function for erase: merges child i+1 and key i of r into child i
+    static void merge_children(Node* r, int i);
+
+    // - sub function for erase: makes child i of r hold at least degree keys, returns the child that now covers i
+    int fill_child(Node* r, int i);
+
+    // - sub function for erase: removes key from the subtree of r, which holds at least degree keys (or is the root)
+    bool erase_from(Node* r, const key_type& key);
+
+    // - sub function for build_sorted: builds a subtree of the given height from keys[start..end)
+    static Node* build_nodes(const key_type* keys, const value_type* values, size_t start, size_t end, int height);
+
+    // - sub function for for_each: visits the subtree of r by order
+    template <class visitor_type>
+    static void for_each_in(const Node* r, visitor_type& visitor);
+
+    Node* root;
+    size_t num_of_keys;
+    less cond;
+
+public:
+    // constructor of an empty tree
+    BTreeBaseline() : root(nullptr), num_of_keys(0) {}
+
+    BTreeBaseline(const BTreeBaseline&) = delete;
+    BTreeBaseline& operator=(const BTreeBaseline&) = delete;
+
+    // returns how many keys the tree holds
+    size_t size() const;
+
+    /** inserts key with value
+     * returns false - if key already exists (nothing changes)
+     */
+    bool insert(const key_type& key, const value_type& value);
+
+    /** removes key
+     * returns false - if key doesn't exist
+     */
+    bool erase(const key_type& key);
+
+    // returns the value of key, nullptr if key doesn't exist
+    value_type* find(const key_type& key);
+
+    // returns the value of the biggest key smaller than key, nullptr if none
+    value_type* predecessor(const key_type& key);
+
+    // returns the value of the smallest key bigger than key, nullptr if none
+    value_type* successor(const key_type& key);
+
+    // calls visitor(key, value) for every key by order
+    template <class visitor_type>
+    void for_each(visitor_type visitor) const;
+
+    // replaces the tree with the n keys (sorted, distinct) and their values, in O(n)
+    void build_sorted(const key_type* keys, const value_type* values, size_t n);
+
+    // destructor
+    ~BTreeBaseline();
+};
+
+
+/******************************************************* node functions *******************************************************/
+
+
+template <class key_type, class value_type, class less, int degree>
+typename BTreeBaseline<key_type, value_type, less, degree>::Node* BTreeBaseline<key_type, value_type, less, degree>::new_node(bool leaf)
+{
+    Node* r = static_cast<Node*>(::operator new(leaf ? offsetof(Node, children) : sizeof(Node)));
+    r->n = 0;
+    r->leaf = leaf;
+    return r;
+}
+
+
+template <class key_type, class value_type, class less, int degree>
+void BTreeBaseline<key_type, value_type, less, degree>::free_nodes(Node* r)
+{
+    if (r == nullptr)
+    {
+        return;
+    }
+    if (!r->leaf)
+    {
+        for (int i = 0; i <= r->n; i++)
+        {
+            free_nodes(r->children[i]);
+        }
+    }
+    ::operator delete(r);
+}
+
+
+template <class key_type, class value_type, class less, int degree>
+int BTreeBaseline<key_type, value_type, less, degree>::lower_bound(const Node* r, const key_type& key) const
+{
+    int low = 0;
+    int high = r->n;
+    while (low < high)
+    {
+        int middle = (low + high) / 2;
+        if (cond(r->keys[middle], key))
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+
+template <class key_type, class value_type, class less, int degree>
+void BTreeBaseline<key_type, value_type, less, degree>::split_child(Node* r, int i)
+{
+    Node* full = r->children[i];
+    Node* half = new_node(full->leaf);
+    half->n = degree - 1;
+    std::memcpy(half->keys, full->keys + degree, sizeof(key_type) * (degree - 1));
+    std::memcpy(half->values, full->values + degree, sizeof(value_type) * (degree - 1));
+    if (!full->leaf)
+    {
+        std::memcpy(half->children, full->children + degree, sizeof(Node*) * degree);
+    }
+    full->n = degree - 1;
+    std::memmove(r->children + i + 2, r->children + i + 1, sizeof(Node*) * (r->n - i));
+    std::memmove(r->keys + i + 1, r->keys + i, sizeof(key_type) * (r->n - i));
+    std::memmove(r->values + i + 1, r->values + i, sizeof(value_type) * (r->n - i));
+    r->children[i + 1] = half;
+    r->keys[i] = full->keys[degree - 1];
+    r->values[i] = full->values[degree - 1];
+    r->n++;
+}
+
+
+template <class key_type, class value_type, class less, int degree>
+void BTreeBaseline<key_type, value_type, less, degree>::merge_children(Node* r, int i)
+{
+    Node* left = r->children[i];
+    Node* right = r->children[i + 1];
+    left->keys[left->n] = r->keys[i];
+    left->values[left->n] = r->values[i];
+    std::memcpy(left->keys + left->n + 1, right->keys, sizeof(key_type) * right->n);
+    std::memcpy(left->values + left->n + 1, right->values, sizeof(value_type) * right->n);
+    if (!left->leaf)
+    {
+        std::memcpy(left->children + left->n + 1, right->children, sizeof(Node*) * (right->n + 1));
+    }
+    left->n += right->n + 1;
+    std::memmove(r->keys + i, r->keys + i + 1, sizeof(key_type) * (r->n - i - 1));
+    std::memmove(r->values + i, r->values + i + 1, sizeof(value_type) * (r->n - i - 1));
+    std::memmove(r->children + i + 1, r->children + i + 2, sizeof(Node*) * (r->n - i - 1));
+    r->n--;
+    ::operator delete(right);
+}
+
+
+template <class key_type, class value_type, class less, int degree>
+int BTreeBaseline<key_type, value_type, less, degree>::fill_child(Node* r, int i)
+{
+    Node* child = r->children[i];
+    if (i > 0 && r->children[i - 1]->n >= degree)
+    {
+        // borrows the last key of the left sibling through r
+        Node* left = r->children[i - 1];
+        std::memmove(child->keys + 1, child->keys, sizeof(key_type) * child->n);
+        std::memmove(child->values + 1, child->values, sizeof(value_type) * child->n);
+        if (!child->leaf)
+        {
+            std::memmove(child->children + 1, child->children, sizeof(Node*) * (child->n + 1));
+            child->children[0] = left->children[left->n];
+        }
+        child->keys[0] = r->keys[i - 1];
+        child->values[0] = r->values[i - 1];
+        r->keys[i - 1] = left->keys[left->n - 1];
+        r->values[i - 1] = left->values[left->n - 1];
+        left->n--;
+        child->n++;
+        return i;
+    }
+    if (i < r->n && r->children[i + 1]->n >= degree)
+    {
+        // borrows the first key of the right sibling through r
+        Node* right = r->children[i + 1];
+        child->keys[child->n] = r->keys[i];
+        child->values[child->n] = r->values[i];
+        if (!child->leaf)
+        {
+            child->children[child->n + 1] = right->children[0];
+            std::memmove(right->children, right->children + 1, sizeof(Node*) * right->n);
+        }
+        r->keys[i] = right->keys[0];
+        r->values[i] = right->values[0];
+        std::memmove(right->keys, right->keys + 1, sizeof(key_type) * (right->n - 1));
+        std::memmove(right->values, right->values + 1, sizeof(value_type) * (right->n - 1));
+        right->n--;
+        child->n++;
+        return i;
+    }
+    if (i < r->n)
+    {
+        merge_children(r, i);
+        return i;
+    }
+    merge_children(r, i - 1);
+    return i - 1;
+}
+
+
+template <class key_type, class value_type, class less, int degree>
+bool BTreeBaseline<key_type, value_type, less, degree>::erase_from(Node* r, const key_type& key)
+{
+    while (true)
+    {
+        int i = lower_bound(r, key);
+        bool found = i < r->n && !cond(key, r->keys[i]);
+        if (found && r->leaf)
+        {
+            std::memmove(r->keys + i, r->keys + i + 1, sizeof(key_type) * (r->n - i - 1));
+            std::memmove(r->values + i, r->values + i + 1, sizeof(value_type) * (r->n - i - 1));
+            r->n--;
+            return true;
+        }
+        if (found)
+        {
+            // replaces the key by its predecessor or successor from a child that can spare one, or merges around it
+            Node* left = r->children[i];
+            Node* right = r->children[i + 1];
+            if (left->n >= degree)
+            {
+                Node* last = left;
+                while (!last->leaf)
+                {
+                    last = last->children[last->n];
+                }
+                r->keys[i] = last->keys[last->n - 1];
+                r->values[i] = last->values[last->n - 1];
+                return erase_from(left, r->keys[i]);
+            }
+            if (right->n >= degree)
+            {
+                Node* first = right;
+                while (!first->leaf)
+                {
+                    first = first->children[0];
+                }
+                r->keys[i] = first->keys[0];
+                r->values[i] = first->values[0];
+                return erase_from(right, r->keys[i]);
+            }
+            merge_children(r, i);
+            r = left;
+            continue;
+        }
+        if (r->leaf)
+        {
+            return false;
+        }
+        if (r->children[i]->n < degree)
+        {
+            i = fill_child(r, i);
+        }
+        r = r->children[i];
+    }
+}
+
+
+template <class key_type, class value_type, class less, int degree>
+typename BTreeBaseline<key_type, value_type, less, degree>::Node* BTreeBaseline<key_type, value_type, less, degree>::build_nodes(const key_type* keys, const value_type* values, size_t start, size_t end, int height)
+{
+    size_t count = end - start;
+    Node* r = new_node(height == 0);
+    if (height == 0)
+    {
+        std::memcpy(r->keys, keys + start, sizeof(key_type) * count);
+        std::memcpy(r->values, values + start, sizeof(value_type) * count);
+        r->n = static_cast<int>(count);
+        return r;
+    }
+    // the fewest children that fit the keys, with the keys spread evenly over them
+    size_t child_capacity = MAX_KEYS;
+    for (int h = 1; h < height; h++)
+    {
+        child_capacity = child_capacity * (MAX_KEYS + 1) + MAX_KEYS;
+    }
+    size_t num_of_children = (count + 1 + child_capacity) / (child_capacity + 1);
+    if (num_of_children < 2)
+    {
+        num_of_children = 2;
+    }
+    size_t in_children = count - (num_of_children - 1);
+    size_t position = start;
+    for (size_t j = 0; j < num_of_children; j++)
+    {
+        size_t child_size = in_children / num_of_children + (j < in_children % num_of_children ? 1 : 0);
+        r->children[j] = build_nodes(keys, values, position, position + child_size, height - 1);
+        position += child_size;
+        if (j + 1 < num_of_children)
+        {
+            r->keys[j] = keys[position];
+            r->values[j] = values[position];
+            position++;
+        }
+    }
+    r->n = static_cast<int>(num_of_children - 1);
+    return r;
+}
+
+
+template <class key_type, class value_type, class less, int degree>
+template <class visitor_type>
+void BTreeBaseline<key_type, value_type, less, degree>::for_each_in(const Node* r, visitor_type& visitor)
+{
+    for (int i = 0; i < r->n; i++)
+    {
+        if (!r->leaf)
+        {
+            for_each_in(r->children[i], visitor);
+        }
+        visitor(r->keys[i], r->values[i]);
+    }
+    if (!r->leaf)
+    {
+        for_each_in(r->children[r->n], visitor);
+    }
+}
+
+
+/******************************************************* tree functions *******************************************************/
+
+
+template <class key_type, class value_type, class less, int degree>
+size_t BTreeBaseline<key_type, value_type, less, degree>::size() const
+{
+    return num_of_keys;
+}
+
+
+template <class key_type, class value_type, class less, int degree>
+bool BTreeBaseline<key_type, value_type, less, degree>::insert(const key_type& key, const value_type& value)
+{
+    if (root == nullptr)
+    {
+        root = new_node(true);
+    }
+    if (root->n == MAX_KEYS)
+    {
+        Node* old_root = root;
+        root = new_node(false);
+        root->children[0] = old_root;
+        split_child(root, 0);
+    }
+    Node* r = root;
+    while (true)
+    {
+        int i = lower_bound(r, key);
+        if (i < r->n && !cond(key, r->keys[i]))
+        {
+            return false;
+        }
+        if (r->leaf)
+        {
+            std::memmove(r->keys + i + 1, r->keys + i, sizeof(key_type) * (r->n - i));
+            std::memmove(r->values + i + 1, r->values + i, sizeof(value_type) * (r->n - i));
+            r->keys[i] = key;
+            r->values[i] = value;
+            r->n++;
+            num_of_keys++;
+            return true;
+        }
+        if (r->children[i]->n == MAX_KEYS)
+        {
+            split_child(r, i);
+            if (cond(r->keys[i], key))
+            {
+                i++;
+            }
+            else if (!cond(key, r->keys[i]))
+            {
+                return false;
+            }
+        }
+        r = r->children[i];
+    }
+}
+
+
+template <class key_type, class value_type, class less, int degree>
+bool BTreeBaseline<key_type, value_type, less, degree>::erase(const key_type& key)
+{
+    if (root == nullptr)
+    {
+        return false;
+    }
+    bool erased = erase_from(root, key);
+    // the descent may have merged the only two children of the root, even if key wasn't found
+    if (root->n == 0 && !root->leaf)
+    {
+        Node* old_root = root;
+        root = root->children[0];
+        ::operator delete(old_root);
+    }
+    if (erased)
+    {
+        num_of_keys--;
+    }
+    return erased;
+}
+
+
+template <class key_type, class value_type, class less, int degree>
+value_type* BTreeBaseline<key_type, value_type, less, degree>::find(const key_type& key)
+{
+    Node* r = root;
+    while (r != nullptr)
+    {
+        int i = lower_bound(r, key);
+        if (i < r->n && !cond(key, r->keys[i]))
+        {
+            return &r->values[i];
+        }
+        r = r->leaf ? nullptr : r->children[i];
+    }
+    return nullptr;
+}
+
+
+template <class key_type, class value_type, class less, int degree>
+value_type* BTreeBaseline<key_type, value_type, less, degree>::predecessor(const key_type& key)
+{
+    value_type* result = nullptr;
+    Node* r = root;
+    while (r != nullptr)
+    {
+        int i = lower_bound(r, key);
+        if (i > 0)
+        {
+            result = &r->values[i - 1];
+        }
+        r = r->leaf ? nullptr : r->children[i];
+    }
+    return result;
+}
+
+
+template <class key_type, class value_type, class less, int degree>
+value_type* BTreeBaseline<key_type, value_type, less, degree>::successor(const key_type& key)
+{
+    value_type* result = nullptr;
+    Node* r = root;
+    while (r != nullptr)
+    {
+        int i = lower_bound(r, key);
+        if (i < r->n && !cond(key, r->keys[i]))
+        {
+            i++;
+        }
+        if (i < r->n)
+        {
+            result = &r->values[i];
+        }
+        r = r->leaf ? nullptr : r->children[i];
+    }
+    return result;
+}
+
+
+template <class key_type, class value_type, class less, int degree>
+template <class visitor_type>
+void BTreeBaseline<key_type, value_type, less, degree>::for_each(visitor_type visitor) const
+{
+    if (root != nullptr)
+    {
+        for_each_in(root, visitor);
+    }
+}
+
+
+template <class key_type, class value_type, class less, int degree>
+void BTreeBaseline<key_type, value_type, less, degree>::build_sorted(const key_type* keys, const value_type* values, size_t n)
+{
+    free_nodes(root);
+    root = nullptr;
+    num_of_keys = n;
+    if (n == 0)
+    {
+        return;
+    }
+    // the lowest height whose full tree holds n keys
+    int height = 0;
+    for (size_t capacity = MAX_KEYS; capacity < n; capacity = capacity * (MAX_KEYS + 1) + MAX_KEYS)
+    {
+        height++;
+    }
+    root = build_nodes(keys, values, 0, n, height);
+}
+
+
+template <class key_type, class value_type, class less, int degree>
+BTreeBaseline<key_type, value_type, less, degree>::~BTreeBaseline()
+{
+    free_nodes(root);
+}
+
+#endif //AVL_BENCH_BTREEBASELINE_H
@@ -0,0 +1,142 @@
+// benchmark for the augmented AVLTree: sums over key ranges by aggregate() against scanning inorder(),
+// and what keeping the summaries costs insert and remove
+//
+// build: g++ -O2 -std=c++17 -I.. bench_aggregate.cpp -o bench_aggregate
+// run:   ./bench_aggregate [num_of_keys] [num_of_queries]
+
+#include "../AVLTree.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+
+struct Key
+{
+    long value;
+};
+
+struct KeyCondition
+{
+    Comparison operator()(const Key* a, const Key* b) const
+    {
+        if (a->value < b->value)
+        {
+            return Comparison::LESS_THAN;
+        }
+        if (a->value > b->value)
+        {
+            return Comparison::GREATER_THAN;
+        }
+        return Comparison::EQUAL;
+    }
+};
+
+struct KeySum
+{
+    using summary_type = long;
+
+    static long identity()
+    {
+        return 0;
+    }
+
+    static long summarize(const Key* key)
+    {
+        return key->value;
+    }
+
+    static long combine(const long& smaller, const long& bigger)
+    {
+        return smaller + bigger;
+    }
+};
+
+typedef AVLTree<Key, KeyCondition> PlainTree;
+typedef AVLTree<Key, KeyCondition, AVLNodePool, void, KeySum> SumTree;
+
+
+static double elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+// inserts every key in random order, then removes half of them, returns ns/op
+template <class tree_type>
+static double measure_updates(tree_type& tree, std::vector<Key>& keys, const std::vector<long>& order)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (long i : order)
+    {
+        tree.insert(&keys[i]);
+    }
+    for (size_t i = 0; i < order.size(); i += 2)
+    {
+        tree.remove(&keys[order[i]]);
+    }
+    return elapsed_ns(start) / (order.size() + order.size() / 2);
+}
+
+
+int main(int argc, char** argv)
+{
+    long n = argc > 1 ? std::atol(argv[1]) : 1000000;
+    int queries = argc > 2 ? std::atoi(argv[2]) : 100;
+    std::vector<Key> keys(n);
+    std::vector<long> order(n);
+    for (long i = 0; i < n; i++)
+    {
+        keys[i].value = i;
+        order[i] = i;
+    }
+    std::mt19937_64 rng(11);
+    std::shuffle(order.begin(), order.end(), rng);
+
+    PlainTree plain;
+    SumTree summed;
+    std::printf("%-34s %12.1f ns/op\n", "insert+remove, no augmentation", measure_updates(plain, keys, order));
+    std::printf("%-34s %12.1f ns/op\n", "insert+remove, sum augmentation", measure_updates(summed, keys, order));
+
+    std::vector<long> bounds(2 * queries);
+    for (long& bound : bounds)
+    {
+        bound = static_cast<long>(rng() % n);
+    }
+
+    long check = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int q = 0; q < queries; q++)
+    {
+        long lo = std::min(bounds[2 * q], bounds[2 * q + 1]);
+        long hi = std::max(bounds[2 * q], bounds[2 * q + 1]);
+        Key** all = plain.inorder();
+        for (int i = 0; i < plain.get_num_of_nodes(); i++)
+        {
+            if (all[i]->value >= lo && all[i]->value <= hi)
+            {
+                check += all[i]->value;
+            }
+        }
+        delete[] all;
+    }
+    std::printf("%-34s %12.1f ns/query\n", "inorder() + scan", elapsed_ns(start) / queries);
+
+    start = std::chrono::steady_clock::now();
+    for (int q = 0; q < queries; q++)
+    {
+        long lo = std::min(bounds[2 * q], bounds[2 * q + 1]);
+        long hi = std::max(bounds[2 * q], bounds[2 * q + 1]);
+        check -= summed.aggregate(&keys[lo], &keys[hi]);
+    }
+    std::printf("%-34s %12.1f ns/query\n", "aggregate(lo, hi)", elapsed_ns(start) / queries);
+    if (check != 0)
+    {
+        std::printf("MISMATCH between the scan and aggregate\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,106 @@
+// benchmark for cached keys: lookup latency of AVLTree with and without a key extractor
+// the data objects are allocated one by one, so comparing through 'data' costs a pointer chase per level
+//
+// build: g++ -O2 -std=c++17 -I.. bench_cached_keys.cpp -o bench_cached_keys
+// run:   ./bench_cached_keys [num_of_keys] (10M by default)
+
+#include "../AVLTree.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+
+struct Record
+{
+    long id;
+    char payload[56];
+};
+
+struct RecordCondition
+{
+    Comparison operator()(const Record* a, const Record* b) const
+    {
+        if (a->id < b->id)
+        {
+            return Comparison::LESS_THAN;
+        }
+        if (a->id > b->id)
+        {
+            return Comparison::GREATER_THAN;
+        }
+        return Comparison::EQUAL;
+    }
+};
+
+struct RecordId
+{
+    using key_type = long;
+    long operator()(const Record* record) const
+    {
+        return record->id;
+    }
+};
+
+
+template <class tree_type, class lookup_type>
+static void measure(const char* name, std::vector<Record*>& records, const std::vector<long>& queries, lookup_type lookup)
+{
+    tree_type tree;
+    for (Record* record : records)
+    {
+        tree.insert(record);
+    }
+    long found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (long id : queries)
+    {
+        found += lookup(tree, id) != nullptr;
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    std::printf("%-14s %8.1f ns/lookup (found %ld, %zu bytes/node)\n", name, ns / queries.size(), found,
+                sizeof(typename tree_type::node_type));
+}
+
+
+int main(int argc, char** argv)
+{
+    long n = argc > 1 ? std::atol(argv[1]) : 10000000;
+    std::mt19937_64 rng(42);
+    std::vector<Record*> records(n);
+    for (long i = 0; i < n; i++)
+    {
+        records[i] = new Record();
+        records[i]->id = i * 2;
+    }
+    std::shuffle(records.begin(), records.end(), rng);
+    std::vector<long> queries(2000000);
+    for (long& id : queries)
+    {
+        id = static_cast<long>(rng() % (2 * n));
+    }
+
+    std::printf("%ld records\n", n);
+    measure<AVLTree<Record, RecordCondition>>("data compare", records, queries,
+        [](AVLTree<Record, RecordCondition>& tree, long id)
+        {
+            Record probe;
+            probe.id = id;
+            return tree.search(&probe);
+        });
+    measure<AVLTree<Record, RecordCondition, AVLNodePool, RecordId>>("cached keys", records, queries,
+        [](AVLTree<Record, RecordCondition, AVLNodePool, RecordId>& tree, long id)
+        {
+            return tree.find(id);
+        });
+
+    for (Record* record : records)
+    {
+        delete record;
+    }
+    return 0;
+}
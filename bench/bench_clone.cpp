@@ -0,0 +1,98 @@
+// benchmark for copying an AVLTree: clone() against inorder() + build_from_array, with every thread count
+// up to the given one, and what moving a tree costs
+//
+// build: g++ -O2 -std=c++17 -pthread -I.. bench_clone.cpp -o bench_clone
+// run:   ./bench_clone [num_of_keys] [max_threads]
+
+#include "../AVLTree.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+
+struct Key
+{
+    long value;
+};
+
+struct KeyCondition
+{
+    Comparison operator()(const Key* a, const Key* b) const
+    {
+        if (a->value < b->value)
+        {
+            return Comparison::LESS_THAN;
+        }
+        if (a->value > b->value)
+        {
+            return Comparison::GREATER_THAN;
+        }
+        return Comparison::EQUAL;
+    }
+};
+
+typedef AVLTree<Key, KeyCondition> Tree;
+
+
+template <class operation>
+static double measure_ms(operation op)
+{
+    auto start = std::chrono::steady_clock::now();
+    op();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+
+int main(int argc, char** argv)
+{
+    int n = argc > 1 ? std::atoi(argv[1]) : 4000000;
+    int max_threads = argc > 2 ? std::atoi(argv[2]) : avl_resolve_num_of_threads(0);
+    std::vector<Key> keys(n);
+    std::vector<Key*> sorted(n);
+    for (int i = 0; i < n; i++)
+    {
+        keys[i].value = i;
+        sorted[i] = &keys[i];
+    }
+
+    long checksum = 0;
+    std::printf("%d keys, %d cores\n", n, avl_resolve_num_of_threads(0));
+    std::printf("%-8s %18s %12s %12s\n", "threads", "inorder+build ms", "clone ms", "speedup");
+    for (int threads = 1; threads <= max_threads; threads *= 2)
+    {
+        Tree tree;
+        tree.set_num_of_threads(threads);
+        tree.build_from_array(sorted.data(), n);
+
+        double rebuild_ms = measure_ms([&]() {
+            Tree copy;
+            copy.set_num_of_threads(threads);
+            Key** elements = tree.inorder();
+            copy.build_from_array(elements, n);
+            delete[] elements;
+            checksum += copy.get_num_of_nodes();
+        });
+        double clone_ms = measure_ms([&]() {
+            Tree copy = tree.clone();
+            checksum += copy.get_num_of_nodes();
+        });
+        std::printf("%-8d %18.1f %12.1f %11.2fx\n", threads, rebuild_ms, clone_ms, rebuild_ms / clone_ms);
+    }
+
+    Tree tree;
+    tree.build_from_array(sorted.data(), n);
+    double move_ms = measure_ms([&]() {
+        for (int i = 0; i < 1000; i++)
+        {
+            Tree moved(std::move(tree));
+            tree = std::move(moved);
+        }
+    });
+    std::printf("move there and back   %10.3f us\n", move_ms);
+    std::printf("checksum %ld\n", checksum + tree.get_num_of_nodes());
+    return 0;
+}
@@ -0,0 +1,247 @@
+// stress test and benchmark for the concurrent trees: ConcurrentAVLTree and ShardedAVLTree against an AVLTree behind one mutex
+// every thread runs a random mix of search / insert / remove for a fixed time, writing only keys of its own
+// stripe (key % threads == thread) and reading any key, so the expected contents are known at the end
+// reports ops/sec for every thread count and checks the contents of the tree after every run
+//
+// build: g++ -O2 -std=c++17 -pthread -I.. bench_concurrent.cpp -o bench_concurrent
+// run:   ./bench_concurrent [max_threads=64] [num_of_keys=1000000] [search_percent=50] [ms_per_run=500]
+
+#include "../AVLTree.h"
+#include "../ConcurrentAVLTree.h"
+#include "../ShardedAVLTree.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+
+struct Key
+{
+    long value;
+};
+
+struct KeyCondition
+{
+    Comparison operator()(const Key* a, const Key* b) const
+    {
+        if (a->value < b->value)
+        {
+            return Comparison::LESS_THAN;
+        }
+        if (a->value > b->value)
+        {
+            return Comparison::GREATER_THAN;
+        }
+        return Comparison::EQUAL;
+    }
+};
+
+struct KeyValue
+{
+    long operator()(const Key* key) const
+    {
+        return key->value;
+    }
+};
+
+
+// AVLTree behind a global lock - what the concurrent tree replaces
+class LockedTree
+{
+private:
+    AVLTree<Key, KeyCondition> tree;
+    std::mutex lock;
+
+public:
+    bool search(Key* key)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return tree.search(key) != nullptr;
+    }
+
+    bool insert(Key* key)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return tree.insert(key) != nullptr;
+    }
+
+    bool remove(Key* key)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return tree.remove(key);
+    }
+};
+
+
+class ConcurrentTree
+{
+private:
+    ConcurrentAVLTree<Key, KeyValue> tree;
+
+public:
+    bool search(Key* key)
+    {
+        return tree.search(key->value) != nullptr;
+    }
+
+    bool insert(Key* key)
+    {
+        return tree.insert(key);
+    }
+
+    bool remove(Key* key)
+    {
+        return tree.remove(key->value) != nullptr;
+    }
+};
+
+
+class ShardedTree
+{
+private:
+    ShardedAVLTree<Key, KeyCondition, KeyValue> tree;
+
+public:
+    bool search(Key* key)
+    {
+        return tree.search(key) != nullptr;
+    }
+
+    bool insert(Key* key)
+    {
+        return tree.insert(key);
+    }
+
+    bool remove(Key* key)
+    {
+        return tree.remove(key);
+    }
+};
+
+
+// runs the mix on a new tree with 'threads' threads, returns ops/sec, or -1 if the contents came out wrong
+template <class tree_type>
+static double run(int threads, std::vector<Key>& keys, int search_percent, int ms_per_run)
+{
+    long n = static_cast<long>(keys.size());
+    tree_type tree;
+    std::vector<char> present(n, 0);
+    for (long i = 0; i < n; i += 2)
+    {
+        tree.insert(&keys[i]);
+        present[i] = 1;
+    }
+
+    std::atomic<bool> start(false);
+    std::atomic<bool> stop(false);
+    std::atomic<bool> wrong(false);
+    std::vector<long> ops(threads, 0);
+    std::vector<std::thread> workers;
+    for (int id = 0; id < threads; id++)
+    {
+        workers.emplace_back([&, id]()
+        {
+            std::mt19937_64 rng(id + 1);
+            long stripe = (n - id + threads - 1) / threads;
+            long done = 0;
+            long found = 0;     // keeps the searches from being optimized away
+            while (!start.load())
+            {
+            }
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                for (int i = 0; i < 64; i++, done++)
+                {
+                    int op = static_cast<int>(rng() % 100);
+                    if (op < search_percent)
+                    {
+                        found += tree.search(&keys[rng() % n]);
+                        continue;
+                    }
+                    long k = static_cast<long>(rng() % stripe) * threads + id;
+                    if (op < search_percent + (100 - search_percent) / 2)
+                    {
+                        if (tree.insert(&keys[k]) == static_cast<bool>(present[k]))
+                        {
+                            wrong.store(true);
+                        }
+                        present[k] = 1;
+                    }
+                    else
+                    {
+                        if (tree.remove(&keys[k]) != static_cast<bool>(present[k]))
+                        {
+                            wrong.store(true);
+                        }
+                        present[k] = 0;
+                    }
+                }
+            }
+            ops[id] = done + (found < 0);
+        });
+    }
+    auto begin = std::chrono::steady_clock::now();
+    start.store(true);
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms_per_run));
+    stop.store(true);
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    for (long i = 0; i < n && !wrong.load(); i++)
+    {
+        if (tree.search(&keys[i]) != static_cast<bool>(present[i]))
+        {
+            wrong.store(true);
+        }
+    }
+    if (wrong.load())
+    {
+        return -1;
+    }
+    long total = 0;
+    for (long done : ops)
+    {
+        total += done;
+    }
+    return total / seconds;
+}
+
+
+int main(int argc, char** argv)
+{
+    int max_threads = argc > 1 ? std::atoi(argv[1]) : 64;
+    long n = argc > 2 ? std::atol(argv[2]) : 1000000;
+    int search_percent = argc > 3 ? std::atoi(argv[3]) : 50;
+    int ms_per_run = argc > 4 ? std::atoi(argv[4]) : 500;
+    std::vector<Key> keys(n);
+    for (long i = 0; i < n; i++)
+    {
+        keys[i].value = i;
+    }
+
+    std::printf("%ld keys, %d%% search, %d cores\n", n, search_percent, static_cast<int>(std::thread::hardware_concurrency()));
+    std::printf("%-8s %16s %16s %16s\n", "threads", "mutex ops/s", "concurrent ops/s", "sharded ops/s");
+    int failures = 0;
+    for (int threads = 1; threads <= max_threads; threads *= 2)
+    {
+        double locked = run<LockedTree>(threads, keys, search_percent, ms_per_run);
+        double concurrent = run<ConcurrentTree>(threads, keys, search_percent, ms_per_run);
+        double sharded = run<ShardedTree>(threads, keys, search_percent, ms_per_run);
+        if (locked < 0 || concurrent < 0 || sharded < 0)
+        {
+            std::printf("%-8d CONTENTS CHECK FAILED (%s)\n", threads, locked < 0 ? "mutex" : (concurrent < 0 ? "concurrent" : "sharded"));
+            failures++;
+            continue;
+        }
+        std::printf("%-8d %16.0f %16.0f %16.0f\n", threads, locked, concurrent, sharded);
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,79 @@
+// benchmark for the hot paths of AVLTree: insert, search, get_closest_left and remove
+// reports ns/op and comparator calls/op over a random permutation of keys
+//
+// build: g++ -O2 -std=c++17 -I.. bench_hot_paths.cpp -o bench_hot_paths
+// run:   ./bench_hot_paths [num_of_keys]
+
+#include "../AVLTree.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+
+static long comparisons = 0;
+
+struct Key
+{
+    long value;
+};
+
+struct KeyCondition
+{
+    Comparison operator()(const Key* a, const Key* b) const
+    {
+        comparisons++;
+        if (a->value < b->value)
+        {
+            return Comparison::LESS_THAN;
+        }
+        if (a->value > b->value)
+        {
+            return Comparison::GREATER_THAN;
+        }
+        return Comparison::EQUAL;
+    }
+};
+
+
+template <class operation>
+static void measure(const char* name, int n, operation op)
+{
+    comparisons = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i++)
+    {
+        op(i);
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    std::printf("%-18s %10.1f ns/op %8.2f cmp/op\n", name, ns / n, double(comparisons) / n);
+}
+
+
+int main(int argc, char** argv)
+{
+    int n = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    std::vector<Key> keys(n);
+    std::vector<Key*> order(n);
+    for (int i = 0; i < n; i++)
+    {
+        keys[i].value = i;
+        order[i] = &keys[i];
+    }
+    std::shuffle(order.begin(), order.end(), std::mt19937_64(42));
+
+    AVLTree<Key, KeyCondition> tree;
+    long checksum = 0;
+    std::printf("%d random keys\n", n);
+    measure("insert", n, [&](int i) { checksum += tree.insert(order[i]) != nullptr; });
+    measure("insert duplicate", n, [&](int i) { checksum += tree.insert(order[i]) != nullptr; });
+    measure("search", n, [&](int i) { checksum += tree.search(order[n - 1 - i]) != nullptr; });
+    measure("get_closest_left", n, [&](int i) { checksum += tree.get_closest_left(order[i]) != nullptr; });
+    measure("remove", n, [&](int i) { checksum += tree.remove(order[i]); });
+    std::printf("checksum %ld\n", checksum);
+    return 0;
+}
@@ -0,0 +1,106 @@
+// benchmark for insert_hint and the min/max fingers of AVLTree
+// compares insert from the root to insert_hint on a monotonic and a near-monotonic key stream
+// (timestamps that arrive up to a small window out of order), reports ns/op and comparator calls/op
+//
+// build: g++ -O2 -std=c++17 -I.. bench_insert_hint.cpp -o bench_insert_hint
+// run:   ./bench_insert_hint [num_of_keys] [window]
+
+#include "../AVLTree.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+
+static long comparisons = 0;
+
+struct Key
+{
+    long value;
+};
+
+struct KeyCondition
+{
+    Comparison operator()(const Key* a, const Key* b) const
+    {
+        comparisons++;
+        if (a->value < b->value)
+        {
+            return Comparison::LESS_THAN;
+        }
+        if (a->value > b->value)
+        {
+            return Comparison::GREATER_THAN;
+        }
+        return Comparison::EQUAL;
+    }
+};
+
+typedef AVLTree<Key, KeyCondition> Tree;
+
+
+template <class operation>
+static void measure(const char* name, int n, operation op)
+{
+    comparisons = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i++)
+    {
+        op(i);
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    std::printf("%-28s %10.1f ns/op %8.2f cmp/op\n", name, ns / n, double(comparisons) / n);
+}
+
+
+int main(int argc, char** argv)
+{
+    int n = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    int window = argc > 2 ? std::atoi(argv[2]) : 8;
+    std::vector<Key> keys(n);
+    std::vector<Key*> monotonic(n);
+    for (int i = 0; i < n; i++)
+    {
+        keys[i].value = i;
+        monotonic[i] = &keys[i];
+    }
+    // every key is moved at most 'window' places from its sorted place
+    std::vector<Key*> near = monotonic;
+    std::mt19937_64 rng(42);
+    for (int i = 0; i + window < n; i += window)
+    {
+        std::shuffle(near.begin() + i, near.begin() + i + window, rng);
+    }
+
+    long checksum = 0;
+    std::printf("%d keys, window %d\n", n, window);
+    {
+        Tree tree;
+        measure("monotonic insert", n, [&](int i) { checksum += tree.insert(monotonic[i]) != nullptr; });
+    }
+    {
+        Tree tree;
+        measure("monotonic insert_hint(end)", n, [&](int i) { checksum += tree.insert_hint(nullptr, monotonic[i]) != nullptr; });
+        measure("get_max_node", n, [&](int) { checksum += tree.get_max_node()->data->value; });
+    }
+    {
+        Tree tree;
+        measure("near insert", n, [&](int i) { checksum += tree.insert(near[i]) != nullptr; });
+    }
+    {
+        Tree tree;
+        Tree::node_type* last = nullptr;
+        measure("near insert_hint(last)", n, [&](int i)
+        {
+            Tree::node_type* node = tree.insert_hint(last, near[i]);
+            checksum += node != nullptr;
+            last = node;
+        });
+    }
+    std::printf("checksum %ld\n", checksum);
+    return 0;
+}
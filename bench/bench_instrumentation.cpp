@@ -0,0 +1,113 @@
+// benchmark for the instrumented AVLTree: prints the counters of AVLStatsCounter after random inserts,
+// searches and removes, and what counting costs against a tree without an instrumentation
+//
+// build: g++ -O2 -std=c++17 -I.. bench_instrumentation.cpp -o bench_instrumentation
+// run:   ./bench_instrumentation [num_of_keys]
+
+#include "../AVLTree.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+
+struct Key
+{
+    long value;
+};
+
+struct KeyCondition
+{
+    Comparison operator()(const Key* a, const Key* b) const
+    {
+        if (a->value < b->value)
+        {
+            return Comparison::LESS_THAN;
+        }
+        if (a->value > b->value)
+        {
+            return Comparison::GREATER_THAN;
+        }
+        return Comparison::EQUAL;
+    }
+};
+
+typedef AVLTree<Key, KeyCondition> PlainTree;
+typedef AVLTree<Key, KeyCondition, AVLNodePool, void, void, AVLStatsCounter> CountedTree;
+
+
+template <class tree_type>
+static double run(tree_type& tree, const std::vector<Key*>& order, long& checksum)
+{
+    int n = static_cast<int>(order.size());
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i++)
+    {
+        checksum += tree.insert(order[i]) != nullptr;
+    }
+    for (int i = 0; i < n; i++)
+    {
+        checksum += tree.search(order[n - 1 - i]) != nullptr;
+    }
+    for (int i = 0; i < n; i++)
+    {
+        checksum += tree.remove(order[i]);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / (3.0 * n);
+}
+
+
+static void print_histogram(const AVLTreeStats& stats, AVLDescent operation, const char* name)
+{
+    std::printf("%-7s depth:", name);
+    for (int depth = 0; depth < AVLTreeStats::MAX_DEPTH; depth++)
+    {
+        long count = stats.get_descents(operation, depth);
+        if (count != 0)
+        {
+            std::printf(" %d:%ld", depth, count);
+        }
+    }
+    std::printf("\n");
+}
+
+
+int main(int argc, char** argv)
+{
+    int n = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    std::vector<Key> keys(n);
+    std::vector<Key*> order(n);
+    for (int i = 0; i < n; i++)
+    {
+        keys[i].value = i;
+        order[i] = &keys[i];
+    }
+    std::shuffle(order.begin(), order.end(), std::mt19937_64(42));
+
+    long checksum = 0;
+    PlainTree plain;
+    CountedTree counted;
+    double plain_ns = run(plain, order, checksum);
+    double counted_ns = run(counted, order, checksum);
+    std::printf("%d random keys, insert + search + remove\n", n);
+    std::printf("without instrumentation %8.1f ns/op\n", plain_ns);
+    std::printf("with AVLStatsCounter    %8.1f ns/op\n", counted_ns);
+
+    AVLTreeStats stats = counted.get_tree_stats();
+    std::printf("comparisons   %ld\n", stats.comparisons);
+    std::printf("rotations     LL %ld  RR %ld  LR %ld  RL %ld\n", stats.get_rotations(AVLRotation::LL),
+                stats.get_rotations(AVLRotation::RR), stats.get_rotations(AVLRotation::LR), stats.get_rotations(AVLRotation::RL));
+    std::printf("retrace steps %ld\n", stats.retrace_steps);
+    std::printf("allocations   %ld\n", stats.allocations);
+    print_histogram(stats, AVLDescent::INSERT, "insert");
+    print_histogram(stats, AVLDescent::SEARCH, "search");
+    print_histogram(stats, AVLDescent::REMOVE, "remove");
+    counted.reset_tree_stats();
+    std::printf("after reset   %ld comparisons\n", counted.get_tree_stats().comparisons);
+    std::printf("checksum %ld\n", checksum);
+    return 0;
+}
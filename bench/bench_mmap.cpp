@@ -0,0 +1,130 @@
+// benchmark for tree images: time until the first searches are answered after a restart
+// compares load_mmap of an image written by save() to rebuilding the tree by reading the keys from a file
+// and build_from_array, and promoting the mapped image into a mutable AVLTree
+//
+// build: g++ -O2 -std=c++17 -I.. bench_mmap.cpp -o bench_mmap
+// run:   ./bench_mmap [num_of_keys] [num_of_searches] [image_path]
+
+#include "../AVLTree.h"
+#include "../AVLMappedTree.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+
+struct Key
+{
+    long value;
+    long payload;
+};
+
+struct KeyCondition
+{
+    Comparison operator()(const Key* a, const Key* b) const
+    {
+        if (a->value < b->value)
+        {
+            return Comparison::LESS_THAN;
+        }
+        if (a->value > b->value)
+        {
+            return Comparison::GREATER_THAN;
+        }
+        return Comparison::EQUAL;
+    }
+};
+
+typedef AVLMappedTree<Key, KeyCondition> MappedTree;
+
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+int main(int argc, char** argv)
+{
+    long n = argc > 1 ? std::atol(argv[1]) : 1000000;
+    int searches = argc > 2 ? std::atoi(argv[2]) : 1000;
+    const char* path = argc > 3 ? argv[3] : "bench_mmap.img";
+    std::vector<Key> keys(n);
+    std::vector<Key*> sorted(n);
+    for (long i = 0; i < n; i++)
+    {
+        keys[i].value = 2 * i;
+        keys[i].payload = i;
+        sorted[i] = &keys[i];
+    }
+    std::mt19937_64 rng(5);
+    std::vector<Key> probes(searches);
+    for (Key& probe : probes)
+    {
+        probe.value = static_cast<long>(rng() % (2 * n));
+    }
+
+    AVLTree<Key, KeyCondition> tree;
+    tree.build_from_array(sorted.data(), static_cast<int>(n));
+    auto start = std::chrono::steady_clock::now();
+    if (!tree.save(path))
+    {
+        std::printf("can't write %s\n", path);
+        return 1;
+    }
+    std::printf("%-40s %10.2f ms\n", "save", elapsed_ms(start));
+
+    // the baseline restart: read the keys back and build the tree again
+    std::FILE* file = std::fopen("bench_mmap.raw", "wb");
+    std::fwrite(keys.data(), sizeof(Key), n, file);
+    std::fclose(file);
+    long found = 0;
+    start = std::chrono::steady_clock::now();
+    std::vector<Key*> loaded(n);
+    file = std::fopen("bench_mmap.raw", "rb");
+    for (long i = 0; i < n; i++)
+    {
+        loaded[i] = new Key;
+        if (std::fread(loaded[i], sizeof(Key), 1, file) != 1)
+        {
+            return 1;
+        }
+    }
+    std::fclose(file);
+    AVLTree<Key, KeyCondition> rebuilt;
+    rebuilt.build_from_array(loaded.data(), static_cast<int>(n));
+    for (Key& probe : probes)
+    {
+        found += rebuilt.search(&probe) != nullptr;
+    }
+    std::printf("%-40s %10.2f ms\n", "read + build_from_array + searches", elapsed_ms(start));
+    rebuilt.erase_data();
+
+    start = std::chrono::steady_clock::now();
+    MappedTree mapped;
+    if (!mapped.load_mmap(path))
+    {
+        std::printf("can't map %s\n", path);
+        return 1;
+    }
+    for (Key& probe : probes)
+    {
+        found -= mapped.search(&probe) != nullptr;
+    }
+    std::printf("%-40s %10.2f ms\n", "load_mmap + searches", elapsed_ms(start));
+
+    start = std::chrono::steady_clock::now();
+    mapped.promote();
+    std::printf("%-40s %10.2f ms\n", "promote to a mutable AVLTree", elapsed_ms(start));
+
+    std::remove("bench_mmap.raw");
+    std::remove(path);
+    if (found != 0)
+    {
+        std::printf("MISMATCH between the rebuilt and the mapped tree\n");
+        return 1;
+    }
+    return 0;
+}
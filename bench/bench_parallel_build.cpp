@@ -0,0 +1,79 @@
+// benchmark for the parallel bulk functions of AVLTree: build_from_array, erase_data and freeing all nodes
+// runs each of them with 1 thread and with every thread count up to the given one, reports ms and speedup
+// freeing is measured with the heap allocator, since the pool gives back its slabs without walking the nodes
+//
+// build: g++ -O2 -std=c++17 -pthread -I.. bench_parallel_build.cpp -o bench_parallel_build
+// run:   ./bench_parallel_build [num_of_keys] [max_threads]
+
+#include "../AVLTree.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+
+struct Key
+{
+    long value;
+};
+
+struct KeyCondition
+{
+    Comparison operator()(const Key* a, const Key* b) const
+    {
+        if (a->value < b->value)
+        {
+            return Comparison::LESS_THAN;
+        }
+        if (a->value > b->value)
+        {
+            return Comparison::GREATER_THAN;
+        }
+        return Comparison::EQUAL;
+    }
+};
+
+
+template <class operation>
+static double measure_ms(operation op)
+{
+    auto start = std::chrono::steady_clock::now();
+    op();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+
+int main(int argc, char** argv)
+{
+    int n = argc > 1 ? std::atoi(argv[1]) : 20000000;
+    int max_threads = argc > 2 ? std::atoi(argv[2]) : avl_resolve_num_of_threads(0);
+    std::vector<Key*> keys(n);
+    std::printf("%d keys, %d cores\n", n, avl_resolve_num_of_threads(0));
+    std::printf("%-8s %12s %12s %12s %12s\n", "threads", "build ms", "free ms", "erase ms", "speedup");
+    double base = 0;
+    for (int threads = 1; threads <= max_threads; threads *= 2)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            keys[i] = new Key{i};
+        }
+        double build_ms;
+        double free_ms;
+        double erase_ms;
+        auto tree = std::make_unique<AVLTree<Key, KeyCondition, AVLNodeHeapAllocator>>();
+        tree->set_num_of_threads(threads);
+        build_ms = measure_ms([&]() { tree->build_from_array(keys.data(), n); });
+        erase_ms = measure_ms([&]() { tree->erase_data(); });
+        free_ms = measure_ms([&]() { tree.reset(); });
+        double total = build_ms + free_ms + erase_ms;
+        if (threads == 1)
+        {
+            base = total;
+        }
+        std::printf("%-8d %12.1f %12.1f %12.1f %11.2fx\n", threads, build_ms, free_ms, erase_ms, base / total);
+    }
+    return 0;
+}
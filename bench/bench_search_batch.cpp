@@ -0,0 +1,137 @@
+// benchmark for search_batch: batched lookups against a loop of single lookups
+// runs with cached keys (descents don't touch the data) and with data compares
+//
+// build: g++ -O2 -std=c++17 -I.. bench_search_batch.cpp -o bench_search_batch
+// run:   ./bench_search_batch [num_of_keys] (4M by default)
+
+#include "../AVLTree.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+
+struct Record
+{
+    long id;
+    char payload[56];
+};
+
+struct RecordCondition
+{
+    Comparison operator()(const Record* a, const Record* b) const
+    {
+        if (a->id < b->id)
+        {
+            return Comparison::LESS_THAN;
+        }
+        if (a->id > b->id)
+        {
+            return Comparison::GREATER_THAN;
+        }
+        return Comparison::EQUAL;
+    }
+};
+
+struct RecordId
+{
+    using key_type = long;
+    long operator()(const Record* record) const
+    {
+        return record->id;
+    }
+};
+
+
+template <class batch_operation>
+static double measure(int num_of_queries, int batch_size, batch_operation op)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i + batch_size <= num_of_queries; i += batch_size)
+    {
+        op(i, batch_size);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / num_of_queries;
+}
+
+
+template <class tree_type, class probe_type>
+static void compare_batches(const char* name, tree_type& tree, const std::vector<probe_type>& probes)
+{
+    int num_of_queries = static_cast<int>(probes.size());
+    std::vector<typename tree_type::node_type*> out(probes.size());
+    long checksum = 0;
+    for (int batch_size : {64, 128, 256, 512})
+    {
+        double single = measure(num_of_queries, batch_size, [&](int first, int size)
+        {
+            for (int i = first; i < first + size; i++)
+            {
+                out[i] = tree.find(probes[i]);
+            }
+        });
+        double batched = measure(num_of_queries, batch_size, [&](int first, int size)
+        {
+            tree.search_batch(probes.data() + first, size, out.data() + first);
+        });
+        for (auto node : out)
+        {
+            checksum += node != nullptr;
+        }
+        std::printf("%-14s batch %3d: single %7.1f ns/key, search_batch %7.1f ns/key (x%.2f)\n",
+                    name, batch_size, single, batched, single / batched);
+    }
+    std::printf("checksum %ld\n", checksum);
+}
+
+
+int main(int argc, char** argv)
+{
+    int n = argc > 1 ? std::atoi(argv[1]) : 4000000;
+    std::mt19937_64 rng(42);
+    std::vector<Record*> records(n);
+    for (int i = 0; i < n; i++)
+    {
+        records[i] = new Record();
+        records[i]->id = 2L * i;
+    }
+    std::shuffle(records.begin(), records.end(), rng);
+    int num_of_queries = 1 << 20;
+    std::vector<long> keys(num_of_queries);
+    std::vector<Record> probe_records(num_of_queries);
+    std::vector<Record*> probes(num_of_queries);
+    for (int i = 0; i < num_of_queries; i++)
+    {
+        keys[i] = static_cast<long>(rng() % (2UL * n));
+        probe_records[i].id = keys[i];
+        probes[i] = &probe_records[i];
+    }
+
+    std::printf("%d records, %d queries\n", n, num_of_queries);
+    {
+        AVLTree<Record, RecordCondition, AVLNodePool, RecordId> tree;
+        for (Record* record : records)
+        {
+            tree.insert(record);
+        }
+        compare_batches("cached keys", tree, keys);
+    }
+    {
+        AVLTree<Record, RecordCondition> tree;
+        for (Record* record : records)
+        {
+            tree.insert(record);
+        }
+        compare_batches("data compare", tree, probes);
+    }
+
+    for (Record* record : records)
+    {
+        delete record;
+    }
+    return 0;
+}
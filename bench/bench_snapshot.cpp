@@ -0,0 +1,110 @@
+// benchmark for the snapshots of AVLPersistentTree
+// compares taking a point-in-time view by copying the tree out (export_inorder of AVLTree) to snapshot(),
+// and the cost of writes while a snapshot is held (every write copies its path once) against writes without one
+// reports the node pool usage, so nodes kept alive by old versions show up
+//
+// build: g++ -O2 -std=c++17 -I.. bench_snapshot.cpp -o bench_snapshot
+// run:   ./bench_snapshot [num_of_keys] [writes_per_snapshot]
+
+#include "../AVLTree.h"
+#include "../AVLPersistentTree.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+
+struct Key
+{
+    long value;
+};
+
+struct KeyCondition
+{
+    Comparison operator()(const Key* a, const Key* b) const
+    {
+        if (a->value < b->value)
+        {
+            return Comparison::LESS_THAN;
+        }
+        if (a->value > b->value)
+        {
+            return Comparison::GREATER_THAN;
+        }
+        return Comparison::EQUAL;
+    }
+};
+
+typedef AVLPersistentTree<Key, KeyCondition> PersistentTree;
+
+
+static double elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+// runs 'writes' random insert/remove pairs on tree, taking a new snapshot every 'every' writes if every > 0
+static double measure_writes(PersistentTree& tree, std::vector<Key>& keys, int writes, int every)
+{
+    std::mt19937_64 rng(7);
+    long n = static_cast<long>(keys.size());
+    PersistentTree held;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < writes; i++)
+    {
+        if (every > 0 && i % every == 0)
+        {
+            held = tree.snapshot();
+        }
+        Key* key = &keys[rng() % n];
+        if (!tree.remove(key))
+        {
+            tree.insert(key);
+        }
+    }
+    return elapsed_ns(start) / writes;
+}
+
+
+int main(int argc, char** argv)
+{
+    long n = argc > 1 ? std::atol(argv[1]) : 1000000;
+    int every = argc > 2 ? std::atoi(argv[2]) : 1000;
+    std::vector<Key> keys(n);
+    std::vector<Key*> sorted(n);
+    for (long i = 0; i < n; i++)
+    {
+        keys[i].value = i;
+        sorted[i] = &keys[i];
+    }
+
+    AVLTree<Key, KeyCondition> plain;
+    plain.build_from_array(sorted.data(), static_cast<int>(n));
+    PersistentTree tree;
+    tree.build_from_array(sorted.data(), static_cast<int>(n));
+
+    std::vector<Key*> copy(n);
+    auto start = std::chrono::steady_clock::now();
+    plain.export_inorder(copy.data());
+    std::printf("%-36s %14.0f ns\n", "AVLTree export_inorder copy", elapsed_ns(start));
+
+    start = std::chrono::steady_clock::now();
+    PersistentTree view = tree.snapshot();
+    std::printf("%-36s %14.0f ns\n", "AVLPersistentTree snapshot", elapsed_ns(start));
+
+    int writes = 200000;
+    double alone = measure_writes(tree, keys, writes, 0);
+    double shared = measure_writes(tree, keys, writes, every);
+    std::printf("%-36s %14.1f ns/op\n", "writes, no snapshot held", alone);
+    std::printf("writes, snapshot every %-13d %14.1f ns/op\n", every, shared);
+
+    AVLPoolStats stats = tree.get_pool_stats();
+    std::printf("nodes in use %ld for %d + %d nodes in the two versions\n", stats.in_use, tree.get_num_of_nodes(), view.get_num_of_nodes());
+    view.clear();
+    stats = tree.get_pool_stats();
+    std::printf("nodes in use %ld after dropping the old version\n", stats.in_use);
+    return 0;
+}
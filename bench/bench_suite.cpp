@@ -0,0 +1,679 @@
+// benchmark suite of AVLTree against std::set, std::map and a B-tree (BTreeBaseline.h)
+// measures insert, remove, search, get_closest_left/right, inorder and build_from_array for keys inserted and
+// looked up in random, sequential, zipfian and near-sorted order, and writes the results as JSON
+// (one record per structure/operation/distribution/size) so runs can be compared over time
+//
+// every record holds
+//   ns_per_op            wall time per operation (per element for inorder and build_from_array)
+//   comparisons_per_op   calls of the condition (three-way for AVLTree, less-than for the others)
+//   bytes_per_node       heap bytes requested by the structure per key after the inserts (malloc overhead excluded)
+//   rss_kb               resident set of the process after the inserts (includes the keys and the workload)
+// every operation runs over all n keys, repeated on fresh structures until min_ops operations were measured
+//
+// build: cmake -S .. -B build -DCMAKE_BUILD_TYPE=Release && cmake --build build --target bench_suite
+//    or: g++ -O2 -std=c++17 -pthread -I.. bench_suite.cpp -o bench_suite
+// run:   ./bench_suite [--sizes=1000,10000,100000,1000000] [--distributions=random,sequential,zipfian,near_sorted]
+//                      [--structures=avl,set,map,btree] [--min-ops=1000000] [--out=results.json]
+//        sizes up to 100M are fine as long as the keys and the structures fit in memory (--sizes=...,100000000)
+
+#include "../AVLTree.h"
+#include "BTreeBaseline.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <new>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+
+/******************************************************* counters *******************************************************/
+
+
+static long comparisons = 0;
+static long live_bytes = 0;
+
+// every allocation of the process is counted, so bytes_per_node covers node pools, set nodes and B-tree nodes alike
+// (kept out of line - inlined into the containers, gcc takes the header arithmetic for out of bounds accesses)
+static const size_t ALLOCATION_HEADER = 16;
+
+#if defined(__GNUC__)
+#define BENCH_NOINLINE __attribute__((noinline))
+#else
+#define BENCH_NOINLINE
+#endif
+
+BENCH_NOINLINE void* operator new(size_t size)
+{
+    void* block = std::malloc(size + ALLOCATION_HEADER);
+    if (block == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    std::memcpy(block, &size, sizeof(size));
+    live_bytes += static_cast<long>(size);
+    return static_cast<char*>(block) + ALLOCATION_HEADER;
+}
+
+BENCH_NOINLINE void operator delete(void* pointer) noexcept
+{
+    if (pointer == nullptr)
+    {
+        return;
+    }
+    char* block = static_cast<char*>(pointer) - ALLOCATION_HEADER;
+    size_t size;
+    std::memcpy(&size, block, sizeof(size));
+    live_bytes -= static_cast<long>(size);
+    std::free(block);
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    operator delete(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept
+{
+    operator delete(pointer);
+}
+
+
+// returns a field of /proc/self/status in kB (VmRSS, VmHWM), 0 where there is none
+static long read_status_kb(const char* field)
+{
+    std::FILE* status = std::fopen("/proc/self/status", "r");
+    if (status == nullptr)
+    {
+        return 0;
+    }
+    char line[256];
+    long value = 0;
+    size_t length = std::strlen(field);
+    while (std::fgets(line, sizeof(line), status) != nullptr)
+    {
+        if (std::strncmp(line, field, length) == 0 && line[length] == ':')
+        {
+            value = std::atol(line + length + 1);
+            break;
+        }
+    }
+    std::fclose(status);
+    return value;
+}
+
+
+/******************************************************* structures *******************************************************/
+
+
+struct Key
+{
+    long value;
+};
+
+struct CountingCondition
+{
+    Comparison operator()(const Key* a, const Key* b) const
+    {
+        comparisons++;
+        if (a->value < b->value)
+        {
+            return Comparison::LESS_THAN;
+        }
+        if (a->value > b->value)
+        {
+            return Comparison::GREATER_THAN;
+        }
+        return Comparison::EQUAL;
+    }
+};
+
+struct CountingLess
+{
+    bool operator()(long a, long b) const
+    {
+        comparisons++;
+        return a < b;
+    }
+};
+
+// key k of every workload is keys[k], whose value is k
+static std::vector<Key> keys;
+
+// inputs of build_from_array, sorted, made once per size
+struct SortedInput
+{
+    std::vector<Key*> pointers;
+    std::vector<long> values;
+    std::vector<std::pair<const long, Key*>> pairs;
+};
+
+/** the structures behind one interface, by key k
+ * closest_left/right look up a key of the structure and step to its neighbor, as AVLTree::get_closest_* do
+ */
+struct AVLAdapter
+{
+    AVLTree<Key, CountingCondition> tree;
+
+    bool insert(long k) { return tree.insert(&keys[k]) != nullptr; }
+    bool remove(long k) { return tree.remove(&keys[k]); }
+    bool search(long k) { return tree.search(&keys[k]) != nullptr; }
+    bool closest_left(long k) { return tree.get_closest_left(&keys[k]) != nullptr; }
+    bool closest_right(long k) { return tree.get_closest_right(&keys[k]) != nullptr; }
+
+    long inorder()
+    {
+        Key** all = tree.inorder();
+        long count = tree.get_num_of_nodes();
+        delete[] all;
+        return count;
+    }
+
+    void build(SortedInput& input) { tree.build_from_array(input.pointers.data(), static_cast<int>(input.pointers.size())); }
+};
+
+struct SetAdapter
+{
+    std::set<long, CountingLess> tree;
+
+    bool insert(long k) { return tree.insert(k).second; }
+    bool remove(long k) { return tree.erase(k) == 1; }
+    bool search(long k) { return tree.find(k) != tree.end(); }
+
+    bool closest_left(long k)
+    {
+        auto found = tree.find(k);
+        return found != tree.end() && found != tree.begin();
+    }
+
+    bool closest_right(long k)
+    {
+        auto found = tree.find(k);
+        return found != tree.end() && ++found != tree.end();
+    }
+
+    long inorder()
+    {
+        std::vector<long> all(tree.begin(), tree.end());
+        return static_cast<long>(all.size());
+    }
+
+    void build(SortedInput& input) { tree.insert(input.values.begin(), input.values.end()); }
+};
+
+struct MapAdapter
+{
+    std::map<long, Key*, CountingLess> tree;
+
+    bool insert(long k) { return tree.emplace(k, &keys[k]).second; }
+    bool remove(long k) { return tree.erase(k) == 1; }
+    bool search(long k) { return tree.find(k) != tree.end(); }
+
+    bool closest_left(long k)
+    {
+        auto found = tree.find(k);
+        return found != tree.end() && found != tree.begin();
+    }
+
+    bool closest_right(long k)
+    {
+        auto found = tree.find(k);
+        return found != tree.end() && ++found != tree.end();
+    }
+
+    long inorder()
+    {
+        std::vector<Key*> all;
+        all.reserve(tree.size());
+        for (auto& entry : tree)
+        {
+            all.push_back(entry.second);
+        }
+        return static_cast<long>(all.size());
+    }
+
+    void build(SortedInput& input) { tree.insert(input.pairs.begin(), input.pairs.end()); }
+};
+
+struct BTreeAdapter
+{
+    BTreeBaseline<long, Key*, CountingLess> tree;
+
+    bool insert(long k) { return tree.insert(k, &keys[k]); }
+    bool remove(long k) { return tree.erase(k); }
+    bool search(long k) { return tree.find(k) != nullptr; }
+    bool closest_left(long k) { return tree.predecessor(k) != nullptr; }
+    bool closest_right(long k) { return tree.successor(k) != nullptr; }
+
+    long inorder()
+    {
+        std::vector<Key*> all;
+        all.reserve(tree.size());
+        tree.for_each([&all](long, Key* value) { all.push_back(value); });
+        return static_cast<long>(all.size());
+    }
+
+    void build(SortedInput& input) { tree.build_sorted(input.values.data(), input.pointers.data(), input.values.size()); }
+};
+
+
+/******************************************************* workloads *******************************************************/
+
+
+/** keys of one distribution: the order of the inserts and removes, and the keys looked up
+ * random       inserts, removes and lookups in random order
+ * sequential   everything in ascending order
+ * zipfian      inserts and removes in random order, lookups skewed to a few hot keys (zipf 0.99, YCSB style)
+ * near_sorted  ascending order with about 5% of the keys displaced by up to 32 places, for all operations
+ */
+struct Workload
+{
+    std::vector<long> order;
+    std::vector<long> probes;
+};
+
+static Workload make_workload(const std::string& distribution, long n, std::mt19937_64& rng)
+{
+    Workload workload;
+    workload.order.resize(n);
+    for (long i = 0; i < n; i++)
+    {
+        workload.order[i] = i;
+    }
+    if (distribution == "random" || distribution == "zipfian")
+    {
+        std::shuffle(workload.order.begin(), workload.order.end(), rng);
+    }
+    else if (distribution == "near_sorted")
+    {
+        for (long i = 0; i < n; i++)
+        {
+            if (rng() % 100 < 5)
+            {
+                std::swap(workload.order[i], workload.order[std::min(n - 1, i + static_cast<long>(rng() % 32))]);
+            }
+        }
+    }
+
+    if (distribution == "random")
+    {
+        workload.probes.resize(n);
+        for (long& probe : workload.probes)
+        {
+            probe = static_cast<long>(rng() % n);
+        }
+    }
+    else if (distribution == "zipfian")
+    {
+        // Gray et al. generator - rank 0 is the hottest, ranks are scattered over the keys by the insert order
+        const double theta = 0.99;
+        double zeta_n = 0;
+        for (long i = 1; i <= n; i++)
+        {
+            zeta_n += 1.0 / std::pow(static_cast<double>(i), theta);
+        }
+        double zeta_2 = 1.0 + 1.0 / std::pow(2.0, theta);
+        double alpha = 1.0 / (1.0 - theta);
+        double eta = (1.0 - std::pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta_2 / zeta_n);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        workload.probes.resize(n);
+        for (long& probe : workload.probes)
+        {
+            double u = uniform(rng);
+            double uz = u * zeta_n;
+            long rank = (uz < 1.0) ? 0 : (uz < zeta_2) ? 1 : static_cast<long>(n * std::pow(eta * u - eta + 1.0, alpha));
+            probe = workload.order[std::min(rank, n - 1)];
+        }
+    }
+    else
+    {
+        workload.probes = workload.order;
+    }
+    return workload;
+}
+
+
+/******************************************************* measuring *******************************************************/
+
+
+struct Result
+{
+    std::string structure;
+    std::string operation;
+    std::string distribution;
+    long size;
+    long iterations;
+    double ns;
+    double comparisons;
+    double bytes_per_node;
+    long rss_kb;
+};
+
+// totals of one operation over all rounds
+struct Totals
+{
+    long iterations = 0;
+    double ns = 0;
+    long comparisons = 0;
+};
+
+static bool failed = false;
+
+// runs op over every key of 'list', adding up time and comparisons, and checks that every call succeeded
+template <class op_type>
+static void measure(Totals& totals, const std::vector<long>& list, op_type op, const char* what)
+{
+    long before = comparisons;
+    long succeeded = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (long k : list)
+    {
+        succeeded += op(k);
+    }
+    totals.ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    totals.comparisons += comparisons - before;
+    totals.iterations += static_cast<long>(list.size());
+    if (succeeded != static_cast<long>(list.size()))
+    {
+        std::fprintf(stderr, "%s: %ld of %zu calls failed\n", what, static_cast<long>(list.size()) - succeeded, list.size());
+        failed = true;
+    }
+}
+
+static Result make_result(const char* structure, const char* operation, const std::string& distribution, long n,
+                          const Totals& totals, double bytes_per_node, long rss_kb)
+{
+    double iterations = static_cast<double>(std::max(1L, totals.iterations));
+    return Result{structure, operation, distribution, n, totals.iterations, totals.ns / iterations,
+                  totals.comparisons / iterations, bytes_per_node, rss_kb};
+}
+
+// every operation but build_from_array of one structure on one workload
+template <class adapter_type>
+static void run_workload(const char* structure, const std::string& distribution, long n, long min_ops,
+                         const Workload& workload, std::vector<Result>& results)
+{
+    long rounds = std::max(1L, min_ops / n);
+    Totals inserts, removes, searches, lefts, rights, scans;
+    double bytes_per_node = 0;
+    long rss_kb = 0;
+    // the first key by order has no left neighbor and the last no right one
+    std::vector<long> with_left, with_right;
+    for (long k : workload.probes)
+    {
+        if (k > 0)
+        {
+            with_left.push_back(k);
+        }
+        if (k < n - 1)
+        {
+            with_right.push_back(k);
+        }
+    }
+    for (long round = 0; round < rounds; round++)
+    {
+        long before = live_bytes;
+        std::unique_ptr<adapter_type> adapter(new adapter_type());
+        measure(inserts, workload.order, [&](long k) { return adapter->insert(k); }, "insert");
+        if (round == 0)
+        {
+            bytes_per_node = static_cast<double>(live_bytes - before) / n;
+            rss_kb = read_status_kb("VmRSS");
+        }
+        measure(searches, workload.probes, [&](long k) { return adapter->search(k); }, "search");
+        measure(lefts, with_left, [&](long k) { return adapter->closest_left(k); }, "get_closest_left");
+        measure(rights, with_right, [&](long k) { return adapter->closest_right(k); }, "get_closest_right");
+        std::vector<long> once(1, 0);
+        Totals scan;
+        measure(scan, once, [&](long) { return adapter->inorder() == n; }, "inorder");
+        scans.ns += scan.ns;
+        scans.comparisons += scan.comparisons;
+        scans.iterations += n;
+        measure(removes, workload.order, [&](long k) { return adapter->remove(k); }, "remove");
+    }
+    results.push_back(make_result(structure, "insert", distribution, n, inserts, bytes_per_node, rss_kb));
+    results.push_back(make_result(structure, "remove", distribution, n, removes, bytes_per_node, rss_kb));
+    results.push_back(make_result(structure, "search", distribution, n, searches, bytes_per_node, rss_kb));
+    results.push_back(make_result(structure, "get_closest_left", distribution, n, lefts, bytes_per_node, rss_kb));
+    results.push_back(make_result(structure, "get_closest_right", distribution, n, rights, bytes_per_node, rss_kb));
+    results.push_back(make_result(structure, "inorder", distribution, n, scans, bytes_per_node, rss_kb));
+}
+
+// build_from_array of one structure from sorted keys (the same for every distribution, reported as "sorted")
+template <class adapter_type>
+static void run_build(const char* structure, long n, long min_ops, SortedInput& input, std::vector<Result>& results)
+{
+    long rounds = std::max(1L, min_ops / n);
+    Totals builds;
+    double bytes_per_node = 0;
+    long rss_kb = 0;
+    for (long round = 0; round < rounds; round++)
+    {
+        long before = live_bytes;
+        std::unique_ptr<adapter_type> adapter(new adapter_type());
+        long compared = comparisons;
+        auto start = std::chrono::steady_clock::now();
+        adapter->build(input);
+        builds.ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        builds.comparisons += comparisons - compared;
+        builds.iterations += n;
+        if (round == 0)
+        {
+            bytes_per_node = static_cast<double>(live_bytes - before) / n;
+            rss_kb = read_status_kb("VmRSS");
+            if (adapter->inorder() != n)
+            {
+                std::fprintf(stderr, "build_from_array: wrong number of keys\n");
+                failed = true;
+            }
+        }
+    }
+    results.push_back(make_result(structure, "build_from_array", "sorted", n, builds, bytes_per_node, rss_kb));
+}
+
+template <class adapter_type>
+static void run_structure(const char* structure, const std::vector<long>& sizes, const std::vector<std::string>& distributions,
+                          long min_ops, std::vector<Result>& results)
+{
+    for (long n : sizes)
+    {
+        SortedInput input;
+        input.pointers.resize(n);
+        input.values.resize(n);
+        input.pairs.reserve(n);
+        for (long k = 0; k < n; k++)
+        {
+            input.pointers[k] = &keys[k];
+            input.values[k] = k;
+            input.pairs.emplace_back(k, &keys[k]);
+        }
+        std::fprintf(stderr, "%s n=%ld build_from_array\n", structure, n);
+        run_build<adapter_type>(structure, n, min_ops, input, results);
+        input = SortedInput();
+        for (const std::string& distribution : distributions)
+        {
+            std::fprintf(stderr, "%s n=%ld %s\n", structure, n, distribution.c_str());
+            std::mt19937_64 rng(static_cast<unsigned long>(n) * 31 + distribution.size());
+            Workload workload = make_workload(distribution, n, rng);
+            run_workload<adapter_type>(structure, distribution, n, min_ops, workload, results);
+        }
+    }
+}
+
+
+/******************************************************* main *******************************************************/
+
+
+// splits a comma separated list
+static std::vector<std::string> split_list(const char* list)
+{
+    std::vector<std::string> items;
+    std::string item;
+    for (const char* c = list; ; c++)
+    {
+        if (*c == ',' || *c == '\0')
+        {
+            if (!item.empty())
+            {
+                items.push_back(item);
+            }
+            item.clear();
+            if (*c == '\0')
+            {
+                break;
+            }
+        }
+        else
+        {
+            item += *c;
+        }
+    }
+    return items;
+}
+
+static bool contains(const std::vector<std::string>& list, const char* item)
+{
+    return std::find(list.begin(), list.end(), item) != list.end();
+}
+
+static void write_json(std::FILE* out, const std::vector<Result>& results, long min_ops)
+{
+    char date[64];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+    std::fprintf(out, "{\n  \"context\": {\n");
+    std::fprintf(out, "    \"date\": \"%s\",\n", date);
+    std::fprintf(out, "    \"compiler\": \"%s\",\n", __VERSION__);
+#ifdef NDEBUG
+    std::fprintf(out, "    \"assertions\": false,\n");
+#else
+    std::fprintf(out, "    \"assertions\": true,\n");
+#endif
+    std::fprintf(out, "    \"min_ops\": %ld,\n", min_ops);
+    std::fprintf(out, "    \"peak_rss_kb\": %ld\n", read_status_kb("VmHWM"));
+    std::fprintf(out, "  },\n  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const Result& r = results[i];
+        std::fprintf(out, "    {\"name\": \"%s/%s/%s/%ld\", \"structure\": \"%s\", \"operation\": \"%s\", \"distribution\": \"%s\", "
+                          "\"size\": %ld, \"iterations\": %ld, \"ns_per_op\": %.2f, \"comparisons_per_op\": %.2f, "
+                          "\"bytes_per_node\": %.2f, \"rss_kb\": %ld}%s\n",
+                     r.structure.c_str(), r.operation.c_str(), r.distribution.c_str(), r.size,
+                     r.structure.c_str(), r.operation.c_str(), r.distribution.c_str(),
+                     r.size, r.iterations, r.ns, r.comparisons, r.bytes_per_node, r.rss_kb,
+                     (i + 1 < results.size()) ? "," : "");
+    }
+    std::fprintf(out, "  ]\n}\n");
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<long> sizes = {1000, 10000, 100000, 1000000};
+    std::vector<std::string> distributions = {"random", "sequential", "zipfian", "near_sorted"};
+    std::vector<std::string> structures = {"avl", "set", "map", "btree"};
+    long min_ops = 1000000;
+    const char* out_path = nullptr;
+    for (int i = 1; i < argc; i++)
+    {
+        const char* value = std::strchr(argv[i], '=');
+        std::string option(argv[i], value == nullptr ? std::strlen(argv[i]) : static_cast<size_t>(value - argv[i]));
+        if (value == nullptr)
+        {
+            std::fprintf(stderr, "usage: %s [--sizes=...] [--distributions=...] [--structures=...] [--min-ops=N] [--out=path]\n", argv[0]);
+            return 2;
+        }
+        value++;
+        if (option == "--sizes")
+        {
+            sizes.clear();
+            for (const std::string& size : split_list(value))
+            {
+                sizes.push_back(std::atol(size.c_str()));
+            }
+        }
+        else if (option == "--distributions")
+        {
+            distributions = split_list(value);
+        }
+        else if (option == "--structures")
+        {
+            structures = split_list(value);
+        }
+        else if (option == "--min-ops")
+        {
+            min_ops = std::atol(value);
+        }
+        else if (option == "--out")
+        {
+            out_path = value;
+        }
+        else
+        {
+            std::fprintf(stderr, "unknown option %s\n", option.c_str());
+            return 2;
+        }
+    }
+    for (long n : sizes)
+    {
+        if (n < 2 || n > 2000000000L)
+        {
+            std::fprintf(stderr, "sizes must be between 2 and 2000000000\n");
+            return 2;
+        }
+    }
+
+    keys.resize(*std::max_element(sizes.begin(), sizes.end()));
+    for (size_t k = 0; k < keys.size(); k++)
+    {
+        keys[k].value = static_cast<long>(k);
+    }
+
+    std::vector<Result> results;
+    if (contains(structures, "avl"))
+    {
+        run_structure<AVLAdapter>("avl", sizes, distributions, min_ops, results);
+    }
+    if (contains(structures, "set"))
+    {
+        run_structure<SetAdapter>("set", sizes, distributions, min_ops, results);
+    }
+    if (contains(structures, "map"))
+    {
+        run_structure<MapAdapter>("map", sizes, distributions, min_ops, results);
+    }
+    if (contains(structures, "btree"))
+    {
+        run_structure<BTreeAdapter>("btree", sizes, distributions, min_ops, results);
+    }
+
+    std::FILE* out = (out_path == nullptr) ? stdout : std::fopen(out_path, "w");
+    if (out == nullptr)
+    {
+        std::fprintf(stderr, "can't write %s\n", out_path);
+        return 1;
+    }
+    write_json(out, results, min_ops);
+    if (out != stdout)
+    {
+        std::fclose(out);
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,113 @@
+// benchmark for the value owning AVLValueTree against AVLTree over heap allocated objects:
+// building by emplace instead of new + insert, searching without the pointer hop, and tearing down
+//
+// build: g++ -O2 -std=c++17 -I.. bench_value_tree.cpp -o bench_value_tree
+// run:   ./bench_value_tree [num_of_keys]
+
+#include "../AVLTree.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+
+struct Item
+{
+    long value;
+    long payload[3];
+
+    explicit Item(long value) : value(value), payload{value, value, value} {}
+};
+
+struct ItemCondition
+{
+    Comparison operator()(const Item* a, const Item* b) const
+    {
+        if (a->value < b->value)
+        {
+            return Comparison::LESS_THAN;
+        }
+        if (a->value > b->value)
+        {
+            return Comparison::GREATER_THAN;
+        }
+        return Comparison::EQUAL;
+    }
+};
+
+typedef AVLTree<Item, ItemCondition> PointerTree;
+typedef AVLValueTree<Item, ItemCondition> ValueTree;
+
+
+template <class operation>
+static double measure(operation op)
+{
+    auto start = std::chrono::steady_clock::now();
+    op();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+
+int main(int argc, char** argv)
+{
+    int n = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    std::vector<long> order(n);
+    for (int i = 0; i < n; i++)
+    {
+        order[i] = i;
+    }
+    std::shuffle(order.begin(), order.end(), std::mt19937_64(42));
+    std::vector<Item> probes;
+    probes.reserve(n);
+    for (int i = 0; i < n; i++)
+    {
+        probes.emplace_back(order[n - 1 - i]);
+    }
+
+    long checksum = 0;
+    std::printf("%d random keys            AVLTree + new   AVLValueTree\n", n);
+    {
+        PointerTree* pointers = new PointerTree();
+        ValueTree* values = new ValueTree();
+        double pointer_ms = measure([&]() {
+            for (int i = 0; i < n; i++)
+            {
+                checksum += pointers->insert(new Item(order[i])) != nullptr;
+            }
+        });
+        double value_ms = measure([&]() {
+            for (int i = 0; i < n; i++)
+            {
+                checksum += values->emplace(order[i]) != nullptr;
+            }
+        });
+        std::printf("insert                 %10.1f ms  %10.1f ms\n", pointer_ms, value_ms);
+
+        pointer_ms = measure([&]() {
+            for (int i = 0; i < n; i++)
+            {
+                checksum += pointers->search(&probes[i])->data->payload[1];
+            }
+        });
+        value_ms = measure([&]() {
+            for (int i = 0; i < n; i++)
+            {
+                checksum += values->search(&probes[i])->value.payload[1];
+            }
+        });
+        std::printf("search + read payload  %10.1f ms  %10.1f ms\n", pointer_ms, value_ms);
+
+        pointer_ms = measure([&]() {
+            pointers->erase_data();
+            delete pointers;
+        });
+        value_ms = measure([&]() { delete values; });
+        std::printf("destroy                %10.1f ms  %10.1f ms\n", pointer_ms, value_ms);
+    }
+    std::printf("checksum %ld\n", checksum);
+    return 0;
+}
@@ -0,0 +1,153 @@
+#ifndef AVL_AVLTESTUTILS_H
+#define AVL_AVLTESTUTILS_H
+
+#include "../AVLTree.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+
+// checks that stay on in release builds - a failed check is printed and makes the test return 1
+static int avl_test_failures = 0;
+
+#define AVL_CHECK(expression) \
+    do \
+    { \
+        if (!(expression)) \
+        { \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #expression); \
+            avl_test_failures++; \
+        } \
+    } while (0)
+
+
+struct Key
+{
+    long value;
+};
+
+struct KeyCondition
+{
+    Comparison operator()(const Key* a, const Key* b) const
+    {
+        if (a->value < b->value)
+        {
+            return Comparison::LESS_THAN;
+        }
+        if (a->value > b->value)
+        {
+            return Comparison::GREATER_THAN;
+        }
+        return Comparison::EQUAL;
+    }
+};
+
+
+// returns true if the tree holds exactly keys [first, last) by order
+template <class tree_type>
+bool avl_holds_range(tree_type& tree, long first, long last)
+{
+    if (tree.get_num_of_nodes() != last - first)
+    {
+        return false;
+    }
+    long expected = first;
+    for (Key* key : tree)
+    {
+        if (key->value != expected)
+        {
+            return false;
+        }
+        expected++;
+    }
+    return expected == last;
+}
+
+// returns the key values first, first + 1, ..., last - 1
+inline std::vector<long> avl_range(long first, long last)
+{
+    std::vector<long> values;
+    for (long value = first; value < last; value++)
+    {
+        values.push_back(value);
+    }
+    return values;
+}
+
+
+// returns true if the tree holds exactly the keys in 'expected' (sorted) by order - walks the nodes, so it
+// fits trees over pointers and value owning trees alike
+template <class tree_type>
+bool avl_holds_keys(tree_type& tree, const std::vector<long>& expected)
+{
+    if (tree.get_num_of_nodes() != static_cast<int>(expected.size()))
+    {
+        return false;
+    }
+    size_t index = 0;
+    for (auto* r = tree.get_min_node(); r != nullptr; r = tree.get_next_node(r))
+    {
+        if (index == expected.size() || r->get_data()->value != expected[index])
+        {
+            return false;
+        }
+        index++;
+    }
+    return index == expected.size();
+}
+
+
+// - sub function for avl_is_valid: checks parent links, heights, sizes and balance factors under r, returns its height
+template <class node_type>
+int avl_check_subtree(node_type* r, node_type* parent, bool& valid)
+{
+    if (r == nullptr)
+    {
+        return -1;
+    }
+    if (r->parent != parent)
+    {
+        valid = false;
+    }
+    int left_height = avl_check_subtree(r->left, r, valid);
+    int right_height = avl_check_subtree(r->right, r, valid);
+    int left_size = r->left == nullptr ? 0 : r->left->size;
+    int right_size = r->right == nullptr ? 0 : r->right->size;
+    int height = (left_height > right_height ? left_height : right_height) + 1;
+    if (r->height != height || std::abs(left_height - right_height) > 1 || r->size != left_size + right_size + 1)
+    {
+        valid = false;
+    }
+    return height;
+}
+
+// returns true if the nodes of an AVLTree keep every AVL invariant, and its size and min/max fingers are right
+template <class tree_type>
+bool avl_is_valid(tree_type& tree)
+{
+    auto* r = tree.get_min_node();
+    if (r == nullptr)
+    {
+        return tree.get_num_of_nodes() == 0 && tree.get_max_node() == nullptr;
+    }
+    while (r->parent != nullptr)
+    {
+        r = r->parent;
+    }
+    bool valid = true;
+    avl_check_subtree(r, static_cast<decltype(r)>(nullptr), valid);
+    auto* min = r;
+    auto* max = r;
+    while (min->left != nullptr)
+    {
+        min = min->left;
+    }
+    while (max->right != nullptr)
+    {
+        max = max->right;
+    }
+    return valid && r->size == tree.get_num_of_nodes() && min == tree.get_min_node() && max == tree.get_max_node();
+}
+
+#endif //AVL_AVLTESTUTILS_H
@@ -0,0 +1,204 @@
+// aggregate(lo, hi) checked against summing the range by hand, after inserts and removes that rotate, after
+// split, join, the batches and build_from_array - with a sum and with a summary that depends on the order
+// of the nodes, and the summary of every subtree checked against its children
+
+#include "AVLTestUtils.h"
+
+#include <set>
+#include <vector>
+
+
+struct KeySum
+{
+    using summary_type = long;
+
+    static long identity()
+    {
+        return 0;
+    }
+
+    static long summarize(const Key* key)
+    {
+        return key->value;
+    }
+
+    static long combine(const long& smaller, const long& bigger)
+    {
+        return smaller + bigger;
+    }
+};
+
+// first and last key of a run of nodes, and whether they came in increasing order - combine isn't commutative
+struct KeyRun
+{
+    long count;
+    long first;
+    long last;
+    bool increasing;
+};
+
+struct KeyRunSummary
+{
+    using summary_type = KeyRun;
+
+    static KeyRun identity()
+    {
+        return KeyRun{0, 0, 0, true};
+    }
+
+    static KeyRun summarize(const Key* key)
+    {
+        return KeyRun{1, key->value, key->value, true};
+    }
+
+    static KeyRun combine(const KeyRun& smaller, const KeyRun& bigger)
+    {
+        if (smaller.count == 0)
+        {
+            return bigger;
+        }
+        if (bigger.count == 0)
+        {
+            return smaller;
+        }
+        bool increasing = smaller.increasing && bigger.increasing && smaller.last < bigger.first;
+        return KeyRun{smaller.count + bigger.count, smaller.first, bigger.last, increasing};
+    }
+};
+
+
+static bool same(long a, long b)
+{
+    return a == b;
+}
+
+static bool same(const KeyRun& a, const KeyRun& b)
+{
+    return a.count == b.count && a.increasing == b.increasing && (a.count == 0 || (a.first == b.first && a.last == b.last));
+}
+
+
+// returns true if the summary of every node is the combine of its left subtree, itself and its right subtree
+template <class augmentation, class node_type>
+static bool summaries_are_right(node_type* r)
+{
+    if (r == nullptr)
+    {
+        return true;
+    }
+    auto left = r->left == nullptr ? augmentation::identity() : r->left->summary;
+    auto right = r->right == nullptr ? augmentation::identity() : r->right->summary;
+    auto expected = augmentation::combine(augmentation::combine(left, augmentation::summarize(r->get_data())), right);
+    return same(r->summary, expected) && summaries_are_right<augmentation>(r->left) && summaries_are_right<augmentation>(r->right);
+}
+
+
+// checks the tree against 'expected' - contents, invariants, every summary, and aggregate over many ranges
+template <class augmentation, class tree_type>
+static void check_aggregates(tree_type& tree, std::vector<Key>& keys, const std::set<long>& expected)
+{
+    AVL_CHECK(avl_is_valid(tree));
+    AVL_CHECK(avl_holds_keys(tree, std::vector<long>(expected.begin(), expected.end())));
+    auto* root = tree.get_min_node();
+    while (root != nullptr && root->parent != nullptr)
+    {
+        root = root->parent;
+    }
+    AVL_CHECK(summaries_are_right<augmentation>(root));
+    const long n = static_cast<long>(keys.size());
+    for (long lo = 0; lo < n; lo += 7)
+    {
+        for (long hi = lo - 3; hi < n; hi += 31)
+        {
+            if (hi < 0)
+            {
+                continue;
+            }
+            auto by_hand = augmentation::identity();
+            for (auto it = expected.lower_bound(lo); it != expected.end() && *it <= hi; ++it)
+            {
+                by_hand = augmentation::combine(by_hand, augmentation::summarize(&keys[*it]));
+            }
+            AVL_CHECK(same(tree.aggregate(&keys[lo], &keys[hi]), by_hand));
+        }
+    }
+}
+
+
+template <class augmentation>
+static void check_tree(std::vector<Key>& keys)
+{
+    typedef AVLTree<Key, KeyCondition, AVLNodePool, void, augmentation> tree_type;
+    const long n = static_cast<long>(keys.size());
+    std::vector<Key*> sorted(n);
+    for (long i = 0; i < n; i++)
+    {
+        sorted[i] = &keys[i];
+    }
+    tree_type tree;
+    std::set<long> expected;
+    check_aggregates<augmentation>(tree, keys, expected);
+
+    // inserts in order and backwards rotate at every other insert, removes from the middle rotate on the way up
+    for (long i = 0; i < n / 2; i++)
+    {
+        tree.insert(&keys[i]);
+        tree.insert(&keys[n - 1 - i]);
+        expected.insert(i);
+        expected.insert(n - 1 - i);
+    }
+    check_aggregates<augmentation>(tree, keys, expected);
+    for (long i = 0; i < n; i += 3)
+    {
+        tree.remove(&keys[(i * 37) % n]);
+        expected.erase((i * 37) % n);
+    }
+    check_aggregates<augmentation>(tree, keys, expected);
+
+    // split and join move the summaries along with the nodes
+    tree_type smaller, bigger;
+    tree.split(&keys[n / 3], smaller, bigger);
+    std::set<long> expected_smaller(expected.begin(), expected.lower_bound(n / 3));
+    std::set<long> expected_bigger(expected.lower_bound(n / 3), expected.end());
+    check_aggregates<augmentation>(smaller, keys, expected_smaller);
+    check_aggregates<augmentation>(bigger, keys, expected_bigger);
+    tree.join(smaller, nullptr, bigger);
+    check_aggregates<augmentation>(tree, keys, expected);
+
+    // the batches and build_from_array
+    tree.erase_batch(sorted.data() + n / 4, static_cast<int>(n / 2), nullptr);
+    for (long i = n / 4; i < n / 4 + n / 2; i++)
+    {
+        expected.erase(i);
+    }
+    check_aggregates<augmentation>(tree, keys, expected);
+    tree.insert_batch(sorted.data(), static_cast<int>(n / 2), nullptr);
+    for (long i = 0; i < n / 2; i++)
+    {
+        expected.insert(i);
+    }
+    check_aggregates<augmentation>(tree, keys, expected);
+    tree.build_from_array(sorted.data() + 5, static_cast<int>(n - 10));
+    expected.clear();
+    for (long i = 5; i < n - 5; i++)
+    {
+        expected.insert(i);
+    }
+    check_aggregates<augmentation>(tree, keys, expected);
+}
+
+
+int main()
+{
+    const long n = 1000;
+    std::vector<Key> keys(n);
+    for (long i = 0; i < n; i++)
+    {
+        keys[i].value = i;
+    }
+
+    check_tree<KeySum>(keys);
+    check_tree<KeyRunSummary>(keys);
+
+    return avl_test_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,103 @@
+// insert_batch and erase_batch, on the per-key path (small batches) and on the rebuild path (big batches),
+// with the pool, with plain new/delete (so a sanitizer sees every freed node) and with a value owning tree
+
+#include "AVLTestUtils.h"
+
+#include <memory>
+#include <set>
+#include <vector>
+
+
+// builds the batch of keys[first, last) taking every 'step' key, sorted and without duplicates
+static std::vector<Key*> make_batch(std::vector<Key>& keys, long first, long last, long step)
+{
+    std::vector<Key*> batch;
+    for (long i = first; i < last; i += step)
+    {
+        batch.push_back(&keys[i]);
+    }
+    return batch;
+}
+
+
+template <class tree_type>
+static void check_batches(std::vector<Key>& keys)
+{
+    const long n = static_cast<long>(keys.size());
+    tree_type tree;
+    std::set<long> expected;
+
+    // into an empty tree - rebuild path
+    std::vector<Key*> batch = make_batch(keys, 0, n, 3);
+    std::vector<typename tree_type::node_type*> created(batch.size());
+    tree.insert_batch(batch.data(), static_cast<int>(batch.size()), created.data());
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        expected.insert(batch[i]->value);
+        AVL_CHECK(created[i] != nullptr && created[i]->get_data()->value == batch[i]->value);
+    }
+    AVL_CHECK(avl_is_valid(tree));
+    AVL_CHECK(avl_holds_keys(tree, std::vector<long>(expected.begin(), expected.end())));
+
+    // a small batch with keys already in the tree - per-key path
+    batch = make_batch(keys, 0, n, 97);
+    created.assign(batch.size(), nullptr);
+    tree.insert_batch(batch.data(), static_cast<int>(batch.size()), created.data());
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        bool is_new = expected.insert(batch[i]->value).second;
+        AVL_CHECK((created[i] != nullptr) == is_new);
+    }
+    AVL_CHECK(avl_is_valid(tree));
+    AVL_CHECK(avl_holds_keys(tree, std::vector<long>(expected.begin(), expected.end())));
+
+    // a small batch of removes with keys that aren't in the tree - per-key path
+    batch = make_batch(keys, 1, n, 89);
+    std::unique_ptr<bool[]> removed(new bool[batch.size()]);
+    tree.erase_batch(batch.data(), static_cast<int>(batch.size()), removed.get());
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        bool was_in = expected.erase(batch[i]->value) == 1;
+        AVL_CHECK(removed[i] == was_in);
+    }
+    AVL_CHECK(avl_is_valid(tree));
+    AVL_CHECK(avl_holds_keys(tree, std::vector<long>(expected.begin(), expected.end())));
+
+    // a big batch of removes, most of the tree - rebuild path
+    batch = make_batch(keys, 0, n, 2);
+    removed.reset(new bool[batch.size()]);
+    tree.erase_batch(batch.data(), static_cast<int>(batch.size()), removed.get());
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        bool was_in = expected.erase(batch[i]->value) == 1;
+        AVL_CHECK(removed[i] == was_in);
+    }
+    AVL_CHECK(avl_is_valid(tree));
+    AVL_CHECK(avl_holds_keys(tree, std::vector<long>(expected.begin(), expected.end())));
+
+    // a big batch of inserts into a tree that has nodes - rebuild path, then remove everything
+    batch = make_batch(keys, 0, n, 1);
+    tree.insert_batch(batch.data(), static_cast<int>(batch.size()), nullptr);
+    AVL_CHECK(avl_is_valid(tree));
+    AVL_CHECK(avl_holds_keys(tree, avl_range(0, n)));
+    tree.erase_batch(batch.data(), static_cast<int>(batch.size()), nullptr);
+    AVL_CHECK(avl_is_valid(tree));
+    AVL_CHECK(tree.get_num_of_nodes() == 0);
+}
+
+
+int main()
+{
+    const long n = 5000;
+    std::vector<Key> keys(n);
+    for (long i = 0; i < n; i++)
+    {
+        keys[i].value = i;
+    }
+
+    check_batches<AVLTree<Key, KeyCondition>>(keys);
+    check_batches<AVLTree<Key, KeyCondition, AVLNodeHeapAllocator>>(keys);
+    check_batches<AVLValueTree<Key, KeyCondition, AVLNodeHeapAllocator>>(keys);
+
+    return avl_test_failures == 0 ? 0 : 1;
+}
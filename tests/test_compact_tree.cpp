@@ -0,0 +1,193 @@
+// AVLCompactTree: the index links, the free list and the separate heights stay right through cycles of
+// removes and reinserts - checked by order, search, neighbors and the AVL bound on the height
+
+#include "AVLTestUtils.h"
+#include "../AVLCompactTree.h"
+
+#include <cmath>
+#include <iterator>
+#include <memory>
+#include <set>
+#include <vector>
+
+
+typedef AVLCompactTree<Key, KeyCondition> CompactTree;
+
+
+// returns true if the height of an AVL tree of n nodes is possible, floor(log2(n)) <= h < 1.44 * log2(n + 2)
+static bool height_is_avl(int height, int n)
+{
+    if (n == 0)
+    {
+        return height == -1;
+    }
+    return height >= static_cast<int>(std::floor(std::log2(n))) && height < 1.4405 * std::log2(n + 2.0);
+}
+
+
+// returns true if the tree holds exactly 'expected', and every key is found with its neighbors
+static bool holds_exactly(CompactTree& tree, std::vector<Key>& keys, const std::set<long>& expected)
+{
+    if (tree.get_num_of_nodes() != static_cast<int>(expected.size()))
+    {
+        return false;
+    }
+    if (!height_is_avl(tree.get_tree_height(), tree.get_num_of_nodes()))
+    {
+        return false;
+    }
+    std::unique_ptr<Key*[]> in_order(tree.inorder());
+    size_t index = 0;
+    for (long value : expected)
+    {
+        if (in_order[index++]->value != value)
+        {
+            return false;
+        }
+    }
+    for (long i = 0; i < static_cast<long>(keys.size()); i++)
+    {
+        auto found = expected.find(i);
+        bool in_tree = found != expected.end();
+        if ((tree.search(&keys[i]) == &keys[i]) != in_tree)
+        {
+            return false;
+        }
+        if (!in_tree)
+        {
+            continue;
+        }
+        Key* left = tree.get_closest_left(&keys[i]);
+        Key* right = tree.get_closest_right(&keys[i]);
+        auto next = std::next(found);
+        if ((found == expected.begin()) ? left != nullptr : (left == nullptr || left->value != *std::prev(found)))
+        {
+            return false;
+        }
+        if ((next == expected.end()) ? right != nullptr : (right == nullptr || right->value != *next))
+        {
+            return false;
+        }
+    }
+    Key* max = tree.get_max_node();
+    return expected.empty() ? max == nullptr : (max != nullptr && max->value == *expected.rbegin());
+}
+
+
+int main()
+{
+    const long n = 3000;
+    std::vector<Key> keys(n);
+    std::vector<Key*> sorted(n);
+    for (long i = 0; i < n; i++)
+    {
+        keys[i].value = i;
+        sorted[i] = &keys[i];
+    }
+
+    // an empty tree
+    {
+        CompactTree tree;
+        AVL_CHECK(holds_exactly(tree, keys, std::set<long>()));
+        AVL_CHECK(tree.inorder() == nullptr);
+        AVL_CHECK(!tree.remove(&keys[0]));
+    }
+
+    // inserts in order make every rotation on the right spine, removes of every few keys empty slots all over
+    // the vector, and reinserting them must reuse those slots instead of growing it
+    {
+        CompactTree tree;
+        std::set<long> expected;
+        tree.reserve(static_cast<int>(n));
+        for (long i = 0; i < n; i++)
+        {
+            AVL_CHECK(tree.insert(&keys[i]) == &keys[i]);
+            expected.insert(i);
+        }
+        AVL_CHECK(tree.insert(&keys[n / 2]) == nullptr);
+        AVL_CHECK(holds_exactly(tree, keys, expected));
+        long memory = tree.get_memory_usage();
+        for (int cycle = 0; cycle < 4; cycle++)
+        {
+            long step = 2 + cycle;
+            for (long i = cycle; i < n; i += step)
+            {
+                AVL_CHECK(tree.remove(&keys[i]));
+                expected.erase(i);
+            }
+            AVL_CHECK(!tree.remove(&keys[cycle]));
+            AVL_CHECK(holds_exactly(tree, keys, expected));
+            for (long i = n - 1 - cycle; i >= 0; i -= step)
+            {
+                if (expected.insert(i).second)
+                {
+                    AVL_CHECK(tree.insert(&keys[i]) == &keys[i]);
+                }
+            }
+            for (long i = cycle; i < n; i += step)
+            {
+                if (expected.insert(i).second)
+                {
+                    AVL_CHECK(tree.insert(&keys[i]) == &keys[i]);
+                }
+            }
+            AVL_CHECK(holds_exactly(tree, keys, expected));
+            AVL_CHECK(tree.get_memory_usage() == memory);
+        }
+
+        // remove everything from the middle out, then build from array over the emptied storage
+        for (long i = 0; i < n / 2; i++)
+        {
+            AVL_CHECK(tree.remove(&keys[n / 2 + i]));
+            AVL_CHECK(tree.remove(&keys[n / 2 - 1 - i]));
+        }
+        expected.clear();
+        AVL_CHECK(holds_exactly(tree, keys, expected));
+        tree.build_from_array(sorted.data(), static_cast<int>(n));
+        for (long i = 0; i < n; i++)
+        {
+            expected.insert(i);
+        }
+        AVL_CHECK(holds_exactly(tree, keys, expected));
+        AVL_CHECK(tree.get_memory_usage() == memory);
+    }
+
+    // 2^k - 1 keys inserted in order make a perfect tree, also when every slot was freed and reused before
+    {
+        const long perfect = 1023;
+        CompactTree tree;
+        std::set<long> expected;
+        for (int cycle = 0; cycle < 3; cycle++)
+        {
+            for (long i = 0; i < perfect; i++)
+            {
+                tree.insert(&keys[i]);
+                expected.insert(i);
+            }
+            AVL_CHECK(tree.get_tree_height() == 9);
+            AVL_CHECK(holds_exactly(tree, keys, expected));
+            for (long i = 0; i < perfect; i++)
+            {
+                AVL_CHECK(tree.remove(&keys[(i * 7) % perfect]));
+            }
+            expected.clear();
+            AVL_CHECK(holds_exactly(tree, keys, expected));
+        }
+    }
+
+    // a single node, removed and reinserted into its own freed slot
+    {
+        CompactTree tree;
+        std::set<long> expected = {7};
+        tree.insert(&keys[7]);
+        AVL_CHECK(holds_exactly(tree, keys, expected));
+        long memory = tree.get_memory_usage();
+        AVL_CHECK(tree.remove(&keys[7]));
+        AVL_CHECK(holds_exactly(tree, keys, std::set<long>()));
+        tree.insert(&keys[7]);
+        AVL_CHECK(holds_exactly(tree, keys, expected));
+        AVL_CHECK(tree.get_memory_usage() == memory);
+    }
+
+    return avl_test_failures == 0 ? 0 : 1;
+}
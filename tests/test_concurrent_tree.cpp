@@ -0,0 +1,133 @@
+// ConcurrentAVLTree under contention: threads insert and remove their own keys and race on shared ones,
+// every key ends up in the tree exactly when its successful inserts outnumber its successful removes,
+// and once the writers are done the tree has the nodes and the height of a balanced tree
+
+#include "AVLTestUtils.h"
+#include "../ConcurrentAVLTree.h"
+
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <thread>
+#include <vector>
+
+
+struct KeyValue
+{
+    long operator()(const Key* key) const
+    {
+        return key->value;
+    }
+};
+
+typedef ConcurrentAVLTree<Key, KeyValue> ConcurrentTree;
+
+static const int THREADS = 4;
+static const long OWN = 2000;       // keys [0, OWN * THREADS), thread t owns the keys equal to t modulo THREADS
+static const long SHARED = 500;     // keys [OWN * THREADS, OWN * THREADS + SHARED), every thread races on them
+
+
+// - sub function for the writers: inserts or removes the key, and counts a success in its net count
+static void change(ConcurrentTree& tree, std::vector<Key>& keys, long i, bool insert, std::atomic<int>* net, std::atomic<long>& failures)
+{
+    if (insert)
+    {
+        if (tree.insert(&keys[i]))
+        {
+            net[i]++;
+        }
+        return;
+    }
+    Key* removed = tree.remove(i);
+    if (removed != nullptr)
+    {
+        net[i]--;
+        if (removed != &keys[i])
+        {
+            failures++;
+        }
+    }
+}
+
+
+static void write(ConcurrentTree& tree, std::vector<Key>& keys, int t, std::atomic<int>* net, std::atomic<long>& failures)
+{
+    const long first_shared = OWN * THREADS;
+    unsigned long seed = 12345 + t;
+    for (int round = 0; round < 4; round++)
+    {
+        // every round inserts the own keys in order, racing on a random shared key after each one, then
+        // removes every second own key - the other half of them than the round before
+        for (long i = t; i < first_shared; i += THREADS)
+        {
+            change(tree, keys, i, true, net, failures);
+            seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+            long shared = first_shared + static_cast<long>((seed >> 33) % SHARED);
+            change(tree, keys, shared, ((seed >> 20) & 1) == 0, net, failures);
+            if (tree.search(i) != &keys[i])
+            {
+                failures++;
+            }
+        }
+        for (long i = t + (round % 2) * THREADS; i < first_shared; i += 2 * THREADS)
+        {
+            change(tree, keys, i, false, net, failures);
+            if (tree.search(i) != nullptr)
+            {
+                failures++;
+            }
+        }
+    }
+}
+
+
+int main()
+{
+    const long n = OWN * THREADS + SHARED;
+    std::vector<Key> keys(n);
+    for (long i = 0; i < n; i++)
+    {
+        keys[i].value = i;
+    }
+    std::unique_ptr<std::atomic<int>[]> net(new std::atomic<int>[n]);
+    for (long i = 0; i < n; i++)
+    {
+        net[i].store(0);
+    }
+
+    ConcurrentTree tree;
+    std::atomic<long> failures(0);
+    std::vector<std::thread> writers;
+    for (int t = 0; t < THREADS; t++)
+    {
+        writers.emplace_back(write, std::ref(tree), std::ref(keys), t, net.get(), std::ref(failures));
+    }
+    for (std::thread& writer : writers)
+    {
+        writer.join();
+    }
+    AVL_CHECK(failures.load() == 0);
+
+    // a key is in the tree exactly when one more insert than remove of it succeeded
+    long expected_nodes = 0;
+    for (long i = 0; i < n; i++)
+    {
+        int count = net[i].load();
+        AVL_CHECK(count == 0 || count == 1);
+        AVL_CHECK((tree.search(i) == &keys[i]) == (count == 1));
+        expected_nodes += count;
+    }
+    AVL_CHECK(tree.get_num_of_nodes() == expected_nodes);
+    AVL_CHECK(tree.get_tree_height() < 1.4405 * std::log2(n + 2.0));
+
+    // the nodes left by contention are removed one by one, and the tree is empty after
+    for (long i = 0; i < n; i++)
+    {
+        AVL_CHECK((tree.remove(i) != nullptr) == (net[i].load() == 1));
+    }
+    AVL_CHECK(tree.get_num_of_nodes() == 0);
+    AVL_CHECK(tree.get_tree_height() == -1);
+    AVL_CHECK(tree.insert(&keys[0]) && tree.search(0) == &keys[0] && tree.get_num_of_nodes() == 1);
+
+    return avl_test_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,143 @@
+// AVLFrozenTree made by freeze(), checked against std::set for search, bounds and neighbors - on the Eytzinger
+// descent with the condition, on cached keys that aren't integral, and on the SIMD block index of integral keys,
+// for sizes of 0, 1, around the block sizes and not a power of two
+
+#include "AVLTestUtils.h"
+#include "../AVLFrozenTree.h"
+
+#include <iterator>
+#include <set>
+#include <type_traits>
+#include <vector>
+
+
+struct LongKey
+{
+    using key_type = long;
+    long operator()(const Key* key) const
+    {
+        return key->value;
+    }
+};
+
+struct IntKey
+{
+    using key_type = int;
+    int operator()(const Key* key) const
+    {
+        return static_cast<int>(key->value);
+    }
+};
+
+struct DoubleKey
+{
+    using key_type = double;
+    double operator()(const Key* key) const
+    {
+        return static_cast<double>(key->value);
+    }
+};
+
+
+// returns the value of the data, or a value that no key has for nullptr
+static long value_of(const Key* key)
+{
+    return key == nullptr ? -1000 : key->value;
+}
+
+// returns the value at 'it', or a value that no key has for the end of the set
+static long value_of(const std::set<long>& expected, std::set<long>::const_iterator it)
+{
+    return it == expected.end() ? -1000 : *it;
+}
+
+
+// checks every operation of the snapshot of the odd keys below 2 * size, probing with every key around them
+template <class frozen_type>
+static void check_against_set(const frozen_type& frozen, std::vector<Key>& keys, long size)
+{
+    std::set<long> expected;
+    for (long i = 0; i < size; i++)
+    {
+        expected.insert(2 * i + 1);
+    }
+    AVL_CHECK(frozen.get_num_of_nodes() == size);
+    for (long i = 0; i <= 2 * size + 1; i++)
+    {
+        const Key* probe = &keys[i];
+        auto lower = expected.lower_bound(i);
+        auto upper = expected.upper_bound(i);
+        bool in_set = expected.count(i) == 1;
+        AVL_CHECK(value_of(frozen.search(probe)) == (in_set ? i : -1000));
+        AVL_CHECK(value_of(frozen.lower_bound(probe)) == value_of(expected, lower));
+        AVL_CHECK(value_of(frozen.upper_bound(probe)) == value_of(expected, upper));
+        long left = (in_set && lower != expected.begin()) ? *std::prev(lower) : -1000;
+        long right = in_set ? value_of(expected, upper) : -1000;
+        AVL_CHECK(value_of(frozen.get_closest_left(probe)) == left);
+        AVL_CHECK(value_of(frozen.get_closest_right(probe)) == right);
+    }
+}
+
+
+// checks the lightweight key probes of a snapshot with a key extractor
+template <class frozen_type>
+static void check_key_probes(const frozen_type& frozen, long size)
+{
+    std::set<long> expected;
+    for (long i = 0; i < size; i++)
+    {
+        expected.insert(2 * i + 1);
+    }
+    for (long i = -1; i <= 2 * size + 1; i++)
+    {
+        typename frozen_type::key_type probe = static_cast<typename frozen_type::key_type>(i);
+        AVL_CHECK(value_of(frozen.search(probe)) == (expected.count(i) == 1 ? i : -1000));
+        AVL_CHECK(value_of(frozen.lower_bound(probe)) == value_of(expected, expected.lower_bound(i)));
+        AVL_CHECK(value_of(frozen.upper_bound(probe)) == value_of(expected, expected.upper_bound(i)));
+    }
+}
+
+
+template <class key_extractor>
+static void check_sizes(std::vector<Key>& keys, const std::vector<long>& sizes)
+{
+    typedef AVLTree<Key, KeyCondition, AVLNodePool, key_extractor> tree_type;
+    for (long size : sizes)
+    {
+        tree_type tree;
+        for (long i = 0; i < size; i++)
+        {
+            tree.insert(&keys[2 * i + 1]);
+        }
+        auto frozen = tree.freeze();
+        check_against_set(frozen, keys, size);
+        if constexpr (!std::is_void<key_extractor>::value)
+        {
+            check_key_probes(frozen, size);
+        }
+    }
+}
+
+
+int main()
+{
+    // blocks hold 8 longs or 16 ints - the sizes fill blocks and levels of the block index partly and fully
+    const std::vector<long> sizes = {0, 1, 2, 3, 5, 7, 8, 9, 15, 16, 17, 63, 64, 65, 71, 72, 73, 100, 143, 145, 1000, 4097};
+    std::vector<Key> keys(2 * 4097 + 2);
+    for (long i = 0; i < static_cast<long>(keys.size()); i++)
+    {
+        keys[i].value = i;
+    }
+
+    check_sizes<void>(keys, sizes);
+    check_sizes<DoubleKey>(keys, sizes);
+    check_sizes<LongKey>(keys, sizes);
+    check_sizes<IntKey>(keys, sizes);
+
+    // an empty snapshot that was never made by freeze
+    AVLFrozenTree<Key, KeyCondition, LongKey> empty;
+    check_against_set(empty, keys, 0);
+    check_key_probes(empty, 0);
+
+    return avl_test_failures == 0 ? 0 : 1;
+}
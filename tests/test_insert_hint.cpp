@@ -0,0 +1,139 @@
+// insert_hint from hints near and far from the data, its one comparison appends, and the min/max fingers
+// kept right by inserts, removes, split, join, the batches and build_from_array
+
+#include "AVLTestUtils.h"
+
+#include <set>
+#include <vector>
+
+
+// KeyCondition that counts its calls, to check how many comparisons insert_hint makes
+static long condition_calls = 0;
+
+struct CountingCondition
+{
+    Comparison operator()(const Key* a, const Key* b) const
+    {
+        condition_calls++;
+        return KeyCondition()(a, b);
+    }
+};
+
+typedef AVLTree<Key, KeyCondition> Tree;
+typedef AVLTree<Key, CountingCondition> CountedTree;
+
+
+int main()
+{
+    const long n = 2000;
+    std::vector<Key> keys(n);
+    std::vector<Key*> sorted(n);
+    for (long i = 0; i < n; i++)
+    {
+        keys[i].value = i;
+        sorted[i] = &keys[i];
+    }
+
+    // appending after the max node (hint nullptr) and prepending before the min node take one comparison each
+    {
+        CountedTree tree;
+        condition_calls = 0;
+        for (long i = n / 2; i < n; i++)
+        {
+            AVL_CHECK(tree.insert_hint(nullptr, &keys[i]) != nullptr);
+        }
+        for (long i = n / 2 - 1; i >= 0; i--)
+        {
+            AVL_CHECK(tree.insert_hint(tree.get_min_node(), &keys[i]) != nullptr);
+        }
+        AVL_CHECK(condition_calls == n - 1);
+        AVL_CHECK(avl_is_valid(tree));
+        AVL_CHECK(avl_holds_range(tree, 0, n));
+        AVL_CHECK(tree.insert_hint(nullptr, &keys[n - 1]) == nullptr);
+        AVL_CHECK(tree.insert_hint(tree.get_min_node(), &keys[0]) == nullptr);
+        AVL_CHECK(tree.get_num_of_nodes() == n);
+    }
+
+    // hints next to the data, a few nodes away, and at the other end of the tree
+    for (long distance : {1L, 5L, 100L, n})
+    {
+        Tree tree;
+        std::set<long> expected;
+        for (long i = 0; i < n; i += 4)
+        {
+            tree.insert(&keys[i]);
+            expected.insert(i);
+        }
+        for (long i = 1; i < n; i += 2)
+        {
+            long near = (i + distance) % n;
+            Tree::node_type* hint = tree.search(&keys[near - near % 4]);
+            AVL_CHECK(hint != nullptr);
+            Tree::node_type* created = tree.insert_hint(hint, &keys[i]);
+            AVL_CHECK(created != nullptr && created->data == &keys[i]);
+            AVL_CHECK(tree.insert_hint(hint, &keys[i]) == nullptr);
+            expected.insert(i);
+        }
+        AVL_CHECK(avl_is_valid(tree));
+        AVL_CHECK(avl_holds_keys(tree, std::vector<long>(expected.begin(), expected.end())));
+    }
+
+    // the fingers follow removes of the ends, split, join, the batches and build_from_array
+    {
+        Tree tree;
+        for (long i = 0; i < n; i++)
+        {
+            tree.insert_hint(nullptr, &keys[i]);
+        }
+        long first = 0;
+        long last = n;
+        for (long i = 0; i < 10; i++)
+        {
+            AVL_CHECK(tree.remove(&keys[first++]));
+            AVL_CHECK(tree.remove(&keys[--last]));
+            AVL_CHECK(avl_is_valid(tree));
+            AVL_CHECK(tree.get_min_node()->data == &keys[first] && tree.get_max_node()->data == &keys[last - 1]);
+        }
+        AVL_CHECK(avl_holds_range(tree, first, last));
+
+        Tree smaller, bigger;
+        tree.split(&keys[n / 2], smaller, bigger);
+        AVL_CHECK(avl_is_valid(tree) && avl_is_valid(smaller) && avl_is_valid(bigger));
+        AVL_CHECK(avl_holds_range(smaller, first, n / 2) && avl_holds_range(bigger, n / 2, last));
+        smaller.insert_hint(nullptr, &keys[n / 2]);
+        bigger.insert_hint(bigger.get_min_node(), &keys[first - 1]);
+        AVL_CHECK(smaller.get_max_node()->data == &keys[n / 2] && bigger.get_min_node()->data == &keys[first - 1]);
+        AVL_CHECK(avl_is_valid(smaller) && avl_is_valid(bigger));
+        smaller.remove(&keys[n / 2]);
+        bigger.remove(&keys[first - 1]);
+
+        tree.join(smaller, nullptr, bigger);
+        AVL_CHECK(avl_is_valid(tree));
+        AVL_CHECK(avl_holds_range(tree, first, last));
+
+        tree.erase_batch(sorted.data() + first, 100, nullptr);
+        AVL_CHECK(avl_is_valid(tree));
+        AVL_CHECK(avl_holds_range(tree, first + 100, last));
+        tree.insert_batch(sorted.data(), first + 100, nullptr);
+        tree.insert_batch(sorted.data() + last, static_cast<int>(n - last), nullptr);
+        AVL_CHECK(avl_is_valid(tree));
+        AVL_CHECK(avl_holds_range(tree, 0, n));
+        AVL_CHECK(tree.get_min_node()->data == &keys[0] && tree.get_max_node()->data == &keys[n - 1]);
+
+        tree.build_from_array(sorted.data() + 10, 50);
+        AVL_CHECK(avl_is_valid(tree));
+        AVL_CHECK(avl_holds_range(tree, 10, 60));
+        AVL_CHECK(tree.insert_hint(nullptr, &keys[60]) != nullptr && tree.insert_hint(tree.get_min_node(), &keys[9]) != nullptr);
+        AVL_CHECK(avl_is_valid(tree));
+        AVL_CHECK(avl_holds_range(tree, 9, 61));
+
+        for (long i = 9; i < 61; i++)
+        {
+            tree.remove(&keys[i]);
+        }
+        AVL_CHECK(avl_is_valid(tree));
+        AVL_CHECK(tree.get_min_node() == nullptr && tree.get_max_node() == nullptr);
+    }
+
+    return avl_test_failures == 0 ? 0 : 1;
+}
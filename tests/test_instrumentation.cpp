@@ -0,0 +1,93 @@
+// AVLStatsCounter: every comparison of a descent is recorded in the depth histograms - plain inserts and searches,
+// insert_hint, the neighbor queries, bounds and ranks - and the counters of rotations and allocations
+
+#include "AVLTestUtils.h"
+
+#include <vector>
+
+
+typedef AVLTree<Key, KeyCondition, AVLNodePool, void, void, AVLStatsCounter> CountedTree;
+
+
+// returns the sum of the depths recorded for operation, weighted by how many descents had them
+static long recorded_depths(const AVLTreeStats& stats, AVLDescent operation)
+{
+    long total = 0;
+    for (int depth = 0; depth < AVLTreeStats::MAX_DEPTH; depth++)
+    {
+        total += depth * stats.get_descents(operation, depth);
+    }
+    return total;
+}
+
+// returns how many descents were recorded for operation
+static long recorded_descents(const AVLTreeStats& stats, AVLDescent operation)
+{
+    long total = 0;
+    for (int depth = 0; depth < AVLTreeStats::MAX_DEPTH; depth++)
+    {
+        total += stats.get_descents(operation, depth);
+    }
+    return total;
+}
+
+
+int main()
+{
+    const long n = 2000;
+    std::vector<Key> keys(2 * n + 2);
+    for (long i = 0; i < 2 * n + 2; i++)
+    {
+        keys[i].value = i;
+    }
+
+    CountedTree tree;
+    for (long i = 0; i < n; i++)
+    {
+        tree.insert(&keys[2 * i + 1]);
+    }
+    AVLTreeStats stats = tree.get_tree_stats();
+    AVL_CHECK(stats.allocations == n);
+    AVL_CHECK(recorded_descents(stats, AVLDescent::INSERT) == n);
+    AVL_CHECK(recorded_depths(stats, AVLDescent::INSERT) == stats.comparisons);
+    AVL_CHECK(stats.get_rotations(AVLRotation::RR) > 0);
+
+    // neighbor queries, bounds and ranks are searches - each records one descent, as deep as its comparisons
+    tree.reset_tree_stats();
+    for (long i = 0; i < 2 * n + 2; i++)
+    {
+        tree.get_closest_left(&keys[i]);
+        tree.get_closest_right(&keys[i]);
+        tree.lower_bound(&keys[i]);
+        tree.upper_bound(&keys[i]);
+        tree.rank(&keys[i]);
+    }
+    stats = tree.get_tree_stats();
+    AVL_CHECK(recorded_descents(stats, AVLDescent::SEARCH) == 5 * (2 * n + 2));
+    AVL_CHECK(recorded_depths(stats, AVLDescent::SEARCH) == stats.comparisons);
+
+    // insert_hint records its climb and descent as one insert descent, also when the hint is a finger
+    tree.reset_tree_stats();
+    long inserted = 0;
+    for (long i = 0; i < n; i++)
+    {
+        CountedTree::node_type* hint = tree.search(&keys[2 * i + 1]);
+        inserted += tree.insert_hint(hint, &keys[2 * i]) != nullptr;
+    }
+    inserted += tree.insert_hint(nullptr, &keys[2 * n]) != nullptr;
+    inserted += tree.insert_hint(tree.get_max_node(), &keys[2 * n + 1]) != nullptr;
+    AVL_CHECK(tree.insert_hint(tree.get_min_node(), &keys[0]) == nullptr);
+    stats = tree.get_tree_stats();
+    AVL_CHECK(inserted == n + 2);
+    AVL_CHECK(stats.allocations == n + 2);
+    AVL_CHECK(recorded_descents(stats, AVLDescent::INSERT) == n + 3);
+    AVL_CHECK(recorded_descents(stats, AVLDescent::SEARCH) == n);
+    AVL_CHECK(recorded_depths(stats, AVLDescent::INSERT) + recorded_depths(stats, AVLDescent::SEARCH) == stats.comparisons);
+    AVL_CHECK(avl_is_valid(tree));
+    AVL_CHECK(avl_holds_range(tree, 0, 2 * n + 2));
+
+    tree.reset_tree_stats();
+    AVL_CHECK(tree.get_tree_stats().comparisons == 0 && recorded_descents(tree.get_tree_stats(), AVLDescent::SEARCH) == 0);
+
+    return avl_test_failures == 0 ? 0 : 1;
+}
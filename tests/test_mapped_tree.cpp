@@ -0,0 +1,154 @@
+// AVLTree::save -> AVLMappedTree::load_mmap -> promote, and load_mmap rejecting corrupt images
+
+#include "AVLTestUtils.h"
+#include "../AVLMappedTree.h"
+
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <vector>
+
+
+typedef AVLTree<Key, KeyCondition> Tree;
+typedef AVLMappedTree<Key, KeyCondition> MappedTree;
+
+static const char* IMAGE_PATH = "test_mapped_tree.image";
+static const char* BROKEN_PATH = "test_mapped_tree.broken";
+
+
+static std::vector<char> read_file(const char* path)
+{
+    std::vector<char> bytes;
+    std::FILE* file = std::fopen(path, "rb");
+    if (file == nullptr)
+    {
+        return bytes;
+    }
+    char buffer[4096];
+    size_t read;
+    while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        bytes.insert(bytes.end(), buffer, buffer + read);
+    }
+    std::fclose(file);
+    return bytes;
+}
+
+
+static void write_file(const char* path, const std::vector<char>& bytes)
+{
+    std::FILE* file = std::fopen(path, "wb");
+    if (file != nullptr)
+    {
+        std::fwrite(bytes.data(), 1, bytes.size(), file);
+        std::fclose(file);
+    }
+}
+
+
+// returns the data of the mapped tree between lo and hi by order
+static std::vector<long> values_in_range(MappedTree& mapped, long lo, long hi)
+{
+    Key low = {lo};
+    Key high = {hi};
+    std::vector<long> values;
+    mapped.for_each_in_range(&low, &high, [&](const Key* key) { values.push_back(key->value); });
+    return values;
+}
+
+
+// returns true if a copy of the image, changed by 'corrupt', is rejected by load_mmap and leaves the tree empty
+template <class corruption>
+static bool rejects(const std::vector<char>& image, corruption corrupt)
+{
+    std::vector<char> broken = image;
+    corrupt(broken);
+    write_file(BROKEN_PATH, broken);
+    MappedTree mapped;
+    bool rejected = !mapped.load_mmap(BROKEN_PATH) && !mapped.is_mapped() && mapped.get_num_of_nodes() == 0;
+    std::remove(BROKEN_PATH);
+    return rejected;
+}
+
+
+int main()
+{
+    const long n = 1001;
+    std::vector<Key> keys(2 * n + 1);
+    for (long i = 0; i <= 2 * n; i++)
+    {
+        keys[i].value = i;
+    }
+
+    // the image holds the even keys, read in place while mapped
+    Tree tree;
+    std::set<long> expected;
+    for (long i = 0; i < n; i++)
+    {
+        tree.insert(&keys[2 * i]);
+        expected.insert(2 * i);
+    }
+    AVL_CHECK(tree.save(IMAGE_PATH));
+    {
+        MappedTree mapped;
+        AVL_CHECK(mapped.load_mmap(IMAGE_PATH));
+        AVL_CHECK(mapped.is_mapped());
+        AVL_CHECK(mapped.get_num_of_nodes() == n);
+        for (long i = 0; i < 2 * n; i++)
+        {
+            const Key* found = mapped.search(&keys[i]);
+            AVL_CHECK((found != nullptr) == (i % 2 == 0));
+            AVL_CHECK(found == nullptr || found->value == i);
+        }
+        const Key* left = mapped.get_closest_left(&keys[10]);
+        const Key* right = mapped.get_closest_right(&keys[10]);
+        AVL_CHECK(left != nullptr && left->value == 8);
+        AVL_CHECK(right != nullptr && right->value == 12);
+        AVL_CHECK(mapped.get_closest_left(&keys[0]) == nullptr);
+        AVL_CHECK(mapped.get_closest_right(&keys[2 * n - 2]) == nullptr);
+        AVL_CHECK(values_in_range(mapped, 3, 11) == std::vector<long>({4, 6, 8, 10}));
+
+        // the first change promotes the image into an AVLTree that owns copies of the data
+        AVL_CHECK(mapped.insert(new Key{1}));
+        expected.insert(1);
+        AVL_CHECK(!mapped.is_mapped());
+        AVL_CHECK(mapped.remove_and_erase(&keys[4]));
+        expected.erase(4);
+        AVL_CHECK(mapped.get_num_of_nodes() == static_cast<int>(expected.size()));
+        AVL_CHECK(values_in_range(mapped, 0, 2 * n) == std::vector<long>(expected.begin(), expected.end()));
+        AVL_CHECK(avl_is_valid(mapped.promote()));
+    }
+
+    // an empty tree saves and loads
+    {
+        Tree empty;
+        AVL_CHECK(empty.save(BROKEN_PATH));
+        MappedTree mapped;
+        AVL_CHECK(mapped.load_mmap(BROKEN_PATH));
+        AVL_CHECK(mapped.get_num_of_nodes() == 0 && mapped.search(&keys[0]) == nullptr);
+        std::remove(BROKEN_PATH);
+    }
+
+    // corrupt images are rejected - by the header, or by the check of every node
+    std::vector<char> image = read_file(IMAGE_PATH);
+    AVLImageHeader header;
+    std::memcpy(&header, image.data(), sizeof(header));
+    auto node_at = [&header](std::vector<char>& bytes, uint32_t place) {
+        return reinterpret_cast<AVLImageNode*>(bytes.data() + header.nodes) + place;
+    };
+    AVL_CHECK(image.size() == header.file_size);
+    AVL_CHECK(!rejects(image, [](std::vector<char>&) {}));
+    AVL_CHECK(rejects(image, [](std::vector<char>& bytes) { bytes[0] = 'X'; }));
+    AVL_CHECK(rejects(image, [](std::vector<char>& bytes) { bytes.resize(bytes.size() - 1); }));
+    AVL_CHECK(rejects(image, [](std::vector<char>& bytes) { bytes.resize(sizeof(AVLImageHeader) - 1); }));
+    AVL_CHECK(rejects(image, [&](std::vector<char>& bytes) { node_at(bytes, header.root)->left = header.num_of_nodes; }));
+    AVL_CHECK(rejects(image, [&](std::vector<char>& bytes) { node_at(bytes, 0)->left = header.root; }));
+    AVL_CHECK(rejects(image, [&](std::vector<char>& bytes) { node_at(bytes, header.root)->right = header.root; }));
+    AVL_CHECK(rejects(image, [&](std::vector<char>& bytes) { node_at(bytes, header.root)->right = AVLImageHeader::NIL; }));
+    AVL_CHECK(rejects(image, [&](std::vector<char>& bytes) { node_at(bytes, n - 1)->data = header.file_size; }));
+    AVL_CHECK(rejects(image, [&](std::vector<char>& bytes) { node_at(bytes, 5)->data += 1; }));
+    AVL_CHECK(rejects(image, [&](std::vector<char>& bytes) { node_at(bytes, 5)->data = node_at(bytes, 4)->data; }));
+
+    std::remove(IMAGE_PATH);
+    return avl_test_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+// moving and cloning trees: moves don't throw (so containers move trees instead of failing to copy them),
+// and a moved or new tree without an allocator works like any empty tree
+
+#include "AVLTestUtils.h"
+
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+typedef AVLTree<Key, KeyCondition> Tree;
+
+static_assert(std::is_nothrow_default_constructible<Tree>::value, "a new tree must not allocate");
+static_assert(std::is_nothrow_move_constructible<Tree>::value, "moving a tree must not throw");
+static_assert(std::is_nothrow_move_assignable<Tree>::value, "moving a tree must not throw");
+
+
+int main()
+{
+    const long n = 1000;
+    std::vector<Key> keys(n);
+    for (long i = 0; i < n; i++)
+    {
+        keys[i].value = i;
+    }
+
+    // a vector of trees moves them when it grows, and their nodes stay where they were
+    {
+        std::vector<Tree> trees;
+        std::vector<Tree::node_type*> first_nodes;
+        for (long t = 0; t < 10; t++)
+        {
+            trees.emplace_back();
+            for (long i = t * 100; i < (t + 1) * 100; i++)
+            {
+                trees.back().insert(&keys[i]);
+            }
+            first_nodes.push_back(trees.back().search(&keys[t * 100]));
+        }
+        for (long t = 0; t < 10; t++)
+        {
+            AVL_CHECK(avl_holds_range(trees[t], t * 100, (t + 1) * 100));
+            AVL_CHECK(trees[t].search(&keys[t * 100]) == first_nodes[t]);
+        }
+    }
+
+    // a moved from tree is empty and can be used again
+    {
+        Tree tree;
+        for (long i = 0; i < n; i++)
+        {
+            tree.insert(&keys[i]);
+        }
+        Tree moved(std::move(tree));
+        AVL_CHECK(avl_holds_range(moved, 0, n));
+        AVL_CHECK(tree.get_num_of_nodes() == 0);
+        AVL_CHECK(tree.get_pool_stats().in_use == 0);
+        tree.insert(&keys[0]);
+        AVL_CHECK(avl_holds_range(tree, 0, 1));
+        tree = std::move(moved);
+        AVL_CHECK(avl_holds_range(tree, 0, n));
+        AVL_CHECK(avl_holds_range(moved, 0, 0));
+    }
+
+    // move assignment over a big tree whose nodes must be freed one by one frees them on this thread
+    {
+        const long big = 3 * AVL_PARALLEL_CUTOFF;
+        std::vector<Key> many(big);
+        std::vector<Key*> sorted(big);
+        for (long i = 0; i < big; i++)
+        {
+            many[i].value = i;
+            sorted[i] = &many[i];
+        }
+        AVLTree<Key, KeyCondition, AVLNodeHeapAllocator> tree, small;
+        tree.set_num_of_threads(0);
+        tree.build_from_array(sorted.data(), static_cast<int>(big));
+        small.insert(&keys[0]);
+        tree = std::move(small);
+        AVL_CHECK(avl_holds_range(tree, 0, 1));
+        AVL_CHECK(tree.get_pool_stats().in_use == 1);
+    }
+
+    // trees that never allocated take part in split, join, the set operations and clone
+    {
+        Tree full, empty, other;
+        for (long i = 0; i < n; i++)
+        {
+            full.insert(&keys[i]);
+        }
+        empty.split(&keys[n / 2], empty, other);
+        AVL_CHECK(avl_holds_range(empty, 0, 0) && avl_holds_range(other, 0, 0));
+        empty.join(empty, nullptr, other);
+        AVL_CHECK(avl_holds_range(empty, 0, 0));
+        empty.unite(full);
+        AVL_CHECK(avl_holds_range(empty, 0, n));
+        Tree none;
+        empty.intersect(none);
+        AVL_CHECK(avl_holds_range(empty, 0, 0));
+        Tree copy = none.clone();
+        AVL_CHECK(avl_holds_range(copy, 0, 0));
+    }
+
+    // a node extracted from one tree is inserted into a tree that never allocated
+    {
+        AVLValueTree<Key, KeyCondition> values;
+        for (long i = 0; i < n; i++)
+        {
+            values.emplace(Key{i});
+        }
+        AVLValueTree<Key, KeyCondition> other;
+        AVL_CHECK(other.insert(values.extract(&keys[n / 2])) != nullptr);
+        AVL_CHECK(values.get_num_of_nodes() == n - 1);
+        AVL_CHECK(other.get_num_of_nodes() == 1 && other.search(&keys[n / 2]) != nullptr);
+    }
+
+    return avl_test_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,129 @@
+// AVLNodePool absorb, and trees with different allocators exchanging nodes without copying them
+
+#include "AVLTestUtils.h"
+
+#include <vector>
+
+
+typedef AVLTree<Key, KeyCondition> Tree;
+
+
+int main()
+{
+    const long n = 10000;
+    std::vector<Key> keys(n);
+    for (long i = 0; i < n; i++)
+    {
+        keys[i].value = i;
+    }
+
+    // absorb keeps every slab and free node of both pools, and the absorbed nodes can be freed to the absorbing pool
+    {
+        AVLNodePool<int> pool;
+        AVLNodePool<int> other;
+        std::vector<int*> nodes;
+        for (int i = 0; i < 1000; i++)
+        {
+            nodes.push_back(other.allocate(i));
+            pool.allocate(i);
+        }
+        for (int i = 0; i < 100; i++)
+        {
+            other.deallocate(nodes[i]);
+        }
+        AVLPoolStats before = pool.get_stats();
+        AVLPoolStats absorbed = other.get_stats();
+        pool.absorb(other);
+        AVLPoolStats after = pool.get_stats();
+        AVL_CHECK(after.num_of_slabs == before.num_of_slabs + absorbed.num_of_slabs);
+        AVL_CHECK(after.in_use == 1900);
+        AVL_CHECK(after.free_list_length == 100);
+        AVL_CHECK(other.get_stats().num_of_slabs == 0);
+        for (int i = 100; i < 1000; i++)
+        {
+            pool.deallocate(nodes[i]);
+        }
+        AVL_CHECK(pool.get_stats().free_list_length == 1000);
+        // the free nodes of both pools are reused before new slabs are taken
+        long slabs = pool.get_stats().num_of_slabs;
+        for (int i = 0; i < 1000; i++)
+        {
+            pool.allocate(i);
+        }
+        AVL_CHECK(pool.get_stats().num_of_slabs == slabs);
+        AVL_CHECK(pool.get_stats().free_list_length == 0);
+    }
+
+    // join of trees built apart takes the nodes of both without allocating
+    {
+        Tree smaller, bigger;
+        for (long i = 0; i < n / 2; i++)
+        {
+            smaller.insert(&keys[i]);
+        }
+        for (long i = n / 2; i < n; i++)
+        {
+            bigger.insert(&keys[i]);
+        }
+        long allocations = smaller.get_pool_stats().total_allocations + bigger.get_pool_stats().total_allocations;
+        smaller.join(smaller, nullptr, bigger);
+        AVL_CHECK(avl_holds_range(smaller, 0, n));
+        AVL_CHECK(smaller.get_pool_stats().total_allocations == allocations);
+        AVL_CHECK(smaller.get_pool_stats().in_use == n);
+    }
+
+    // unite with a tree whose allocator is shared after a split: this tree moves into the shared allocator
+    {
+        Tree tree, low, high, other;
+        Key boundary = {n / 2};
+        for (long i = 0; i < n; i += 2)
+        {
+            tree.insert(&keys[i]);
+        }
+        for (long i = 1; i < n; i += 2)
+        {
+            other.insert(&keys[i]);
+        }
+        tree.split(&boundary, low, high);
+        long allocations = low.get_pool_stats().total_allocations + other.get_pool_stats().total_allocations;
+        other.unite(low);
+        AVL_CHECK(other.get_num_of_nodes() == n / 2 + n / 4);
+        AVL_CHECK(other.get_pool_stats().total_allocations == allocations);
+        other.unite(high);
+        AVL_CHECK(avl_holds_range(other, 0, n));
+    }
+
+    // nodes handed to a tree with another pool: the slabs go to a keeper, so either pool can be released alone
+    {
+        AVLNodePool<Tree::node_type> keeper;
+        Tree* from = new Tree();
+        Tree to, moved;
+        Key boundary = {n / 2};
+        for (long i = 0; i < n; i++)
+        {
+            from->insert(&keys[i]);
+        }
+        long slabs = from->get_pool_stats().num_of_slabs;
+        from->split(&boundary, *from, moved);
+        moved.hand_slabs_to(keeper);
+        AVL_CHECK(keeper.get_stats().num_of_slabs == slabs);
+        AVL_CHECK(from->get_pool_stats().num_of_slabs == 0);
+        to.join(moved, nullptr, to);
+        AVL_CHECK(avl_holds_range(to, n / 2, n));
+        AVL_CHECK(avl_holds_range(moved, 0, 0));
+        // the tree that gave the nodes away drops its own at once, the given nodes stay in the keeper's slabs
+        delete from;
+        for (long i = n / 2; i < n; i += 2)
+        {
+            to.remove(&keys[i]);
+        }
+        for (long i = n / 2; i < n; i += 2)
+        {
+            to.insert(&keys[i]);
+        }
+        AVL_CHECK(avl_holds_range(to, n / 2, n));
+        AVL_CHECK(avl_is_valid(to));
+    }
+
+    return avl_test_failures == 0 ? 0 : 1;
+}
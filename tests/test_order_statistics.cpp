@@ -0,0 +1,68 @@
+// rank, select and count_between, on a plain tree and on an instrumented one that must count every comparison
+
+#include "AVLTestUtils.h"
+
+#include <vector>
+
+
+// KeyCondition that counts its calls, to check them against the comparisons the instrumentation counted
+static long condition_calls = 0;
+
+struct CountingCondition
+{
+    Comparison operator()(const Key* a, const Key* b) const
+    {
+        condition_calls++;
+        return KeyCondition()(a, b);
+    }
+};
+
+typedef AVLTree<Key, KeyCondition> Tree;
+typedef AVLTree<Key, CountingCondition, AVLNodePool, void, void, AVLStatsCounter> CountedTree;
+
+
+int main()
+{
+    const long n = 1000;
+    std::vector<Key> keys(2 * n + 1);
+    for (long i = 0; i <= 2 * n; i++)
+    {
+        keys[i].value = i;
+    }
+
+    // the tree holds the even keys, so every odd key is a probe between two nodes
+    {
+        Tree tree;
+        for (long i = 0; i < n; i++)
+        {
+            tree.insert(&keys[2 * i]);
+        }
+        AVL_CHECK(tree.rank(&keys[0]) == 0);
+        AVL_CHECK(tree.rank(&keys[11]) == 6);
+        AVL_CHECK(tree.select(6)->data == &keys[12]);
+        AVL_CHECK(tree.count_between(&keys[0], &keys[2 * n]) == n);
+        AVL_CHECK(tree.count_between(&keys[10], &keys[20]) == 6);
+        AVL_CHECK(tree.count_between(&keys[11], &keys[19]) == 4);
+        AVL_CHECK(tree.count_between(&keys[11], &keys[11]) == 0);
+        AVL_CHECK(tree.count_between(&keys[12], &keys[12]) == 1);
+        AVL_CHECK(tree.count_between(&keys[20], &keys[10]) == 0);
+        AVL_CHECK(tree.count_between(&keys[21], &keys[19]) == 0);
+    }
+
+    // count_between compares only through the tree, so the instrumentation sees all its comparisons
+    {
+        CountedTree tree;
+        for (long i = 0; i < n; i++)
+        {
+            tree.insert(&keys[2 * i]);
+        }
+        tree.reset_tree_stats();
+        condition_calls = 0;
+        AVL_CHECK(tree.count_between(&keys[100], &keys[301]) == 101);
+        AVL_CHECK(tree.count_between(&keys[301], &keys[100]) == 0);
+        AVL_CHECK(condition_calls > 0);
+        AVL_CHECK(tree.get_tree_stats().comparisons == condition_calls);
+    }
+
+    return avl_test_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,90 @@
+// the parallel functions of AVLTree: build, export, clone, erase_data and freeing all nodes split into subtree tasks
+
+#include "AVLTestUtils.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+
+typedef AVLTree<Key, KeyCondition> Tree;
+typedef AVLTree<Key, KeyCondition, AVLNodeHeapAllocator> HeapTree;
+
+
+int main()
+{
+    const long n = 4 * AVL_PARALLEL_CUTOFF + 123;
+    std::vector<Key> keys(n);
+    std::vector<Key*> sorted(n);
+    for (long i = 0; i < n; i++)
+    {
+        keys[i].value = i;
+        sorted[i] = &keys[i];
+    }
+
+    {
+        Tree tree;
+        tree.set_num_of_threads(4);
+        tree.build_from_array(sorted.data(), static_cast<int>(n));
+        AVL_CHECK(avl_holds_range(tree, 0, n));
+        AVL_CHECK(tree.get_pool_stats().in_use == n);
+
+        std::vector<Key*> exported(n);
+        AVL_CHECK(tree.export_inorder(exported.data()) == n);
+        AVL_CHECK(exported == sorted);
+
+        Tree copy = tree.clone();
+        AVL_CHECK(avl_holds_range(copy, 0, n));
+        AVL_CHECK(copy.get_pool_stats().in_use == n);
+    }
+
+    // the heap allocator has no bulk release, so its nodes are freed by the parallel destructor
+    {
+        std::vector<Key*> owned(n);
+        for (long i = 0; i < n; i++)
+        {
+            owned[i] = new Key{i};
+        }
+        HeapTree tree;
+        tree.set_num_of_threads(4);
+        tree.build_from_array(owned.data(), static_cast<int>(n));
+        AVL_CHECK(avl_holds_range(tree, 0, n));
+        tree.erase_data();
+        tree.build_from_array(sorted.data(), static_cast<int>(n));
+        AVL_CHECK(tree.get_pool_stats().in_use == n);
+    }
+
+    // a task that throws, on either side of a nested fork, reaches the forking thread after every other task is done,
+    // and the pool keeps working
+    for (int side = 0; side < 2; side++)
+    {
+        std::atomic<int> done(0);
+        bool caught = false;
+        auto leaf = [&](bool throws) {
+            for (volatile int spin = 0; spin < 100000; spin++)
+            {
+            }
+            if (throws)
+            {
+                throw std::runtime_error("task");
+            }
+            done++;
+        };
+        try
+        {
+            avl_run_in_parallel([&]() { avl_run_in_parallel([&]() { leaf(side == 0); }, [&]() { leaf(false); }); },
+                                [&]() { avl_run_in_parallel([&]() { leaf(false); }, [&]() { leaf(side == 1); }); });
+        }
+        catch (const std::runtime_error&)
+        {
+            caught = true;
+        }
+        AVL_CHECK(caught);
+        AVL_CHECK(done.load() <= 3);
+        std::atomic<int> after(0);
+        avl_run_in_parallel([&]() { after++; }, [&]() { after++; });
+        AVL_CHECK(after.load() == 2);
+    }
+
+    return avl_test_failures == 0 ? 0 : 1;
+}
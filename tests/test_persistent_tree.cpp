@@ -0,0 +1,191 @@
+// AVLPersistentTree snapshots: writes to the source after a snapshot (and to the snapshot after it) don't show
+// in the other version, a write copies only its path, and the shared nodes are freed with the last version
+
+#include "AVLTestUtils.h"
+#include "../AVLPersistentTree.h"
+
+#include <atomic>
+#include <set>
+#include <thread>
+#include <vector>
+
+
+typedef AVLPersistentTree<Key, KeyCondition> PersistentTree;
+
+
+// returns true if the version holds exactly 'expected', by order and by search, with the right neighbors
+static bool holds_exactly(const PersistentTree& tree, std::vector<Key>& keys, const std::set<long>& expected)
+{
+    if (tree.get_num_of_nodes() != static_cast<int>(expected.size()))
+    {
+        return false;
+    }
+    std::vector<Key*> in_order(expected.size() + 1);
+    if (tree.export_inorder(in_order.data()) != static_cast<int>(expected.size()))
+    {
+        return false;
+    }
+    size_t index = 0;
+    for (long value : expected)
+    {
+        if (in_order[index++]->value != value)
+        {
+            return false;
+        }
+    }
+    Key* previous = nullptr;
+    for (long i = 0; i < static_cast<long>(keys.size()); i++)
+    {
+        bool in_tree = expected.count(i) == 1;
+        if ((tree.search(&keys[i]) == &keys[i]) != in_tree)
+        {
+            return false;
+        }
+        if (in_tree)
+        {
+            if (tree.get_closest_left(&keys[i]) != previous)
+            {
+                return false;
+            }
+            if (previous != nullptr && tree.get_closest_right(previous) != &keys[i])
+            {
+                return false;
+            }
+            previous = &keys[i];
+        }
+    }
+    return previous == nullptr || tree.get_closest_right(previous) == nullptr;
+}
+
+
+int main()
+{
+    const long n = 1000;
+    std::vector<Key> keys(n);
+    std::vector<Key*> sorted(n);
+    for (long i = 0; i < n; i++)
+    {
+        keys[i].value = i;
+        sorted[i] = &keys[i];
+    }
+
+    // snapshots taken along the way keep the contents they had, while the source keeps changing
+    {
+        PersistentTree source;
+        source.build_from_array(sorted.data(), static_cast<int>(n / 2));
+        std::set<long> now;
+        for (long i = 0; i < n / 2; i++)
+        {
+            now.insert(i);
+        }
+        std::vector<PersistentTree> versions;
+        std::vector<std::set<long>> contents;
+        long in_use_before = source.get_pool_stats().in_use;
+        for (int round = 0; round < 8; round++)
+        {
+            versions.push_back(source.snapshot());
+            contents.push_back(now);
+            AVL_CHECK(source.get_pool_stats().in_use == in_use_before);
+            for (long i = round; i < n; i += 8)
+            {
+                if (now.count(i) == 1)
+                {
+                    AVL_CHECK(source.remove(&keys[i]));
+                    now.erase(i);
+                }
+                else
+                {
+                    AVL_CHECK(source.insert(&keys[i]));
+                    now.insert(i);
+                }
+            }
+            AVL_CHECK(holds_exactly(source, keys, now));
+            in_use_before = source.get_pool_stats().in_use;
+        }
+        for (size_t v = 0; v < versions.size(); v++)
+        {
+            AVL_CHECK(holds_exactly(versions[v], keys, contents[v]));
+        }
+
+        // a write to a snapshot doesn't show in the source, nor in the snapshots taken from the same version
+        PersistentTree twin = versions[3];
+        long in_use = source.get_pool_stats().in_use;
+        AVL_CHECK(versions[3].insert(&keys[n - 1]) == (contents[3].count(n - 1) == 0));
+        AVL_CHECK(source.get_pool_stats().in_use - in_use <= 16);  // the path is at most 15 nodes, and the new one
+        AVL_CHECK(holds_exactly(twin, keys, contents[3]));
+        AVL_CHECK(holds_exactly(source, keys, now));
+        versions[3].clear();
+        AVL_CHECK(holds_exactly(versions[3], keys, std::set<long>()));
+        AVL_CHECK(holds_exactly(twin, keys, contents[3]));
+
+        // assignment drops the old version and shares the other one
+        versions[0] = source;
+        AVL_CHECK(holds_exactly(versions[0], keys, now));
+        source.clear();
+        AVL_CHECK(holds_exactly(versions[0], keys, now));
+        AVL_CHECK(holds_exactly(versions[1], keys, contents[1]));
+    }
+
+    // every node is freed with the last version that reaches it
+    {
+        PersistentTree source;
+        for (long i = 0; i < n; i++)
+        {
+            source.insert(&keys[i]);
+        }
+        {
+            PersistentTree first = source.snapshot();
+            PersistentTree second = source.snapshot();
+            for (long i = 0; i < n; i += 2)
+            {
+                source.remove(&keys[i]);
+                second.remove(&keys[i + 1]);
+            }
+            AVL_CHECK(source.get_pool_stats().in_use > n);
+        }
+        AVL_CHECK(source.get_pool_stats().in_use == n / 2);
+        source.clear();
+        AVL_CHECK(source.get_pool_stats().in_use == 0);
+    }
+
+    // a reader thread walks a snapshot while this thread writes to the version it was taken from
+    {
+        PersistentTree source;
+        source.build_from_array(sorted.data(), static_cast<int>(n));
+        std::set<long> all;
+        for (long i = 0; i < n; i++)
+        {
+            all.insert(i);
+        }
+        PersistentTree snapshot = source.snapshot();
+        std::atomic<bool> reader_ok(true);
+        std::thread reader([&]() {
+            for (int round = 0; round < 20; round++)
+            {
+                if (!holds_exactly(snapshot, keys, all))
+                {
+                    reader_ok.store(false);
+                }
+            }
+        });
+        for (int round = 0; round < 20; round++)
+        {
+            for (long i = round % 2; i < n; i += 2)
+            {
+                if (round % 4 < 2)
+                {
+                    source.remove(&keys[i]);
+                }
+                else
+                {
+                    source.insert(&keys[i]);
+                }
+            }
+        }
+        reader.join();
+        AVL_CHECK(reader_ok.load());
+        AVL_CHECK(holds_exactly(source, keys, all));
+    }
+
+    return avl_test_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,158 @@
+// AVLRcuTree readers running while the writer inserts and removes: the keys the writer never touches are
+// always found, and every range walk sees one version of the tree - the odd keys are inserted and removed
+// in order, so in every version they make one unbroken run
+
+#include "AVLTestUtils.h"
+#include "../AVLRcuTree.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+
+typedef AVLRcuTree<Key, KeyCondition> RcuTree;
+
+static const long N = 1000;        // keys 0..2N-1, the even ones stay in the tree
+static const int READERS = 3;
+static const int ROUNDS = 4;
+
+
+// returns true if the keys visited between lo and hi hold every even key, by order, and one run of odd keys
+static bool range_is_one_version(RcuTree& tree, std::vector<Key>& keys, long lo, long hi)
+{
+    std::vector<long> visited;
+    tree.for_each_in_range(&keys[lo], &keys[hi], [&visited](Key* key) { visited.push_back(key->value); });
+    long expected_even = lo + lo % 2;
+    long last_odd = -1;
+    for (size_t i = 0; i < visited.size(); i++)
+    {
+        long value = visited[i];
+        if (i > 0 && visited[i - 1] >= value)
+        {
+            return false;
+        }
+        if (value % 2 == 0)
+        {
+            if (value != expected_even)
+            {
+                return false;
+            }
+            expected_even += 2;
+            continue;
+        }
+        if (last_odd != -1 && value != last_odd + 2)
+        {
+            return false;
+        }
+        last_odd = value;
+    }
+    return expected_even > hi;
+}
+
+
+static void read_until_done(RcuTree& tree, std::vector<Key>& keys, const std::atomic<bool>& done, std::atomic<long>& failures, int seed)
+{
+    long i = seed;
+    while (!done.load())
+    {
+        i = (i * 7919 + 13) % N;
+        long even = 2 * i;
+        if (tree.search(&keys[even]) != &keys[even])
+        {
+            failures++;
+        }
+        {
+            // the data a reader got stays valid under the guard, even if it's removed and erased meanwhile
+            RcuTree::read_guard guard = tree.lock_for_reading();
+            Key probe = {even + 1};
+            Key* odd = tree.search(&probe);
+            if (odd != nullptr && odd->value != even + 1)
+            {
+                failures++;
+            }
+            Key* right = tree.get_closest_right(&keys[even]);
+            if (right != nullptr && right->value != even + 1 && right->value != even + 2)
+            {
+                failures++;
+            }
+            Key* left = tree.get_closest_left(&keys[even]);
+            if (even > 0 && (left == nullptr || (left->value != even - 1 && left->value != even - 2)))
+            {
+                failures++;
+            }
+        }
+        long lo = i < N - 100 ? 2 * i : 2 * (N - 100);
+        if (!range_is_one_version(tree, keys, lo, lo + 150))
+        {
+            failures++;
+        }
+    }
+}
+
+
+int main()
+{
+    std::vector<Key> keys(2 * N);
+    std::vector<Key*> evens(N);
+    for (long i = 0; i < 2 * N; i++)
+    {
+        keys[i].value = i;
+    }
+    for (long i = 0; i < N; i++)
+    {
+        evens[i] = &keys[2 * i];
+    }
+
+    RcuTree tree;
+    tree.build_from_array(evens.data(), static_cast<int>(N));
+    AVL_CHECK(tree.get_num_of_nodes() == N);
+    AVL_CHECK(range_is_one_version(tree, keys, 0, 2 * N - 1));
+
+    std::atomic<bool> done(false);
+    std::atomic<long> failures(0);
+    std::vector<std::thread> readers;
+    for (int t = 0; t < READERS; t++)
+    {
+        readers.emplace_back(read_until_done, std::ref(tree), std::ref(keys), std::cref(done), std::ref(failures), t + 1);
+    }
+
+    // the writer owns the odd keys it makes, and erases them through the tree once no reader can hold them
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        std::vector<Key*> odds(N);
+        for (long i = 0; i < N; i++)
+        {
+            odds[i] = new Key{2 * i + 1};
+            AVL_CHECK(tree.insert(odds[i]));
+        }
+        AVL_CHECK(!tree.insert(&keys[1]));
+        AVL_CHECK(tree.get_num_of_nodes() == 2 * N);
+        for (long i = 0; i < N; i++)
+        {
+            AVL_CHECK(tree.remove_and_erase(odds[i]));
+        }
+        AVL_CHECK(!tree.remove(&keys[1]));
+        AVL_CHECK(tree.get_num_of_nodes() == N);
+    }
+    done.store(true);
+    for (std::thread& reader : readers)
+    {
+        reader.join();
+    }
+    AVL_CHECK(failures.load() == 0);
+
+    // once the readers are done the tree holds the even keys only, and removes of them are seen
+    tree.synchronize();
+    AVL_CHECK(range_is_one_version(tree, keys, 0, 2 * N - 1));
+    for (long i = 0; i < N; i += 2)
+    {
+        AVL_CHECK(tree.remove(&keys[2 * i]));
+    }
+    AVL_CHECK(tree.get_num_of_nodes() == N / 2);
+    for (long i = 0; i < N; i++)
+    {
+        AVL_CHECK((tree.search(&keys[2 * i]) != nullptr) == (i % 2 == 1));
+    }
+
+    return avl_test_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,85 @@
+// ShardedAVLTree under writers from several threads: shards rebalance by moving nodes between them
+
+#include "AVLTestUtils.h"
+#include "../ShardedAVLTree.h"
+
+#include <thread>
+#include <vector>
+
+
+struct KeyValue
+{
+    using key_type = long;
+
+    long operator()(const Key* key) const
+    {
+        return key->value;
+    }
+};
+
+typedef ShardedAVLTree<Key, KeyCondition, KeyValue> Tree;
+
+
+int main()
+{
+    const int num_of_threads = 4;
+    const long n = 200000;
+    std::vector<Key> keys(n);
+    for (long i = 0; i < n; i++)
+    {
+        keys[i].value = i;
+    }
+
+    Tree tree(num_of_threads);
+    std::vector<std::thread> writers;
+    for (int t = 0; t < num_of_threads; t++)
+    {
+        // ascending keys land on the last shard first, so the shards have to hand keys to each other
+        writers.emplace_back([&, t]() {
+            for (long i = t; i < n; i += num_of_threads)
+            {
+                tree.insert(&keys[i]);
+            }
+        });
+    }
+    for (std::thread& writer : writers)
+    {
+        writer.join();
+    }
+
+    AVL_CHECK(tree.get_num_of_nodes() == n);
+    int used = 0;
+    for (int s = 0; s < tree.get_num_of_shards(); s++)
+    {
+        used += tree.get_shard_size(s) > 0;
+    }
+    AVL_CHECK(used > 1);
+    long expected = 0;
+    bool in_order = true;
+    tree.for_each_in_range(&keys[0], &keys[n - 1], [&](Key* key) { in_order = in_order && key->value == expected++; });
+    AVL_CHECK(in_order && expected == n);
+    for (long i = 0; i < n; i += 2)
+    {
+        AVL_CHECK(tree.remove(&keys[i]));
+    }
+    for (long i = 0; i < n; i++)
+    {
+        AVL_CHECK((tree.search(&keys[i]) != nullptr) == (i % 2 == 1));
+    }
+    AVL_CHECK(tree.get_num_of_nodes() == n / 2);
+
+    // rebuilding after the shards moved nodes drops every shard's pool and the slabs they gave away
+    std::vector<Key*> sorted;
+    for (long i = 0; i < n; i += 3)
+    {
+        sorted.push_back(&keys[i]);
+    }
+    tree.build_from_array(sorted.data(), static_cast<int>(sorted.size()));
+    AVL_CHECK(tree.get_num_of_nodes() == static_cast<int>(sorted.size()));
+    for (long i = 0; i < n; i++)
+    {
+        AVL_CHECK((tree.search(&keys[i]) != nullptr) == (i % 3 == 0));
+    }
+
+    return avl_test_failures == 0 ? 0 : 1;
+}
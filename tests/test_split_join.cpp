@@ -0,0 +1,86 @@
+// split and join of AVLTree, including a tree that is split into itself
+
+#include "AVLTestUtils.h"
+
+#include <vector>
+
+
+typedef AVLTree<Key, KeyCondition> Tree;
+
+
+static void build(Tree& tree, std::vector<Key>& keys, long first, long last)
+{
+    for (long i = first; i < last; i++)
+    {
+        tree.insert(&keys[i]);
+    }
+}
+
+
+int main()
+{
+    const long n = 1000;
+    std::vector<Key> keys(n);
+    for (long i = 0; i < n; i++)
+    {
+        keys[i].value = i;
+    }
+    Key boundary = {400};
+
+    // split into two other trees
+    {
+        Tree tree, smaller, bigger;
+        build(tree, keys, 0, n);
+        build(smaller, keys, 0, 10);
+        tree.split(&boundary, smaller, bigger);
+        AVL_CHECK(tree.get_num_of_nodes() == 0);
+        AVL_CHECK(avl_holds_range(smaller, 0, 400));
+        AVL_CHECK(avl_holds_range(bigger, 400, n));
+    }
+
+    // split into itself as the smaller half
+    {
+        Tree tree, bigger;
+        build(tree, keys, 0, n);
+        tree.split(&boundary, tree, bigger);
+        AVL_CHECK(avl_holds_range(tree, 0, 400));
+        AVL_CHECK(avl_holds_range(bigger, 400, n));
+    }
+
+    // split into itself as the bigger half
+    {
+        Tree tree, smaller;
+        build(tree, keys, 0, n);
+        build(smaller, keys, 900, n);
+        tree.split(&boundary, smaller, tree);
+        AVL_CHECK(avl_holds_range(smaller, 0, 400));
+        AVL_CHECK(avl_holds_range(tree, 400, n));
+    }
+
+    // join back, into one of the halves and into a third tree, with and without a pivot
+    {
+        Tree tree, bigger;
+        build(tree, keys, 0, n);
+        tree.split(&boundary, tree, bigger);
+        tree.join(tree, nullptr, bigger);
+        AVL_CHECK(avl_holds_range(tree, 0, n));
+        AVL_CHECK(bigger.get_num_of_nodes() == 0);
+
+        Tree smaller, joined;
+        tree.split(&boundary, smaller, bigger);
+        bigger.erase(&boundary);
+        joined.join(smaller, &keys[400], bigger);
+        AVL_CHECK(avl_holds_range(joined, 0, n));
+    }
+
+    // join of trees built apart
+    {
+        Tree smaller, bigger;
+        build(smaller, keys, 0, 400);
+        build(bigger, keys, 400, n);
+        smaller.join(smaller, nullptr, bigger);
+        AVL_CHECK(avl_holds_range(smaller, 0, n));
+    }
+
+    return avl_test_failures == 0 ? 0 : 1;
+}
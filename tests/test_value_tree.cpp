@@ -0,0 +1,225 @@
+// AVLValueTree: emplace constructs the object in its node, insert moves or copies it in, extract and
+// insert(node_handle) move nodes between trees without touching the object, and every object is destroyed
+// exactly once - by remove, by a handle that is dropped, or with its tree
+
+#include "AVLTestUtils.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+
+// key with counters of the objects alive, copied and moved
+static long live = 0;
+static long copies = 0;
+static long moves = 0;
+
+struct Tracked
+{
+    long value;
+
+    explicit Tracked(long value) : value(value) { live++; }
+    Tracked(const Tracked& other) : value(other.value) { live++; copies++; }
+    Tracked(Tracked&& other) noexcept : value(other.value) { live++; moves++; }
+    Tracked& operator=(const Tracked&) = default;
+    Tracked& operator=(Tracked&&) = default;
+    ~Tracked() { live--; }
+};
+
+struct TrackedCondition
+{
+    Comparison operator()(const Tracked* a, const Tracked* b) const
+    {
+        if (a->value < b->value)
+        {
+            return Comparison::LESS_THAN;
+        }
+        if (a->value > b->value)
+        {
+            return Comparison::GREATER_THAN;
+        }
+        return Comparison::EQUAL;
+    }
+};
+
+// move only key - the tree must never copy it
+struct Owned
+{
+    std::unique_ptr<long> value;
+
+    explicit Owned(long value) : value(new long(value)) {}
+};
+
+struct OwnedCondition
+{
+    Comparison operator()(const Owned* a, const Owned* b) const
+    {
+        if (*a->value < *b->value)
+        {
+            return Comparison::LESS_THAN;
+        }
+        if (*a->value > *b->value)
+        {
+            return Comparison::GREATER_THAN;
+        }
+        return Comparison::EQUAL;
+    }
+};
+
+typedef AVLValueTree<Tracked, TrackedCondition> TrackedTree;
+typedef AVLValueTree<Owned, OwnedCondition> OwnedTree;
+
+
+// returns true if the tree holds exactly the values in 'expected' (sorted) by order
+template <class tree_type, class value_of>
+static bool holds_values(tree_type& tree, const std::vector<long>& expected, value_of value)
+{
+    if (tree.get_num_of_nodes() != static_cast<int>(expected.size()))
+    {
+        return false;
+    }
+    size_t index = 0;
+    for (auto* r = tree.get_min_node(); r != nullptr; r = tree.get_next_node(r))
+    {
+        if (index == expected.size() || value(*r->get_data()) != expected[index])
+        {
+            return false;
+        }
+        index++;
+    }
+    return true;
+}
+
+static long tracked_value(const Tracked& tracked)
+{
+    return tracked.value;
+}
+
+static long owned_value(const Owned& owned)
+{
+    return *owned.value;
+}
+
+
+int main()
+{
+    const long n = 500;
+
+    // emplace builds every object in place, duplicates are built and destroyed, moves and copies are counted
+    {
+        TrackedTree tree;
+        for (long i = 0; i < n; i += 2)
+        {
+            AVL_CHECK(tree.emplace(i) != nullptr);
+        }
+        AVL_CHECK(copies == 0 && moves == 0 && live == n / 2);
+        AVL_CHECK(tree.emplace(10L) == nullptr);
+        AVL_CHECK(live == n / 2);
+        for (long i = 1; i < n; i += 4)
+        {
+            AVL_CHECK(tree.insert(Tracked(i)) != nullptr);
+        }
+        AVL_CHECK(copies == 0 && moves == n / 4);
+        Tracked outside(n + 1);
+        AVL_CHECK(tree.insert(&outside) != nullptr && tree.search(&outside)->get_data() != &outside);
+        AVL_CHECK(copies == 1);
+        AVL_CHECK(avl_is_valid(tree));
+
+        std::vector<long> expected;
+        for (long i = 0; i < n; i++)
+        {
+            if (i % 2 == 0 || i % 4 == 1)
+            {
+                expected.push_back(i);
+            }
+        }
+        expected.push_back(n + 1);
+        AVL_CHECK(holds_values(tree, expected, tracked_value));
+
+        // a node extracted and inserted back keeps its object where it was, nothing is copied or moved
+        Tracked probe(20);
+        Tracked* object = tree.search(&probe)->get_data();
+        long moves_before = moves;
+        TrackedTree::node_handle handle = tree.extract(&probe);
+        AVL_CHECK(!handle.empty() && handle.value().value == 20 && &handle.value() == object);
+        AVL_CHECK(tree.search(&probe) == nullptr && avl_is_valid(tree));
+        AVL_CHECK(tree.extract(&probe).empty());
+        TrackedTree::node_type* node = tree.insert(std::move(handle));
+        AVL_CHECK(node != nullptr && node->get_data() == object && handle.empty());
+        AVL_CHECK(moves == moves_before && avl_is_valid(tree));
+        AVL_CHECK(holds_values(tree, expected, tracked_value));
+
+        // into another tree, and back when the other tree has the key already - the handle keeps the node then
+        TrackedTree other;
+        other.emplace(20L);
+        handle = tree.extract(&probe);
+        AVL_CHECK(other.insert(std::move(handle)) == nullptr && !handle.empty());
+        Tracked probe_22(22);
+        TrackedTree::node_handle second = tree.extract(&probe_22);
+        AVL_CHECK(other.insert(std::move(second)) != nullptr && second.empty());
+        AVL_CHECK(holds_values(other, {20, 22}, tracked_value) && avl_is_valid(other));
+
+        // a dropped handle destroys its object, remove destroys the object in the node
+        long live_before = live;
+        handle.reset();
+        AVL_CHECK(live == live_before - 1 && handle.empty());
+        AVL_CHECK(tree.remove(&outside) && live == live_before - 2);
+        {
+            TrackedTree::node_handle dropped = tree.extract(&probe_22);
+            AVL_CHECK(dropped.empty());
+            Tracked probe_24(24);
+            dropped = tree.extract(&probe_24);
+            AVL_CHECK(!dropped.empty());
+        }
+        AVL_CHECK(live == live_before - 3);
+
+        // clone copies every object
+        long copies_before = copies;
+        TrackedTree copy = tree.clone();
+        AVL_CHECK(copies - copies_before == tree.get_num_of_nodes());
+        AVL_CHECK(avl_is_valid(copy));
+        for (auto* r = tree.get_min_node(), *c = copy.get_min_node(); r != nullptr; r = tree.get_next_node(r), c = copy.get_next_node(c))
+        {
+            AVL_CHECK(c != nullptr && c->get_data() != r->get_data() && c->get_data()->value == r->get_data()->value);
+        }
+    }
+    AVL_CHECK(live == 0);
+
+    // a move only type goes in by emplace and by move, and its object is moved out of an extracted node
+    {
+        OwnedTree tree;
+        for (long i = 0; i < n; i++)
+        {
+            if (i % 2 == 0)
+            {
+                AVL_CHECK(tree.emplace(i) != nullptr);
+            }
+            else
+            {
+                AVL_CHECK(tree.insert(Owned(i)) != nullptr);
+            }
+        }
+        AVL_CHECK(tree.insert(Owned(7)) == nullptr);
+        AVL_CHECK(avl_is_valid(tree));
+        Owned probe(100);
+        OwnedTree::node_handle handle = tree.extract(&probe);
+        AVL_CHECK(!handle.empty());
+        Owned taken = std::move(handle.value());
+        AVL_CHECK(taken.value != nullptr && *taken.value == 100 && handle.value().value == nullptr);
+        handle.reset();
+        std::vector<long> expected;
+        for (long i = 0; i < n; i++)
+        {
+            if (i != 100)
+            {
+                expected.push_back(i);
+            }
+        }
+        AVL_CHECK(holds_values(tree, expected, owned_value));
+        AVL_CHECK(tree.insert(std::move(taken)) != nullptr);
+        AVL_CHECK(holds_values(tree, avl_range(0, n), owned_value));
+        AVL_CHECK(avl_is_valid(tree));
+    }
+
+    return avl_test_failures == 0 ? 0 : 1;
+}